@@ -0,0 +1,265 @@
+#include <leimu/leimu.h>
+#include <leimu/asset/Archive.h>
+#include <leimu/native/mmap.h>
+#include <leimu/render/Ktx2.h>
+
+// stb_image itself is compiled into leimu
+#include <stb_image.h>
+
+#define STB_DXT_IMPLEMENTATION
+#include <stb_dxt.h>
+
+#include <cmath>
+
+namespace {
+  enum class Codec : u8 {
+    BC1,
+    BC3,
+    BC4,
+    BC5,
+  };
+
+  struct Level {
+    u32 width;
+    u32 height;
+    // RGBA8
+    std::vector<u8> texels;
+  };
+
+  void PrintUsage(const char *name) {
+    std::println(leimu::errs(), "usage: {} <input> <output.ktx2> [bc1|bc3|bc4|bc5] [--linear]", name);
+    std::println(leimu::errs(), "  bc1: RGB colour; bc3: RGBA colour; bc4: single channel; bc5: two channels, e.g. normals");
+    std::println(leimu::errs(), "  the default is bc3 for images with alpha, bc1 otherwise; bc4 and bc5 are always linear");
+    std::println(leimu::errs(), "usage: {} pack <output> <directory>", name);
+    std::println(leimu::errs(), "  packs every file under directory into an archive, named by their relative paths");
+  }
+
+  int Pack(const std::filesystem::path &output, const std::filesystem::path &root) {
+    std::error_code error;
+    std::vector<std::pair<std::string, std::filesystem::path>> files;
+    for (const auto &entry: std::filesystem::recursive_directory_iterator(root, error)) {
+      if (entry.is_regular_file()) {
+        files.emplace_back(entry.path().lexically_relative(root).generic_string(), entry.path());
+      }
+    }
+    if (error) {
+      std::println(leimu::errs(), "[cook] Couldn't list '{}': {}", root.string(), error.message());
+      return EXIT_FAILURE;
+    }
+
+    // Same input, same archive
+    std::ranges::sort(files);
+
+    if (!leimu::asset::WriteArchive(output, files)) {
+      return EXIT_FAILURE;
+    }
+
+    std::println(leimu::outs(), "[cook] {} -> {} ({} files)", root.string(), output.string(), files.size());
+    return EXIT_SUCCESS;
+  }
+
+  std::optional<Codec> ParseCodec(const std::string_view name) {
+    if (name == "bc1") return Codec::BC1;
+    if (name == "bc3") return Codec::BC3;
+    if (name == "bc4") return Codec::BC4;
+    if (name == "bc5") return Codec::BC5;
+    return std::nullopt;
+  }
+
+  VkFormat GetFormat(const Codec codec, const bool srgb) {
+    switch (codec) {
+      case Codec::BC1:
+        return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+      case Codec::BC3:
+        return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+      case Codec::BC4:
+        return VK_FORMAT_BC4_UNORM_BLOCK;
+      default:
+        return VK_FORMAT_BC5_UNORM_BLOCK;
+    }
+  }
+
+  f32 ToLinear(const u8 value) {
+    const auto c = static_cast<f32>(value) / 255.0f;
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+  }
+
+  u8 ToSrgb(const f32 value) {
+    const auto c = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    return static_cast<u8>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+  }
+
+  /**
+   * 2x2 box filter; colour is averaged in linear light if srgb, alpha never is.
+   */
+  Level Downsample(const Level &src, const bool srgb) {
+    static const auto linear = [] {
+      std::array<f32, 256> table{};
+      for (u32 i = 0; i < table.size(); ++i) {
+        table[i] = ToLinear(static_cast<u8>(i));
+      }
+      return table;
+    }();
+
+    Level dst{std::max(src.width / 2, 1u), std::max(src.height / 2, 1u)};
+    dst.texels.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+
+    for (u32 y = 0; y < dst.height; ++y) {
+      for (u32 x = 0; x < dst.width; ++x) {
+        for (u32 c = 0; c < 4; ++c) {
+          const auto colour = srgb && c < 3;
+
+          f32 sum = 0;
+          for (u32 dy = 0; dy < 2; ++dy) {
+            for (u32 dx = 0; dx < 2; ++dx) {
+              const auto sx = std::min(x * 2 + dx, src.width - 1);
+              const auto sy = std::min(y * 2 + dy, src.height - 1);
+              const auto value = src.texels[(static_cast<size_t>(sy) * src.width + sx) * 4 + c];
+              sum += colour ? linear[value] : static_cast<f32>(value);
+            }
+          }
+          sum /= 4;
+
+          dst.texels[(static_cast<size_t>(y) * dst.width + x) * 4 + c] =
+              colour ? ToSrgb(sum) : static_cast<u8>(std::clamp(sum + 0.5f, 0.0f, 255.0f));
+        }
+      }
+    }
+
+    return dst;
+  }
+
+  std::vector<u8> Encode(const Level &level, const Codec codec) {
+    const auto blockBytes = codec == Codec::BC1 || codec == Codec::BC4 ? 8u : 16u;
+    const auto blocksX = (level.width + 3) / 4;
+    const auto blocksY = (level.height + 3) / 4;
+
+    std::vector<u8> out(static_cast<size_t>(blocksX) * blocksY * blockBytes);
+    auto dst = out.data();
+
+    for (u32 by = 0; by < blocksY; ++by) {
+      for (u32 bx = 0; bx < blocksX; ++bx) {
+        // Edge blocks repeat the last row and column
+        std::array<u8, 64> rgba;
+        for (u32 i = 0; i < 16; ++i) {
+          const auto x = std::min(bx * 4 + i % 4, level.width - 1);
+          const auto y = std::min(by * 4 + i / 4, level.height - 1);
+          memcpy(&rgba[i * 4], &level.texels[(static_cast<size_t>(y) * level.width + x) * 4], 4);
+        }
+
+        switch (codec) {
+          case Codec::BC1:
+          case Codec::BC3:
+            stb_compress_dxt_block(dst, rgba.data(), codec == Codec::BC3, STB_DXT_HIGHQUAL);
+            break;
+          case Codec::BC4: {
+            std::array<u8, 16> r;
+            for (u32 i = 0; i < 16; ++i) {
+              r[i] = rgba[i * 4];
+            }
+            stb_compress_bc4_block(dst, r.data());
+            break;
+          }
+          case Codec::BC5: {
+            std::array<u8, 32> rg;
+            for (u32 i = 0; i < 16; ++i) {
+              rg[i * 2] = rgba[i * 4];
+              rg[i * 2 + 1] = rgba[i * 4 + 1];
+            }
+            stb_compress_bc5_block(dst, rg.data());
+            break;
+          }
+        }
+
+        dst += blockBytes;
+      }
+    }
+
+    return out;
+  }
+}
+
+/**
+ * Cooks an image into a block-compressed KTX2 file with its full mip chain, for render::TextureStreamer,
+ * or packs a directory into an asset::Archive.
+ */
+int main(const int argc, char *argv[]) {
+  if (argc < 3) {
+    PrintUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (std::string_view(argv[1]) == "pack") {
+    if (argc != 4) {
+      PrintUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+    return Pack(argv[2], argv[3]);
+  }
+
+  const std::filesystem::path input = argv[1];
+  const std::filesystem::path output = argv[2];
+
+  std::optional<Codec> codec;
+  auto srgb = true;
+  for (auto i = 3; i < argc; ++i) {
+    if (const std::string_view arg = argv[i]; arg == "--linear") {
+      srgb = false;
+    } else if (!((codec = ParseCodec(arg)))) {
+      PrintUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  const auto mapping = leimu::native::CreateFileMapping(input);
+  if (!mapping) {
+    return EXIT_FAILURE;
+  }
+
+  i32 width, height, channels;
+  const std::unique_ptr<stbi_uc, decltype(&stbi_image_free)> pixels(
+      stbi_load_from_memory(
+          static_cast<const stbi_uc *>(mapping->ptr()),
+          static_cast<i32>(mapping->size()),
+          &width, &height, &channels,
+          STBI_rgb_alpha),
+      &stbi_image_free);
+  if (!pixels) {
+    std::println(leimu::errs(), "[cook] Couldn't decode '{}': {}", input.string(), stbi_failure_reason());
+    return EXIT_FAILURE;
+  }
+
+  if (!codec) {
+    codec = channels == 2 || channels == 4 ? Codec::BC3 : Codec::BC1;
+  }
+  if (codec == Codec::BC4 || codec == Codec::BC5) {
+    srgb = false;
+  }
+
+  std::vector<Level> levels;
+  levels.push_back(
+      {
+          static_cast<u32>(width),
+          static_cast<u32>(height),
+          {pixels.get(), pixels.get() + static_cast<size_t>(width) * height * 4},
+      });
+  while (levels.back().width > 1 || levels.back().height > 1) {
+    levels.push_back(Downsample(levels.back(), srgb));
+  }
+
+  std::vector<std::vector<u8>> encoded;
+  encoded.reserve(levels.size());
+  for (const auto &level: levels) {
+    encoded.push_back(Encode(level, *codec));
+  }
+
+  const auto format = GetFormat(*codec, srgb);
+  if (!leimu::render::WriteKtx2(output, format, {levels[0].width, levels[0].height}, encoded)) {
+    return EXIT_FAILURE;
+  }
+
+  std::println(
+      leimu::outs(), "[cook] {} -> {} ({}x{}, {} levels)",
+      input.string(), output.string(), width, height, levels.size());
+  return EXIT_SUCCESS;
+}
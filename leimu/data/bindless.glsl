@@ -0,0 +1,17 @@
+// Declarations of the render::Bindless set; include with GL_GOOGLE_include_directive.
+// Define BINDLESS_SET first if the set isn't bound at 0.
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+#ifndef BINDLESS_SET
+#define BINDLESS_SET 0
+#endif
+
+layout(set = BINDLESS_SET, binding = 0) uniform texture2D bindlessImages[];
+// Untyped; redeclare binding 1 with the block a shader needs
+layout(set = BINDLESS_SET, binding = 1) buffer BindlessBuffer { uint words[]; } bindlessBuffers[];
+layout(set = BINDLESS_SET, binding = 2) uniform sampler bindlessSamplers[];
+
+// Indices may differ within a draw, e.g. per instance
+#define BINDLESS_TEXTURE(image, sampler) \
+    sampler2D(bindlessImages[nonuniformEXT(image)], bindlessSamplers[nonuniformEXT(sampler)])
@@ -3,6 +3,12 @@
 #include "Config.h"
 #include "feature/GLFW.h"
 #include "feature/Vulkan.h"
+#include "job/Scheduler.h"
+#include "native/aio.h"
+#include "render/PipelineCompiler.h"
+#include "render/Overlay.h"
+#include "render/Recorder.h"
+#include "render/Texture.h"
 
 namespace leimu {
   class ContextLifetimeNote {
@@ -22,8 +28,22 @@ namespace leimu {
     feature::GLFW _glfw;
     feature::Vulkan _vulkan;
 
+    // Outlives every subsystem submitting to it, so their queued jobs finish first
+    job::Scheduler _jobs;
+
+    render::PipelineCompiler _compiler;
+    render::Recorder _recorder;
+    render::Overlay _overlay;
+    render::TextureStreamer _textures;
+    native::FileReader _reader;
+
     ContextLifetimeNote _endNote;
 
+    u64 _frameCount = 0;
+
+    [[nodiscard]] bool shouldClose() const;
+    void record(const feature::VkFrame_T &frame);
+
   public:
     App(std::string name, Config config);
     ~App();
@@ -31,6 +51,11 @@ namespace leimu {
     void run();
 
     [[nodiscard]] Config& config() { return _config; }
+    [[nodiscard]] job::Scheduler &jobs() { return _jobs; }
+    [[nodiscard]] render::PipelineCompiler &compiler() { return _compiler; }
+    [[nodiscard]] render::Recorder &recorder() { return _recorder; }
+    [[nodiscard]] render::TextureStreamer &textures() { return _textures; }
+    [[nodiscard]] native::FileReader &reader() { return _reader; }
     
     [[nodiscard]] const Config& config() const { return _config; }
     [[nodiscard]] const std::string &name() const { return _name; }
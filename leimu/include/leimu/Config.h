@@ -3,13 +3,18 @@
 #include "framework.h"
 
 #include "Reactive.h"
+#include "leimu/config/JobConfig.h"
+#include "leimu/config/ProfilerConfig.h"
 #include "leimu/config/VkConfig.h"
 
 namespace leimu {
   struct Config_T {
     Reactive<config::VkConfig> vulkan;
+    Reactive<config::JobConfig> jobs;
+    Reactive<config::ProfilerConfig> profiler;
 
-    Config_T(config::VkConfig vk) : vulkan(vk) {}
+    Config_T(config::VkConfig vk, config::JobConfig job = {}, config::ProfilerConfig prof = {})
+      : vulkan(vk), jobs(job), profiler(prof) {}
   };
 
   class Config {
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "leimu/framework.h"
+#include "leimu/job/Scheduler.h"
+#include "leimu/native/mmap.h"
+
+namespace leimu::asset {
+
+  /**
+   * On-disk layout, little-endian:
+   * header, blobs (each aligned to header.alignment), table of contents, then the names it points into.
+   */
+  struct ArchiveHeader {
+    std::array<char, 8> magic;
+    u32 version;
+    u32 count;
+    u64 tocOffset;
+    u64 namesOffset;
+    u64 namesSize;
+    u64 alignment;
+  };
+
+  /**
+   * Entries are sorted by hash, then name.
+   */
+  struct ArchiveEntry {
+    // leimu::Hash of the name
+    u64 hash;
+    u64 offset;
+    u64 size;
+    u32 nameOffset;
+    u32 nameLength;
+  };
+
+  constexpr std::array<char, 8> ArchiveMagic{'L', 'E', 'I', 'M', 'U', 'P', 'A', 'K'};
+  constexpr u32 ArchiveVersion = 1;
+
+  /**
+   * Packed asset archive, mapped once as a whole; blobs are handed out as views into the mapping.
+   * Views stay valid as long as the archive does.
+   */
+  class Archive_T {
+    native::FileMapping _mapping;
+    std::span<const ArchiveEntry> _entries;
+    std::string_view _names;
+
+  public:
+    Archive_T(native::FileMapping mapping, std::span<const ArchiveEntry> entries, std::string_view names)
+      : _mapping(std::move(mapping)), _entries(entries), _names(names) {}
+
+    [[nodiscard]] size_t size() const { return _entries.size(); }
+    [[nodiscard]] std::string_view name(size_t index) const;
+    [[nodiscard]] std::span<const u8> data(size_t index) const;
+
+    /**
+     * Binary search over the table of contents; no allocation.
+     */
+    [[nodiscard]] std::optional<std::span<const u8>> find(std::string_view name) const;
+
+    void advise(std::span<const u8> blob, native::Advice advice) const;
+
+    /**
+     * Faults blob in on a background job, so the thread reading it later doesn't.
+     * @param signal Decremented once every page has been touched
+     */
+    void prefetch(job::Scheduler &jobs, std::span<const u8> blob, const job::Counter &signal = nullptr) const;
+  };
+
+  using Archive = std::shared_ptr<Archive_T>;
+
+  /**
+   * Maps an archive and validates its table of contents.
+   * @param advice Expected access to blobs; lookups are usually random
+   */
+  [[nodiscard]] Archive OpenArchive(const std::filesystem::path &path, native::Advice advice = native::Advice::Random) noexcept;
+
+  /**
+   * Packs files into an archive.
+   * @param files Name in the archive and path of each file
+   * @param alignment Alignment of each blob; a power of two of at least 8
+   */
+  [[nodiscard]] bool WriteArchive(
+      const std::filesystem::path &path,
+      std::span<const std::pair<std::string, std::filesystem::path>> files,
+      u64 alignment = 64) noexcept;
+}
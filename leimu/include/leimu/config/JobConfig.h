@@ -0,0 +1,14 @@
+#pragma once
+
+#include "leimu/framework.h"
+
+namespace leimu::config {
+
+  struct JobConfig {
+    // Worker threads of the shared scheduler; 0 leaves one core to the frame thread
+    u32 threads = 0;
+    // File reads in flight at most
+    u32 ioDepth = 64;
+  };
+
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "leimu/framework.h"
+
+namespace leimu::config {
+
+  struct ProfilerConfig {
+    // GPU timestamps around the frame and every profiler scope
+    bool enabled = true;
+    // Draws timings over the frame; read every frame, so it can be toggled at runtime
+    bool overlay = false;
+
+    u32 maxScopes = 256;
+    // Window of the rolling averages, in frames
+    u32 averageFrames = 60;
+
+    // CPU trace written on exit when built with LEIMU_TRACE; empty disables
+    std::filesystem::path tracePath = "trace.json";
+  };
+
+}
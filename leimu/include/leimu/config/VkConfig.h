@@ -1,9 +1,29 @@
 #pragma once
 
+#include "leimu/framework.h"
+#include "leimu/feature/Capabilities.h"
+
 namespace leimu::config {
 
   struct VkConfig {
     bool latencyRelaxed;
+    u32 framesInFlight = 2;
+
+    // Renders into device-local offscreen images without a window, surface or swapchain
+    bool headless = false;
+    VkExtent2D headlessExtent{800, 600};
+
+    // Stops the frame loop after the given number of frames; 0 means unlimited
+    u64 frameLimit = 0;
+
+    // Persistent pipeline cache; an empty path disables persistence
+    std::filesystem::path pipelineCachePath = "pipeline.cache";
+
+    // Persistently mapped ring buffer through which all uploads are staged
+    VkDeviceSize stagingSize = 32ull << 20;
+
+    // Requested on top of leimu's own; devices lacking a required one aren't picked
+    std::vector<feature::VkCapability> capabilities;
   };
 
 }
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "leimu/framework.h"
+
+namespace leimu::feature {
+
+  /**
+   * Feature structures of a physical device up to Vulkan 1.3, linked into a pNext chain.
+   * Structures newer than the version it was built for are left out of the chain.
+   */
+  struct VkFeatureChain {
+    VkPhysicalDeviceFeatures2 core{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+    VkPhysicalDeviceVulkan11Features v11{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES};
+    VkPhysicalDeviceVulkan12Features v12{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    VkPhysicalDeviceVulkan13Features v13{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
+
+    explicit VkFeatureChain(u32 version);
+
+    // The chain points into itself
+    VkFeatureChain(const VkFeatureChain &) = delete;
+    VkFeatureChain &operator=(const VkFeatureChain &) = delete;
+  };
+
+  using VkFeatureBit = VkBool32 &(*)(VkFeatureChain &chain);
+
+  // e.g. LEIMU_FEATURE(v12, timelineSemaphore) or LEIMU_FEATURE(core.features, multiDrawIndirect)
+#define LEIMU_FEATURE(s, f) [](leimu::feature::VkFeatureChain &chain) -> VkBool32 & { return chain.s.f; }
+
+  /**
+   * Something a subsystem needs from the device: a version, extensions and feature bits,
+   * enabled all together or not at all.
+   */
+  struct VkCapability {
+    std::string name;
+    // devices without a required capability are rejected; optional ones are enabled wherever supported
+    bool required = false;
+    u32 version = VK_API_VERSION_1_0;
+    std::vector<const char *> extensions;
+    std::vector<VkFeatureBit> features;
+  };
+
+  /**
+   * Names of the capabilities leimu asks for itself.
+   */
+  namespace capability {
+    constexpr std::string_view Swapchain = "swapchain";
+    constexpr std::string_view BlockCompression = "block compression";
+    constexpr std::string_view IndirectFirstInstance = "indirect first instance";
+    constexpr std::string_view MultiDrawIndirect = "multi-draw indirect";
+    constexpr std::string_view IndirectCount = "indirect count";
+    constexpr std::string_view IndirectCountKHR = "indirect count (KHR)";
+    constexpr std::string_view Bindless = "bindless";
+    constexpr std::string_view TimelineSemaphore = "timeline semaphores";
+    constexpr std::string_view Synchronization2 = "synchronization2";
+    constexpr std::string_view DynamicRendering = "dynamic rendering";
+  }
+
+  /**
+   * Render paths a device can take, each including the ones before it.
+   */
+  enum class VkCapabilityTier : u8 {
+    // Vulkan 1.0 and whichever extensions are at hand
+    Baseline,
+    // bindless descriptors, timeline semaphores and indirect count; Vulkan 1.2 class
+    GpuDriven,
+    // plus dynamic rendering and synchronization2; Vulkan 1.3 class
+    Modern,
+  };
+
+  [[nodiscard]] std::string_view GetTierName(VkCapabilityTier tier);
+
+  /**
+   * Outcome of matching capability requests against a device.
+   */
+  struct VkNegotiation {
+    u32 version;
+    // features to enable, chained up to version
+    std::unique_ptr<VkFeatureChain> features;
+    std::vector<const char *> extensions;
+    std::set<std::string, std::less<>> enabled;
+    // names of required capabilities the device lacks
+    std::vector<std::string> missing;
+
+    [[nodiscard]] bool satisfied() const { return missing.empty(); }
+    [[nodiscard]] bool has(const std::string_view name) const { return enabled.contains(name); }
+  };
+
+  /**
+   * Capabilities leimu's own subsystems ask for, followed by extra ones, e.g. from the application.
+   */
+  [[nodiscard]] std::vector<VkCapability> GetCapabilityRequests(
+      bool headless,
+      std::span<const VkCapability> extra = {});
+
+  /**
+   * The highest version both the loader and leimu know of.
+   */
+  [[nodiscard]] u32 GetInstanceVersion() noexcept;
+
+  [[nodiscard]] VkNegotiation Negotiate(
+      VkPhysicalDevice device,
+      std::span<const VkCapability> requests) noexcept;
+
+  [[nodiscard]] VkCapabilityTier GetTier(const VkNegotiation &negotiation) noexcept;
+
+  /**
+   * What the device was created with.
+   */
+  struct VkCapabilities_T {
+    u32 apiVersion = VK_API_VERSION_1_0;
+    VkCapabilityTier tier = VkCapabilityTier::Baseline;
+    std::set<std::string, std::less<>> enabled;
+
+    bool multiDrawIndirect = false;
+    // non-zero firstInstance in indirect draws
+    bool drawIndirectFirstInstance = false;
+    u32 maxDrawIndirectCount = 1;
+    // core or VK_KHR_draw_indirect_count; null if unsupported
+    PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+
+    // descriptor indexing with update-after-bind; see render::Bindless
+    bool bindless = false;
+    u32 maxBindlessSampledImages = 0;
+    u32 maxBindlessStorageBuffers = 0;
+    u32 maxBindlessSamplers = 0;
+    // all of them together, as every stage sees the whole set
+    u32 maxBindlessResources = 0;
+
+    bool timelineSemaphore = false;
+    bool synchronization2 = false;
+    bool dynamicRendering = false;
+
+    /**
+     * @param name Name of a VkCapability, e.g. capability::TimelineSemaphore
+     */
+    [[nodiscard]] bool has(const std::string_view name) const { return enabled.contains(name); }
+  };
+}
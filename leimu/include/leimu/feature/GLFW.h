@@ -3,16 +3,25 @@
 #include "leimu/framework.h"
 #include "Feature.h"
 
+namespace leimu {
+  class App;
+}
+
 namespace leimu::feature {
   class GLFW final : public Feature<GLFW> {
     GLFWwindow *_window;
+    bool _headless;
 
   public:
-    GLFW();
+    explicit GLFW(const App &app);
 
     ~GLFW() override;
 
     [[nodiscard]] GLFWwindow *window() const { return _window; }
+    [[nodiscard]] bool headless() const { return _headless; }
+
+    [[nodiscard]] VkExtent2D framebufferSize() const;
+    [[nodiscard]] bool minimized() const;
 
     bool operator!() const override;
 
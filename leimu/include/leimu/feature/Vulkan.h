@@ -3,20 +3,47 @@
 #include "leimu/framework.h"
 
 #include "Feature.h"
+#include "Capabilities.h"
 
 namespace leimu {
   class App;
 }
 
+namespace leimu::memory {
+  class Allocator;
+  class Uploader;
+  struct Image_T;
+}
+
+namespace leimu::render {
+  class AsyncCompute;
+  class Bindless;
+  class DeletionQueue;
+  class DescriptorAllocator;
+  class Profiler;
+  class Timelines;
+}
+
 namespace leimu::feature {
   class GLFW;
 
   struct VkQueueFamilyIndices_T {
     u32 graphicsQueue;
     u32 presentQueue;
+    // dedicated transfer family if the device has one; graphics family otherwise
+    u32 transferQueue;
+    // compute-only family if the device has one; graphics family otherwise
+    u32 computeQueue;
 
-    VkQueueFamilyIndices_T(const u32 graphicsQueue, const u32 presentQueue)
-        : graphicsQueue(graphicsQueue), presentQueue(presentQueue) {
+    VkQueueFamilyIndices_T(
+        const u32 graphicsQueue,
+        const u32 presentQueue,
+        const u32 transferQueue,
+        const u32 computeQueue)
+        : graphicsQueue(graphicsQueue),
+          presentQueue(presentQueue),
+          transferQueue(transferQueue),
+          computeQueue(computeQueue) {
     }
 
     [[nodiscard]] std::array<u32, 2> indices() const {
@@ -32,6 +59,34 @@ namespace leimu::feature {
 
 #define LEIMU_VK_T(t, n) using n = std::shared_ptr< t##_T >
 
+  LEIMU_VK_T(VkCommandPool, VulkanCommandPool);
+  LEIMU_VK_T(VkFence, VulkanFence);
+  LEIMU_VK_T(VkSemaphore, VulkanSemaphore);
+
+  /**
+   * Per-slot state of a frame in flight.
+   * The CPU records into a slot only after the GPU is done with it: its fence has been signaled,
+   * or with timeline semaphores, the graphics timeline has reached the slot's value.
+   */
+  struct VkFrame_T {
+    VulkanCommandPool commandPool;
+    VkCommandBuffer commandBuffer;
+    VulkanFence inFlight;
+    VulkanSemaphore imageAvailable;
+
+    u32 index;
+    u32 imageIndex;
+    u64 number;
+    // graphics timeline value signaled by the slot's last submission; 0 without timeline semaphores
+    u64 timeline = 0;
+
+    // extra semaphores the frame's submission waits on, e.g. for uploads it consumes
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<VkPipelineStageFlags> waitStages;
+    // extra semaphores the frame's submission signals, e.g. for compute work depending on it
+    std::vector<VkSemaphore> signalSemaphores;
+  };
+
   LEIMU_VK_T(VkInstance, VulkanInstance);
   LEIMU_VK_T(VkDebugUtilsMessengerEXT, VulkanDebugUtilsMessenger);
   LEIMU_VK_T(VkSurfaceKHR, VulkanSurface);
@@ -39,9 +94,23 @@ namespace leimu::feature {
   LEIMU_VK_T(VkPhysicalDevice, VulkanPhysicalDevice);
   LEIMU_VK_T(VkQueueFamilyIndices, VulkanQueueFamilyIndices);
   LEIMU_VK_T(VkDevice, VulkanDevice);
+  LEIMU_VK_T(VkCapabilities, VulkanCapabilities);
   LEIMU_VK_T(VkQueue, VulkanQueue);
   LEIMU_VK_T(VkSwapchainKHR, VulkanSwapchain);
   LEIMU_VK_T(VkImageView, VulkanImageView);
+  LEIMU_VK_T(VkRenderPass, VulkanRenderPass);
+  LEIMU_VK_T(VkFramebuffer, VulkanFramebuffer);
+  LEIMU_VK_T(VkPipelineCache, VulkanPipelineCache);
+  LEIMU_VK_T(VkFrame, VulkanFrame);
+
+  /**
+   * Handles which may still be referenced by frames submitted before they were replaced.
+   */
+  struct VkRetired_T {
+    // number of frames which have to be completed before handles can be released
+    u64 frames;
+    std::vector<std::shared_ptr<void>> handles;
+  };
 
   template<typename T>
   concept VulkanProxyable =
@@ -75,9 +144,12 @@ namespace leimu::feature {
       const GLFW &glfw) noexcept;
   [[nodiscard]] static int RatePhysicalDeviceSuitability(
       const VulkanPhysicalDevice &device,
-      const VulkanSurface &surface) noexcept;
+      const VulkanSurface &surface,
+      std::span<const VkCapability> requests) noexcept;
 
-  [[nodiscard]] static VulkanInstance CreateInstance(VkApplicationInfo info) noexcept;
+  [[nodiscard]] static VulkanInstance CreateInstance(
+      VkApplicationInfo info,
+      bool headless) noexcept;
 #if LEIMU_DEBUG
   [[nodiscard]] static VulkanDebugUtilsMessenger CreateDebugUtilsMessenger(const VulkanInstance &instance) noexcept;
 #endif
@@ -86,7 +158,8 @@ namespace leimu::feature {
       const GLFW &glfw) noexcept;
   [[nodiscard]] static VulkanPhysicalDevice GetPhysicalDevice(
       const VulkanInstance &instance,
-      const VulkanSurface &surface) noexcept;
+      const VulkanSurface &surface,
+      std::span<const VkCapability> requests) noexcept;
   [[nodiscard]] static VulkanSurfaceInfo RetrieveSurfaceInfo(
       const leimu::feature::VulkanPhysicalDevice &device,
       const leimu::feature::VulkanSurface &surface,
@@ -96,25 +169,71 @@ namespace leimu::feature {
       const VulkanSurface &surface) noexcept;
   [[nodiscard]] static VulkanDevice CreateDevice(
       const VulkanPhysicalDevice &phy,
-      const VulkanSurface &surface) noexcept;
+      const VulkanSurface &surface,
+      const VkNegotiation &negotiation) noexcept;
+  [[nodiscard]] static VulkanCapabilities GetCapabilities(
+      const VulkanPhysicalDevice &phy,
+      const VulkanDevice &device,
+      const VkNegotiation &negotiation) noexcept;
   [[nodiscard]] static VulkanSwapchain CreateSwapchain(
       const VulkanDevice &dev,
       const VulkanSurface &surface,
       const VulkanSurfaceInfo &surfaceInfo,
       VkExtent2D extent,
-      const VulkanQueueFamilyIndices &families) noexcept;
+      const VulkanQueueFamilyIndices &families,
+      const VulkanSwapchain &oldSwapchain) noexcept;
   [[nodiscard]] static VulkanQueue GetQueue(
       const VulkanDevice &device,
       u32 index) noexcept;
   [[nodiscard]] static std::vector<VkImage> GetImages(
       const leimu::feature::VulkanDevice &device,
       const leimu::feature::VulkanSwapchain &swapchain) noexcept;
+  [[nodiscard]] static std::shared_ptr<memory::Image_T> CreateOffscreenImage(
+      memory::Allocator &allocator,
+      VkFormat format,
+      VkExtent2D extent) noexcept;
   [[nodiscard]] static std::vector<VulkanImageView> CreateImageViews(
       const VulkanDevice& device,
       const std::vector<VkImage>& images,
-      const VulkanSurfaceInfo& surfaceInfo);
+      VkFormat format);
+  [[nodiscard]] static VulkanRenderPass CreateRenderPass(
+      const VulkanDevice &device,
+      VkFormat format,
+      VkImageLayout finalLayout) noexcept;
+  [[nodiscard]] static std::vector<VulkanFramebuffer> CreateFramebuffers(
+      const VulkanDevice &device,
+      const VulkanRenderPass &renderPass,
+      const std::vector<VulkanImageView> &views,
+      VkExtent2D extent) noexcept;
+  [[nodiscard]] VulkanCommandPool CreateCommandPool(
+      const VulkanDevice &device,
+      u32 family,
+      VkCommandPoolCreateFlags flags) noexcept;
+  [[nodiscard]] VulkanFence CreateFence(
+      const VulkanDevice &device,
+      bool signaled) noexcept;
+  [[nodiscard]] VulkanSemaphore CreateSemaphore(const VulkanDevice &device) noexcept;
+  [[nodiscard]] std::vector<VulkanSemaphore> CreateSemaphores(
+      const VulkanDevice &device,
+      size_t count) noexcept;
+  [[nodiscard]] static VulkanPipelineCache CreatePipelineCache(
+      const VulkanPhysicalDevice &phy,
+      const VulkanDevice &device,
+      const std::filesystem::path &path) noexcept;
+  static bool SavePipelineCache(
+      const VulkanPhysicalDevice &phy,
+      const VulkanDevice &device,
+      const VulkanPipelineCache &cache,
+      const std::filesystem::path &path) noexcept;
+  [[nodiscard]] static VulkanFrame CreateFrame(
+      const VulkanDevice &device,
+      const VulkanQueueFamilyIndices &families,
+      u32 index) noexcept;
 
   class Vulkan final : public Feature<Vulkan> {
+    bool _headless;
+    const GLFW *_glfw;
+
     VulkanInstance _instance;
 
 #if LEIMU_DEBUG
@@ -127,25 +246,104 @@ namespace leimu::feature {
 
     VulkanQueueFamilyIndices _queueIndices;
     VulkanDevice _device;
+    VulkanCapabilities _capabilities;
 
     VulkanQueue _graphicsQueue;
     VulkanQueue _presentQueue;
+    VulkanQueue _transferQueue;
+    VulkanQueue _computeQueue;
+
+    std::filesystem::path _pipelineCachePath;
+    VulkanPipelineCache _pipelineCache;
+
+    std::shared_ptr<memory::Allocator> _allocator;
+    std::shared_ptr<memory::Uploader> _uploader;
+    std::shared_ptr<render::AsyncCompute> _compute;
+    std::shared_ptr<render::DescriptorAllocator> _descriptors;
+    // null if the device can't do bindless
+    std::shared_ptr<render::Bindless> _bindless;
+    // null without timeline semaphores; frames then wait on fences
+    std::shared_ptr<render::Timelines> _timelines;
+    std::shared_ptr<render::DeletionQueue> _deletion;
+    std::shared_ptr<render::Profiler> _profiler;
 
+    VkExtent2D _extent{};
+    // framebuffer size the swapchain was built for; differs from _extent on some platforms
+    VkExtent2D _framebufferSize{};
+    bool _swapchainDirty = false;
+    VkFormat _format = VK_FORMAT_UNDEFINED;
     VulkanSwapchain _swapchain;
-    std::vector<VkImage> _swapchainImages;
-    std::vector<VulkanImageView> _swapchainViews;
+    // one offscreen target per frame slot in headless mode; empty otherwise
+    std::vector<std::shared_ptr<memory::Image_T>> _offscreenImages;
+    // swapchain images, or the offscreen targets in headless mode
+    std::vector<VkImage> _images;
+    std::vector<VulkanImageView> _imageViews;
+
+    VulkanRenderPass _renderPass;
+    std::vector<VulkanFramebuffer> _framebuffers;
+    // indexed by swapchain image; the presentation engine may still wait on it after the slot's fence signals
+    std::vector<VulkanSemaphore> _renderFinished;
+
+    std::vector<VulkanFrame> _frames;
+    u64 _frameNumber = 0;
+    u64 _completedFrames = 0;
+
+    [[nodiscard]] bool recreateSwapchain() noexcept;
+    // signals the slot's fence, or timeline value, with an empty batch consuming frame.waitSemaphores
+    // and signaling frame.signalSemaphores but the one for presentation; for frames that couldn't be submitted
+    void abandon(VkFrame_T &frame) noexcept;
 
   public:
     explicit Vulkan(const App &app);
+    ~Vulkan() override;
+
+    /**
+     * Waits for the next frame slot to be retired by the GPU, acquires a swapchain image
+     * (or picks the slot's offscreen target in headless mode) and begins recording the slot's command buffer.
+     * @return The frame to record into, or nullptr if no frame can be rendered now
+     */
+    [[nodiscard]] VkFrame_T *beginFrame() noexcept;
+
+    /**
+     * Ends recording, submits the frame to the graphics queue and presents its image unless headless.
+     */
+    void endFrame(VkFrame_T &frame) noexcept;
+
+    /**
+     * Blocks until the device has finished all submitted work; e.g. before owners of GPU handles are torn down.
+     * No frame may be recorded or submitted meanwhile.
+     */
+    void waitIdle() const noexcept;
 
 #define LEIMU_GETTER(p) [[nodiscard]] const decltype(_##p) & p () const { return _##p ; }
     LEIMU_GETTER(instance)
     LEIMU_GETTER(surface)
     LEIMU_GETTER(physicalDevice)
     LEIMU_GETTER(device)
+    LEIMU_GETTER(capabilities)
     LEIMU_GETTER(graphicsQueue)
     LEIMU_GETTER(presentQueue)
+    LEIMU_GETTER(transferQueue)
+    LEIMU_GETTER(computeQueue)
+    LEIMU_GETTER(queueIndices)
+    LEIMU_GETTER(pipelineCache)
+    LEIMU_GETTER(allocator)
+    LEIMU_GETTER(uploader)
+    LEIMU_GETTER(compute)
+    LEIMU_GETTER(descriptors)
+    LEIMU_GETTER(bindless)
+    LEIMU_GETTER(timelines)
+    LEIMU_GETTER(deletion)
+    LEIMU_GETTER(profiler)
+    LEIMU_GETTER(headless)
     LEIMU_GETTER(swapchain)
+    LEIMU_GETTER(extent)
+    LEIMU_GETTER(format)
+    LEIMU_GETTER(images)
+    LEIMU_GETTER(imageViews)
+    LEIMU_GETTER(renderPass)
+    LEIMU_GETTER(framebuffers)
+    LEIMU_GETTER(frames)
 #undef LEIMU_GETTER
 
     static std::string name() { return "Vulkan"; }
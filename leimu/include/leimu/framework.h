@@ -27,14 +27,29 @@ using f64 = double;
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <chrono>
+#include <optional>
+#include <span>
 #include <iostream>
 #include <map>
+#include <numeric>
 #include <set>
+#include <deque>
 #include <vector>
 #include <string>
 #include <memory>
+#include <functional>
 #include <filesystem>
 #include <fstream>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <thread>
 
 #if LEIMU_DEBUG
 inline VkResult CreateDebugUtilsMessengerEXT(
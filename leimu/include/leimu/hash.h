@@ -0,0 +1,14 @@
+#pragma once
+
+#include "leimu/framework.h"
+
+namespace leimu {
+  /**
+   * Non-cryptographic 64-bit hash (MurmurHash64A); consumes 8 bytes per round.
+   */
+  [[nodiscard]] u64 Hash(const void *data, size_t size, u64 seed = 0) noexcept;
+
+  [[nodiscard]] constexpr u64 HashCombine(const u64 seed, const u64 value) noexcept {
+    return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+  }
+}
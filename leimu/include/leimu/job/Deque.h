@@ -0,0 +1,72 @@
+#pragma once
+
+#include "leimu/framework.h"
+
+namespace leimu::job {
+
+  /**
+   * Bounded Chase-Lev work-stealing deque of pointers.
+   * Only the owning thread may push and pop (LIFO); any thread may steal (FIFO).
+   */
+  template<typename T, size_t N>
+  class Deque {
+    static_assert(std::has_single_bit(N), "capacity must be a power of two");
+
+    alignas(64) std::atomic<i64> _top = 0;
+    alignas(64) std::atomic<i64> _bottom = 0;
+    std::array<std::atomic<T *>, N> _buffer{};
+
+  public:
+    /**
+     * @return false if the deque is full
+     */
+    bool push(T *item) noexcept {
+      const auto b = _bottom.load(std::memory_order_relaxed);
+      if (b - _top.load(std::memory_order_acquire) >= static_cast<i64>(N)) {
+        return false;
+      }
+
+      _buffer[b & (N - 1)].store(item, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      _bottom.store(b + 1, std::memory_order_relaxed);
+      return true;
+    }
+
+    T *pop() noexcept {
+      const auto b = _bottom.load(std::memory_order_relaxed) - 1;
+      _bottom.store(b, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      auto t = _top.load(std::memory_order_relaxed);
+      if (t > b) {
+        _bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+      }
+
+      auto item = _buffer[b & (N - 1)].load(std::memory_order_relaxed);
+      if (t == b) {
+        // Last item; race thieves for it
+        if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+          item = nullptr;
+        }
+        _bottom.store(b + 1, std::memory_order_relaxed);
+      }
+      return item;
+    }
+
+    T *steal() noexcept {
+      auto t = _top.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      const auto b = _bottom.load(std::memory_order_acquire);
+      if (t >= b) {
+        return nullptr;
+      }
+
+      const auto item = _buffer[t & (N - 1)].load(std::memory_order_relaxed);
+      if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+      }
+      return item;
+    }
+  };
+}
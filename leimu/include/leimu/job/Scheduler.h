@@ -0,0 +1,109 @@
+#pragma once
+
+#include "leimu/framework.h"
+#include "leimu/job/Deque.h"
+
+namespace leimu {
+  class App;
+}
+
+namespace leimu::job {
+  class Scheduler;
+  struct Job;
+
+  /**
+   * Number of unfinished jobs signaling it; jobs may be held back until one reaches zero.
+   */
+  class Counter_T {
+    std::atomic<u32> _value = 0;
+    std::mutex _lock;
+    // jobs waiting for this counter to reach zero
+    std::vector<Job *> _continuations;
+
+    friend class Scheduler;
+
+  public:
+    [[nodiscard]] bool done() const { return _value.load(std::memory_order_acquire) == 0; }
+  };
+
+  using Counter = std::shared_ptr<Counter_T>;
+
+  struct Job {
+    std::function<void()> fn;
+    Counter signal;
+  };
+
+  /**
+   * Shared pool of worker threads, one work-stealing deque each.
+   * Jobs submitted from a worker go to its own deque; others go through a shared queue.
+   * Background jobs (e.g. shader compilation) run only on workers, so a thread helping in wait() never stalls on one.
+   * Jobs still queued on destruction are finished before the workers join.
+   */
+  class Scheduler {
+    static constexpr size_t DequeSize = 4096;
+
+    std::vector<std::unique_ptr<Deque<Job, DequeSize>>> _deques;
+
+    std::mutex _queueLock;
+    std::deque<Job *> _queue;
+    std::deque<Job *> _background;
+
+    std::atomic<i64> _queued = 0;
+    std::atomic<u32> _sleeping = 0;
+    std::mutex _lock;
+    std::condition_variable_any _signal;
+
+    std::vector<std::jthread> _workers;
+
+    void schedule(Job *job, bool background);
+    void execute(Job *job);
+    [[nodiscard]] Job *take(u32 thread, bool background);
+    void work(u32 thread, const std::stop_token &token);
+
+    void submit(std::function<void()> fn, const Counter &signal, const Counter &after, bool background);
+
+  public:
+    explicit Scheduler(const App &app);
+    ~Scheduler();
+
+    /**
+     * Runs fn once after (if any) reaches zero; signal (if any) is decremented when it returns.
+     */
+    void run(std::function<void()> fn, const Counter &signal = nullptr, const Counter &after = nullptr);
+
+    /**
+     * Runs fn once after reaches zero.
+     * @return Counter reaching zero when fn has returned, to chain further jobs on
+     */
+    [[nodiscard]] Counter then(const Counter &after, std::function<void()> fn);
+
+    void background(std::function<void()> fn, const Counter &signal = nullptr);
+
+    /**
+     * Executes other jobs until counter reaches zero.
+     */
+    void wait(const Counter &counter);
+
+    /**
+     * Calls fn(begin, end) over [0, count) in chunks of grain, and returns once every chunk is done.
+     * The calling thread takes part.
+     */
+    template<typename F>
+    void parallelFor(const u32 count, const u32 grain, F &&fn) {
+      const auto step = std::max(grain, 1u);
+      const auto counter = std::make_shared<Counter_T>();
+      for (u32 begin = 0; begin < count; begin += step) {
+        const auto end = std::min(count, begin + step);
+        run([&fn, begin, end] { fn(begin, end); }, counter);
+      }
+      wait(counter);
+    }
+
+    /**
+     * @return Index of the calling worker in [1, threads()), or 0 for any other thread
+     */
+    [[nodiscard]] static u32 index();
+
+    [[nodiscard]] u32 threads() const { return static_cast<u32>(_workers.size()) + 1; }
+  };
+}
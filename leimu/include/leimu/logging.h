@@ -2,7 +2,53 @@
 
 #include "leimu/framework.h"
 
+#ifndef LEIMU_LOG_LEVEL
+#if LEIMU_DEBUG
+#define LEIMU_LOG_LEVEL 0
+#else
+#define LEIMU_LOG_LEVEL 1
+#endif
+#endif
+
 namespace leimu {
-  std::ostream& outs();
-  std::ostream& errs();
+  enum class LogLevel : u8 {
+    Debug,
+    Info,
+    Warning,
+    Error,
+    None,
+  };
+
+  // Levels below this resolve to a null stream at compile time; set with -DLEIMU_LOG_LEVEL=<0..4>
+  constexpr auto CompiledLogLevel = static_cast<LogLevel>(LEIMU_LOG_LEVEL);
+
+  /**
+   * Stream of the calling thread for the given level, or a null stream if the level is filtered out.
+   * A message ends with a newline (e.g. std::println) and is handed to a background writer without blocking;
+   * messages are dropped, and counted, if the thread's queue is full.
+   */
+  std::ostream &logs(LogLevel level);
+  std::ostream &nulls();
+
+  template<LogLevel Level>
+  std::ostream &logs() {
+    if constexpr (Level < CompiledLogLevel) {
+      return nulls();
+    } else {
+      return logs(Level);
+    }
+  }
+
+  inline std::ostream &dbgs() { return logs<LogLevel::Debug>(); }
+  inline std::ostream &outs() { return logs<LogLevel::Info>(); }
+  inline std::ostream &warns() { return logs<LogLevel::Warning>(); }
+  inline std::ostream &errs() { return logs<LogLevel::Error>(); }
+
+  void SetLogLevel(LogLevel level);
+  [[nodiscard]] LogLevel GetLogLevel();
+
+  /**
+   * Blocks until every message logged so far is written.
+   */
+  void FlushLogs();
 }
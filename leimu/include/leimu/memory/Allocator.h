@@ -0,0 +1,197 @@
+#pragma once
+
+#include "leimu/framework.h"
+#include "leimu/feature/Vulkan.h"
+
+namespace leimu::memory {
+  class Allocator;
+
+  /**
+   * Resources sharing a page of at most bufferImageGranularity must be of the same kind,
+   * so each kind gets its own blocks.
+   */
+  enum class ResourceKind : u8 {
+    // buffers and linearly tiled images
+    Linear,
+    // optimally tiled images
+    Optimal,
+  };
+
+  struct MemoryBlock_T;
+
+  class Allocation_T {
+    friend class Allocator;
+
+    VkDeviceMemory _memory = VK_NULL_HANDLE;
+    VkDeviceSize _offset = 0;
+    VkDeviceSize _size = 0;
+    void *_mapped = nullptr;
+    u32 _type = 0;
+
+    // owning block of a sub-allocation; null for dedicated and per-frame allocations
+    MemoryBlock_T *_block = nullptr;
+    u32 _order = 0;
+    bool _dedicated = false;
+
+  public:
+    [[nodiscard]] VkDeviceMemory memory() const { return _memory; }
+    [[nodiscard]] VkDeviceSize offset() const { return _offset; }
+    [[nodiscard]] VkDeviceSize size() const { return _size; }
+    [[nodiscard]] u32 type() const { return _type; }
+    [[nodiscard]] bool dedicated() const { return _dedicated; }
+
+    /**
+     * @return Host pointer to the first byte of the allocation, or nullptr if not host-visible
+     */
+    [[nodiscard]] void *mapped() const { return _mapped; }
+  };
+
+  using Allocation = std::shared_ptr<Allocation_T>;
+
+  struct Buffer_T {
+    VkBuffer handle;
+    VkDeviceSize size;
+    Allocation allocation;
+  };
+
+  struct Image_T {
+    VkImage handle;
+    VkFormat format;
+    VkExtent3D extent;
+    u32 mipLevels;
+    u32 arrayLayers;
+    Allocation allocation;
+  };
+
+  using Buffer = std::shared_ptr<Buffer_T>;
+  using Image = std::shared_ptr<Image_T>;
+
+  struct MemoryBlock_T {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    void *mapped;
+    u32 type;
+
+    u32 maxOrder;
+    VkDeviceSize used = 0;
+    // free buddy nodes by order (node size is 1 << order)
+    std::vector<std::set<VkDeviceSize>> free;
+    std::map<VkDeviceSize, Allocation_T *> live;
+  };
+
+  struct AllocatorStatistics {
+    u32 blocks;
+    u32 dedicated;
+    VkDeviceSize reserved;
+    VkDeviceSize used;
+  };
+
+  /**
+   * Device memory sub-allocator.
+   * General-purpose allocations come from large per-type blocks split with a buddy scheme;
+   * allocations larger than half a block get dedicated memory.
+   * Per-frame allocations are bumped from linear blocks which are reset in bulk once the frame slot is retired.
+   * Thread-safe.
+   */
+  class Allocator : public std::enable_shared_from_this<Allocator> {
+    struct LinearBlock {
+      VkDeviceMemory memory;
+      VkDeviceSize size;
+      VkDeviceSize head;
+      void *mapped;
+    };
+
+    struct Pool {
+      std::vector<std::unique_ptr<MemoryBlock_T>> blocks;
+    };
+
+    feature::VulkanDevice _device;
+    VkPhysicalDeviceMemoryProperties _properties{};
+    VkDeviceSize _granularity;
+    u32 _maxAllocationCount;
+    VkDeviceSize _blockSize;
+    VkDeviceSize _linearBlockSize;
+
+    mutable std::mutex _lock;
+    std::map<std::pair<u32, ResourceKind>, Pool> _pools;
+    // [frame slot][memory type]
+    std::vector<std::map<u32, std::vector<LinearBlock>>> _linear;
+    u32 _allocationCount = 0;
+    u32 _dedicatedCount = 0;
+
+    [[nodiscard]] VkDeviceMemory allocateMemory(VkDeviceSize size, u32 type, void **mapped) noexcept;
+    void freeMemory(VkDeviceMemory memory, bool mapped) noexcept;
+
+    [[nodiscard]] MemoryBlock_T *createBlock(u32 type) noexcept;
+    void release(const Allocation_T &allocation) noexcept;
+
+  public:
+    Allocator(
+        const feature::VulkanPhysicalDevice &phy,
+        feature::VulkanDevice device,
+        u32 framesInFlight) noexcept;
+    ~Allocator();
+
+    /**
+     * Picks a memory type having all required and, if possible, all preferred properties.
+     * @return Memory type index, or -1 if there is none
+     */
+    [[nodiscard]] u32 findMemoryType(
+        u32 typeBits,
+        VkMemoryPropertyFlags required,
+        VkMemoryPropertyFlags preferred = 0) const noexcept;
+
+    [[nodiscard]] Allocation allocate(
+        const VkMemoryRequirements &requirements,
+        VkMemoryPropertyFlags required,
+        VkMemoryPropertyFlags preferred,
+        ResourceKind kind) noexcept;
+
+    /**
+     * Bump-allocates from the linear pool of a frame slot. Meant for buffers only.
+     * The allocation is invalidated by resetLinear(slot); holding it longer is a use-after-free.
+     */
+    [[nodiscard]] Allocation allocateLinear(
+        u32 slot,
+        const VkMemoryRequirements &requirements,
+        VkMemoryPropertyFlags required,
+        VkMemoryPropertyFlags preferred = 0) noexcept;
+
+    /**
+     * Recycles every per-frame allocation of the slot. Call once the slot's fence has signaled.
+     */
+    void resetLinear(u32 slot) noexcept;
+
+    [[nodiscard]] Buffer createBuffer(
+        const VkBufferCreateInfo &createInfo,
+        VkMemoryPropertyFlags required,
+        VkMemoryPropertyFlags preferred = 0) noexcept;
+
+    [[nodiscard]] Image createImage(
+        const VkImageCreateInfo &createInfo,
+        VkMemoryPropertyFlags required,
+        VkMemoryPropertyFlags preferred = 0) noexcept;
+
+    /**
+     * Called for each planned move. It must copy the contents of `from` into `to` (and rebind/recreate
+     * the owning resource); returning true commits the move, after which `from` refers to the new location.
+     * It must not call back into the allocator.
+     */
+    using DefragmentCallback = std::function<bool(const Allocation_T &from, const Allocation_T &to)>;
+
+    /**
+     * Moves live allocations out of blocks used below threshold and frees blocks left empty.
+     * @return Number of allocations moved
+     */
+    u32 defragment(const DefragmentCallback &move, f32 threshold = 0.25f) noexcept;
+
+    [[nodiscard]] AllocatorStatistics statistics() const noexcept;
+
+    [[nodiscard]] const feature::VulkanDevice &device() const { return _device; }
+  };
+
+  [[nodiscard]] std::shared_ptr<Allocator> CreateAllocator(
+      const feature::VulkanPhysicalDevice &phy,
+      const feature::VulkanDevice &device,
+      u32 framesInFlight) noexcept;
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "leimu/framework.h"
+#include "leimu/feature/Vulkan.h"
+#include "leimu/memory/Allocator.h"
+#include "leimu/render/Timeline.h"
+
+namespace leimu::memory {
+
+  /**
+   * Stages uploads through a persistently mapped ring buffer and copies them on the transfer queue.
+   * Copies are batched; a batch is submitted by flush() and consumed by the graphics queue via acquire(),
+   * which records the queue family ownership transfers and hands out the semaphore to wait on.
+   * upload() may be called from any thread; flush() and acquire() belong to the frame thread.
+   * With timeline semaphores, batches are submitted through the transfer timeline and tracked by its values.
+   */
+  class Uploader {
+    struct Batch {
+      feature::VulkanCommandPool pool;
+      VkCommandBuffer commandBuffer;
+      // null with a timeline
+      feature::VulkanFence fence;
+      feature::VulkanSemaphore semaphore;
+
+      std::vector<VkBufferMemoryBarrier> bufferReleases;
+      std::vector<VkImageMemoryBarrier> imageReleases;
+      std::vector<VkBufferMemoryBarrier> bufferAcquires;
+      std::vector<VkImageMemoryBarrier> imageAcquires;
+      // destinations are kept alive until the graphics queue has consumed them
+      std::vector<std::shared_ptr<void>> resources;
+      // recorded into the graphics command buffer right after the acquisition
+      std::vector<std::function<void(VkCommandBuffer)>> acquired;
+
+      // ring head at submission; everything before it is free once the fence signals
+      VkDeviceSize end = 0;
+      // transfer timeline value signaled by the submission
+      u64 value = 0;
+      // frame which waits on the semaphore
+      u64 acquiredBy = UINT64_MAX;
+      // reservations blocked on the fence; flush() doesn't recycle, and so reset, the batch while there are any
+      u32 waiters = 0;
+      bool empty = true;
+    };
+
+    feature::VulkanDevice _device;
+    feature::VulkanQueue _queue;
+    // null without timeline semaphores
+    render::Timeline _timeline;
+    u32 _transferFamily;
+    u32 _graphicsFamily;
+
+    Buffer _ring;
+    u8 *_mapped;
+    VkDeviceSize _capacity;
+    // monotonic byte counters; the ring offset is the counter modulo capacity
+    VkDeviceSize _head = 0;
+    VkDeviceSize _tail = 0;
+
+    std::mutex _lock;
+    std::unique_ptr<Batch> _recording;
+    std::deque<std::unique_ptr<Batch>> _inFlight;
+    std::vector<std::unique_ptr<Batch>> _free;
+
+    [[nodiscard]] bool ownershipTransfer() const { return _transferFamily != _graphicsFamily; }
+
+    [[nodiscard]] Batch *recording() noexcept;
+    [[nodiscard]] std::optional<VkDeviceSize> reserve(std::unique_lock<std::mutex> &lock, VkDeviceSize size) noexcept;
+    void reclaim() noexcept;
+    // Whether an upload of size bytes in chunks can get ring space by waiting for submitted batches alone
+    [[nodiscard]] bool fits(VkDeviceSize size, VkDeviceSize chunkSize) const noexcept;
+    // Clears a batch for reuse
+    void recycle(Batch &batch) noexcept;
+    [[nodiscard]] bool done(const Batch &batch) const noexcept;
+    // Blocks until the batch's copies are done; unlocked
+    void wait(const Batch &batch) const noexcept;
+
+    // Ownership release of a buffer range; keeps dst alive
+    void release(Batch *batch, const Buffer &dst, VkDeviceSize offset, VkDeviceSize size) noexcept;
+    // Layout transitions, the copy itself and the ownership release of an image; keeps dst alive
+    void record(
+        Batch *batch,
+        VkBuffer src,
+        VkDeviceSize srcOffset,
+        const Image &dst,
+        std::span<const VkBufferImageCopy> regions,
+        VkImageLayout finalLayout,
+        std::function<void(VkCommandBuffer)> onAcquire) noexcept;
+
+  public:
+    Uploader(
+        feature::VulkanDevice device,
+        const std::shared_ptr<Allocator> &allocator,
+        const feature::VulkanQueueFamilyIndices &families,
+        feature::VulkanQueue transferQueue,
+        render::Timeline timeline,
+        VkDeviceSize capacity) noexcept;
+
+    [[nodiscard]] bool operator!() const { return !_ring; }
+    [[nodiscard]] VkDeviceSize capacity() const { return _capacity; }
+
+    /**
+     * Copies data into dst. Blocks while the ring is full of in-flight copies.
+     * @return false if the ring can't hold the data until the next flush; chunks copied by then stay released
+     */
+    bool upload(
+        const Buffer &dst,
+        VkDeviceSize dstOffset,
+        const void *data,
+        VkDeviceSize size) noexcept;
+
+    /**
+     * Copies data into dst and leaves every subresource in finalLayout.
+     * bufferOffset of each region is relative to data.
+     * onAcquire, if any, is recorded into the graphics frame which acquires the image, right after acquisition;
+     * it runs on the frame thread with the uploader locked, so it must not call back into it.
+     * @return false if the ring can't hold the data until the next flush
+     */
+    bool upload(
+        const Image &dst,
+        const void *data,
+        VkDeviceSize size,
+        std::span<const VkBufferImageCopy> regions,
+        VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        std::function<void(VkCommandBuffer)> onAcquire = {}) noexcept;
+
+    /**
+     * Like upload(), but from a buffer the caller filled (e.g. by a direct file read) instead of the ring.
+     * src needs TRANSFER_SRC usage and is kept alive until the copy is consumed.
+     */
+    bool copy(
+        const Buffer &src,
+        VkDeviceSize srcOffset,
+        const Buffer &dst,
+        VkDeviceSize dstOffset,
+        VkDeviceSize size) noexcept;
+
+    /**
+     * Like upload(), but from a buffer the caller filled; bufferOffset of each region is relative to src.
+     */
+    bool copy(
+        const Buffer &src,
+        const Image &dst,
+        std::span<const VkBufferImageCopy> regions,
+        VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        std::function<void(VkCommandBuffer)> onAcquire = {}) noexcept;
+
+    /**
+     * Submits the copies recorded so far and recycles batches consumed by completed frames.
+     */
+    void flush(u64 completedFrames) noexcept;
+
+    /**
+     * Records the ownership acquisition of every submitted batch into a graphics command buffer
+     * and appends the semaphores its submission has to wait on.
+     */
+    void acquire(
+        VkCommandBuffer commandBuffer,
+        u64 frame,
+        std::vector<VkSemaphore> &waitSemaphores,
+        std::vector<VkPipelineStageFlags> &waitStages) noexcept;
+  };
+
+  [[nodiscard]] std::shared_ptr<Uploader> CreateUploader(
+      const feature::VulkanDevice &device,
+      const std::shared_ptr<Allocator> &allocator,
+      const feature::VulkanQueueFamilyIndices &families,
+      const feature::VulkanQueue &transferQueue,
+      const render::Timeline &timeline,
+      VkDeviceSize capacity) noexcept;
+}
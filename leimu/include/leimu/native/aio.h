@@ -0,0 +1,93 @@
+#pragma once
+
+#include "leimu/framework.h"
+#include "leimu/job/Scheduler.h"
+
+namespace leimu::native {
+  /**
+   * Offset, size and buffer address of direct reads have to be multiples of it.
+   */
+  constexpr size_t DirectAlignment = 4096;
+
+  class File_T;
+  using File = std::shared_ptr<File_T>;
+
+#if __unix__
+  class File_T {
+    int _fd;
+    size_t _size;
+    bool _direct;
+
+  public:
+    File_T(int fd, size_t size, bool direct) : _fd(fd), _size(size), _direct(direct) {}
+
+    [[nodiscard]] int fd() const { return _fd; }
+    [[nodiscard]] size_t size() const { return _size; }
+    // whether reads bypass the page cache
+    [[nodiscard]] bool direct() const { return _direct; }
+  };
+#elif _WIN32
+#error Not implemented
+#else
+#error Unknown operation system
+#endif
+
+  /**
+   * @param direct Bypass the page cache (O_DIRECT); falls back to buffered reads where the file system can't
+   */
+  [[nodiscard]] File OpenFile(std::filesystem::path path, bool direct = false) noexcept;
+
+  /**
+   * @param result Bytes read (short only at the end of the file), or a negated errno
+   */
+  using ReadCallback = std::function<void(i64 result)>;
+
+  struct ReadRequest {
+    File file;
+    u64 offset;
+    // for direct files, offset, size and address must be aligned to DirectAlignment
+    std::span<u8> buffer;
+    // runs as a job on the scheduler
+    ReadCallback done;
+  };
+
+  /**
+   * Asynchronous file reads with a bounded number in flight, so latency stays predictable under load.
+   * Uses io_uring where the kernel allows it, otherwise a small pool of threads calling pread.
+   * Reads into registered buffers (e.g. persistently mapped staging memory) skip per-read page pinning;
+   * paired with direct files they go from disk to staging without passing through the page cache.
+   * Completions are handed to the job scheduler; the scheduler must outlive the reader.
+   */
+  class FileReader {
+  public:
+    class Backend;
+
+  private:
+    job::Scheduler &_jobs;
+    std::unique_ptr<Backend> _backend;
+
+  public:
+    /**
+     * @param depth Reads in flight at most; further ones wait in submission order
+     */
+    explicit FileReader(job::Scheduler &jobs, u32 depth = 64) noexcept;
+    ~FileReader();
+
+    [[nodiscard]] bool operator!() const { return !_backend; }
+
+    // whether reads go through io_uring
+    [[nodiscard]] bool uring() const;
+
+    /**
+     * Registers the buffers reads may target with the kernel; at most once, before any read.
+     * Reads into other memory still work, just without the benefit.
+     */
+    bool registerBuffers(std::span<const std::span<u8>> buffers) noexcept;
+
+    /**
+     * Queues reads; a batch is submitted with a single system call. Callable from any thread.
+     */
+    void read(std::span<ReadRequest> requests);
+    void read(ReadRequest request) { read({&request, 1}); }
+  };
+}
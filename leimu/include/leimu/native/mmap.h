@@ -3,6 +3,19 @@
 #include "leimu/framework.h"
 
 namespace leimu::native {
+  /**
+   * Expected access pattern of mapped memory, passed on to the kernel's readahead.
+   */
+  enum class Advice : u8 {
+    Normal,
+    Sequential,
+    Random,
+    // read ahead now
+    WillNeed,
+    // drop the pages; they are read again on the next access
+    DontNeed,
+  };
+
   class FileMapping_T;
   using FileMapping = std::shared_ptr<FileMapping_T>;
 
@@ -16,6 +29,11 @@ namespace leimu::native {
 
     [[nodiscard]] const void* ptr() const { return _p; }
     [[nodiscard]] size_t size() const { return _size; }
+
+    /**
+     * Hints how [offset, offset + size) is about to be accessed; the range is widened to whole pages.
+     */
+    void advise(size_t offset, size_t size, Advice advice) const noexcept;
   };
 #elif _WIN32
 #error Not implemented
@@ -23,5 +41,5 @@ namespace leimu::native {
 #error Unknown operation system
 #endif
 
-  [[nodiscard]] FileMapping CreateFileMapping(std::filesystem::path path) noexcept;
+  [[nodiscard]] FileMapping CreateFileMapping(std::filesystem::path path, Advice advice = Advice::Normal) noexcept;
 }
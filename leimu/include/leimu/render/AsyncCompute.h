@@ -0,0 +1,82 @@
+#pragma once
+
+#include "leimu/framework.h"
+#include "leimu/feature/Vulkan.h"
+#include "leimu/render/Timeline.h"
+
+namespace leimu::render {
+
+  /**
+   * Submits compute work to the compute queue so that it overlaps rasterization.
+   * Results are handed to the next graphics frame through semaphores; graphics results can be handed
+   * to compute work with after(). Resources touched by both queues should be created with
+   * VK_SHARING_MODE_CONCURRENT over families() when the compute family differs from graphics.
+   * With timeline semaphores, submissions go through the compute timeline and are tracked by its values.
+   * Frame thread only.
+   */
+  class AsyncCompute {
+    struct Batch {
+      feature::VulkanCommandPool pool;
+      VkCommandBuffer commandBuffer;
+      // null with a timeline
+      feature::VulkanFence fence;
+      // compute -> graphics
+      feature::VulkanSemaphore finished;
+      // graphics -> compute
+      feature::VulkanSemaphore ready;
+
+      bool waitsOnGraphics = false;
+      VkPipelineStageFlags consumerStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+      u64 consumedBy = UINT64_MAX;
+      // compute timeline value signaled by the submission
+      u64 value = 0;
+    };
+
+    feature::VulkanDevice _device;
+    feature::VulkanQueue _queue;
+    // null without timeline semaphores
+    Timeline _timeline;
+    u32 _family;
+    std::vector<u32> _families;
+
+    std::unique_ptr<Batch> _next;
+    std::deque<std::unique_ptr<Batch>> _inFlight;
+    std::vector<std::unique_ptr<Batch>> _free;
+
+    [[nodiscard]] Batch *next() noexcept;
+
+  public:
+    AsyncCompute(
+        feature::VulkanDevice device,
+        const feature::VulkanQueueFamilyIndices &families,
+        feature::VulkanQueue queue,
+        Timeline timeline) noexcept;
+
+    /**
+     * Makes the next submission wait until the graphics work of frame has finished.
+     * Call between beginFrame() and endFrame(); submit() must follow endFrame().
+     */
+    void after(feature::VkFrame_T &frame) noexcept;
+
+    /**
+     * Records and submits compute work. The next graphics frame waits for it at consumerStage only,
+     * so earlier stages of that frame still overlap with it.
+     */
+    bool submit(
+        const std::function<void(VkCommandBuffer)> &record,
+        VkPipelineStageFlags consumerStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT) noexcept;
+
+    /**
+     * Appends the semaphores of every unconsumed submission to a graphics frame's waits
+     * and recycles submissions consumed by completed frames.
+     */
+    void consume(
+        u64 frame,
+        u64 completedFrames,
+        std::vector<VkSemaphore> &waitSemaphores,
+        std::vector<VkPipelineStageFlags> &waitStages) noexcept;
+
+    [[nodiscard]] bool async() const { return _families.size() > 1; }
+    [[nodiscard]] const std::vector<u32> &families() const { return _families; }
+  };
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "leimu/framework.h"
+#include "leimu/feature/Vulkan.h"
+#include "leimu/render/Descriptor.h"
+#include "leimu/render/Pipeline.h"
+
+namespace leimu::render {
+
+  /**
+   * Arrays of the bindless set; the value is the binding.
+   */
+  enum class BindlessType : u8 {
+    SampledImage,
+    StorageBuffer,
+    Sampler,
+  };
+
+  struct BindlessCapacity {
+    u32 sampledImages = 16384;
+    u32 storageBuffers = 8192;
+    u32 samplers = 256;
+  };
+
+  /**
+   * One descriptor set holding every registered resource, bound once per command buffer.
+   * Resources are registered into free slots of partially bound arrays and referenced by their index,
+   * e.g. from push constants, so switching materials rebinds nothing. The set is update-after-bind:
+   * resources may be added while frames using the set are being recorded or executed.
+   * A removed slot is reused only once the frames which could have read it are completed;
+   * the resource itself has to live as long. Shaders declare the set with data/bindless.glsl.
+   * Thread-safe.
+   */
+  class Bindless {
+    struct Table {
+      u32 capacity = 0;
+      // slots below it have been handed out at least once
+      u32 next = 0;
+      std::vector<u32> free;
+      // (first frame which can't read the slot, slot)
+      std::deque<std::pair<u64, u32>> retired;
+    };
+
+    feature::VulkanDevice _device;
+    DescriptorSetLayout _layout;
+    DescriptorPool _pool;
+    VkDescriptorSet _set = VK_NULL_HANDLE;
+
+    std::mutex _lock;
+    std::array<Table, 3> _tables;
+    u64 _frame = 0;
+
+    [[nodiscard]] u32 acquire(BindlessType type);
+    void write(BindlessType type, u32 index, const VkDescriptorImageInfo *image, const VkDescriptorBufferInfo *buffer);
+
+  public:
+    static constexpr u32 None = UINT32_MAX;
+
+    /**
+     * Capacities are clamped to the device's limits.
+     */
+    Bindless(
+        feature::VulkanDevice device,
+        const feature::VkCapabilities_T &capabilities,
+        DescriptorLayoutCache &layouts,
+        BindlessCapacity capacity = {}) noexcept;
+
+    [[nodiscard]] bool operator!() const { return !_set; }
+
+    /**
+     * @return Index into the sampled image array, or None if full
+     */
+    [[nodiscard]] u32 add(VkImageView view, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    /**
+     * @return Index into the storage buffer array, or None if full
+     */
+    [[nodiscard]] u32 add(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+    /**
+     * @return Index into the sampler array, or None if full
+     */
+    [[nodiscard]] u32 add(VkSampler sampler);
+
+    void remove(BindlessType type, u32 index);
+
+    /**
+     * Frees slots removed before completedFrames. Called by feature::Vulkan at the start of each frame.
+     */
+    void collect(u64 frame, u64 completedFrames);
+
+    void bind(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, u32 set = 0) const;
+
+    /**
+     * Pipeline layout with the bindless set at set 0 and a push constant range for resource indices.
+     */
+    [[nodiscard]] PipelineLayout createPipelineLayout(
+        u32 pushConstantSize,
+        VkShaderStageFlags stages = VK_SHADER_STAGE_ALL) const noexcept;
+
+    [[nodiscard]] const DescriptorSetLayout &layout() const { return _layout; }
+    [[nodiscard]] u32 capacity(BindlessType type) const { return _tables[static_cast<u8>(type)].capacity; }
+  };
+}
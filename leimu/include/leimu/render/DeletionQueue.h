@@ -0,0 +1,54 @@
+#pragma once
+
+#include "leimu/framework.h"
+#include "leimu/feature/Vulkan.h"
+#include "leimu/render/Timeline.h"
+
+namespace leimu::render {
+
+  /**
+   * Keeps handles alive until the GPU is done with them, so that replacing a resource never needs the device idle.
+   * Handles are released by dropping the queue's reference; whatever else still holds them keeps them.
+   * Thread-safe.
+   */
+  class DeletionQueue {
+    struct TimelineRetired {
+      Timeline timeline;
+      u64 value;
+      std::vector<std::shared_ptr<void>> handles;
+    };
+
+    std::mutex _lock;
+    // frame being recorded, or the last one if between frames
+    u64 _frame = 0;
+    std::vector<feature::VkRetired_T> _frames;
+    std::vector<TimelineRetired> _timelines;
+
+  public:
+    /**
+     * Releases handles once the frame being recorded, and every one before it, has completed.
+     */
+    void retire(std::vector<std::shared_ptr<void>> handles);
+
+    /**
+     * Releases handles once frames frames have completed.
+     */
+    void retire(u64 frames, std::vector<std::shared_ptr<void>> handles);
+
+    /**
+     * Releases handles once timeline has reached value, e.g. for work submitted to the transfer queue.
+     */
+    void retire(Timeline timeline, u64 value, std::vector<std::shared_ptr<void>> handles);
+
+    /**
+     * Releases whatever the GPU is done with. Called by feature::Vulkan as it begins a frame.
+     * @param frame Number of the frame about to be recorded
+     */
+    void collect(u64 frame, u64 completedFrames);
+
+    /**
+     * Releases everything; only once the device is idle.
+     */
+    void flush();
+  };
+}
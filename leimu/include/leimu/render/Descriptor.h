@@ -0,0 +1,69 @@
+#pragma once
+
+#include "leimu/framework.h"
+#include "leimu/feature/Vulkan.h"
+
+namespace leimu::render {
+
+  LEIMU_VK_T(VkDescriptorSetLayout, DescriptorSetLayout);
+  LEIMU_VK_T(VkDescriptorPool, DescriptorPool);
+
+  /**
+   * Deduplicates descriptor set layouts by the hash of their bindings and binding flags. Thread-safe.
+   */
+  class DescriptorLayoutCache {
+    struct Entry {
+      std::vector<VkDescriptorSetLayoutBinding> bindings;
+      // parallel to bindings; empty without VkDescriptorSetLayoutBindingFlagsCreateInfo
+      std::vector<VkDescriptorBindingFlags> bindingFlags;
+      VkDescriptorSetLayoutCreateFlags flags;
+      DescriptorSetLayout layout;
+    };
+
+    feature::VulkanDevice _device;
+
+    std::mutex _lock;
+    std::map<u64, std::vector<Entry>> _layouts;
+
+  public:
+    explicit DescriptorLayoutCache(feature::VulkanDevice device) : _device(std::move(device)) {}
+
+    /**
+     * Immutable samplers are not supported; pImmutableSamplers must be null.
+     * @param bindingFlags Empty, or the flags of each of bindings, in the same order
+     */
+    [[nodiscard]] DescriptorSetLayout get(
+        std::span<const VkDescriptorSetLayoutBinding> bindings,
+        VkDescriptorSetLayoutCreateFlags flags = 0,
+        std::span<const VkDescriptorBindingFlags> bindingFlags = {}) noexcept;
+  };
+
+  /**
+   * Allocates transient descriptor sets from pools owned by a frame slot.
+   * Sets are never freed one by one; all pools of a slot are reset in bulk once its fence has signaled.
+   * Pools are added when the current ones run out and are kept for reuse. Thread-safe.
+   */
+  class DescriptorAllocator {
+    struct Slot {
+      std::mutex lock;
+      std::vector<DescriptorPool> used;
+      std::vector<DescriptorPool> ready;
+      u32 setsPerPool;
+    };
+
+    feature::VulkanDevice _device;
+    std::vector<std::unique_ptr<Slot>> _slots;
+    DescriptorLayoutCache _layouts;
+
+    [[nodiscard]] DescriptorPool createPool(u32 sets) const noexcept;
+
+  public:
+    DescriptorAllocator(feature::VulkanDevice device, u32 framesInFlight) noexcept;
+
+    [[nodiscard]] VkDescriptorSet allocate(u32 slot, VkDescriptorSetLayout layout) noexcept;
+
+    void reset(u32 slot) noexcept;
+
+    [[nodiscard]] DescriptorLayoutCache &layouts() { return _layouts; }
+  };
+}
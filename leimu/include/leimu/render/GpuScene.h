@@ -0,0 +1,137 @@
+#pragma once
+
+#include "leimu/framework.h"
+#include "leimu/feature/Vulkan.h"
+#include "leimu/memory/Allocator.h"
+#include "leimu/render/Descriptor.h"
+#include "leimu/render/PipelineCompiler.h"
+
+namespace leimu::render {
+
+  /**
+   * Range of the shared index and vertex buffers making up a mesh.
+   */
+  struct DrawMesh {
+    u32 indexCount;
+    u32 firstIndex;
+    i32 vertexOffset;
+  };
+  static_assert(sizeof(DrawMesh) == 12);
+
+  /**
+   * Per-object data, laid out as in the instance buffer (std430).
+   */
+  struct DrawInstance {
+    glm::mat4 transform;
+    // local-space bounding sphere: centre in xyz, radius in w
+    glm::vec4 bounds;
+    u32 mesh;
+    u32 padding[3];
+  };
+  static_assert(sizeof(DrawInstance) == 96);
+
+  /**
+   * Scene submitted with a single indirect draw per frame.
+   * Objects live in device-local buffers and only changed ones are copied each frame;
+   * a compute pass frustum-culls them and compacts the visible ones into draw commands,
+   * which vkCmdDrawIndexedIndirectCount consumes without reading anything back.
+   * Without VK_KHR_draw_indirect_count, every slot is drawn and culled ones have no instances.
+   *
+   * All meshes share the index and vertex buffers bound before draw(). Vertex shaders read their object
+   * from the std430 array of DrawInstance at binding 0 of layout(), indexed by gl_InstanceIndex.
+   * Needs drawIndirectFirstInstance. Frame thread only.
+   */
+  class GpuScene {
+    struct PushConstants {
+      std::array<glm::vec4, 6> planes;
+      u32 instanceCount;
+    };
+
+    feature::VulkanDevice _device;
+    feature::VulkanCapabilities _capabilities;
+    std::shared_ptr<memory::Allocator> _allocator;
+    std::shared_ptr<DescriptorAllocator> _descriptors;
+
+    u32 _capacity;
+    u32 _meshCapacity;
+    // whether the draw count is read from the GPU
+    bool _indirectCount = false;
+
+    DescriptorSetLayout _cullLayout;
+    DescriptorSetLayout _drawLayout;
+    PipelineLayout _pipelineLayout;
+    AsyncPipeline _pipeline;
+
+    memory::Buffer _instanceBuffer;
+    memory::Buffer _meshBuffer;
+    memory::Buffer _commandBuffer;
+    memory::Buffer _countBuffer;
+    // per frame slot; grown to the changes of a frame
+    std::vector<memory::Buffer> _staging;
+
+    std::vector<DrawInstance> _instances;
+    std::vector<DrawMesh> _meshes;
+    std::vector<u32> _free;
+    std::vector<u32> _dirty;
+    std::vector<bool> _isDirty;
+    // meshes below it are on the GPU
+    u32 _uploadedMeshes = 0;
+    // whether draw() has commands culled this frame
+    bool _culled = false;
+
+    void touch(u32 id);
+    [[nodiscard]] bool upload(VkCommandBuffer cmd, u32 slot) noexcept;
+
+  public:
+    static constexpr u32 NoMesh = UINT32_MAX;
+    static constexpr u32 NoInstance = UINT32_MAX;
+
+    /**
+     * @param capacity Objects at most
+     * @param meshCapacity Meshes at most
+     * @param shader Compiled cull.comp; the one built with leimu if empty
+     */
+    GpuScene(
+        const feature::Vulkan &vulkan,
+        PipelineCompiler &compiler,
+        u32 capacity = 65536,
+        u32 meshCapacity = 4096,
+        std::filesystem::path shader = {}) noexcept;
+
+    [[nodiscard]] bool operator!() const { return !_commandBuffer; }
+
+    /**
+     * Meshes can't be removed; they are cheap, being only ranges.
+     * @return Index to refer to the mesh by, or NoMesh if full
+     */
+    [[nodiscard]] u32 addMesh(const DrawMesh &mesh);
+
+    /**
+     * @return Identifier of the object, or NoInstance if full
+     */
+    [[nodiscard]] u32 add(const DrawInstance &instance);
+    void set(u32 id, const DrawInstance &instance);
+    void remove(u32 id);
+
+    [[nodiscard]] const DrawInstance &get(u32 id) const { return _instances[id]; }
+
+    /**
+     * Uploads this frame's changes and culls against the frustum of viewProjection.
+     * Records outside of any render pass, before draw().
+     */
+    void cull(const feature::VkFrame_T &frame, const glm::mat4 &viewProjection) noexcept;
+
+    /**
+     * Draws the visible objects; binds the instance buffer to set of layout, which has to be compatible
+     * with layout() there. Records inside a render pass, with the pipeline and geometry already bound.
+     */
+    void draw(const feature::VkFrame_T &frame, const PipelineLayout &layout, u32 set) noexcept;
+
+    /**
+     * Descriptor set layout providing the instance buffer to vertex shaders.
+     */
+    [[nodiscard]] const DescriptorSetLayout &layout() const { return _drawLayout; }
+
+    [[nodiscard]] u32 capacity() const { return _capacity; }
+  };
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "leimu/framework.h"
+
+namespace leimu::render {
+
+  struct Ktx2Level {
+    // relative to the start of the file
+    VkDeviceSize offset;
+    VkDeviceSize size;
+  };
+
+  /**
+   * Layout of a KTX2 file without supercompression; level data is referenced, not copied.
+   */
+  struct Ktx2 {
+    VkFormat format;
+    VkExtent3D extent;
+    // base level first
+    std::vector<Ktx2Level> levels;
+  };
+
+  /**
+   * Reads the header and level index of a KTX2 file in memory.
+   * Only single-layer, single-face 2D textures in a BCn format without supercompression are accepted,
+   * and only if every level holds at least as many bytes as its extent takes.
+   */
+  [[nodiscard]] std::optional<Ktx2> ParseKtx2(std::span<const u8> data) noexcept;
+
+  /**
+   * Writes a 2D KTX2 file with a basic data format descriptor.
+   * Supports the block-compressed formats written by leimu-cook: BC1 (RGB), BC3, BC4 and BC5.
+   * @param levels Packed level data, base level first
+   */
+  [[nodiscard]] bool WriteKtx2(
+      const std::filesystem::path &path,
+      VkFormat format,
+      VkExtent2D extent,
+      std::span<const std::vector<u8>> levels) noexcept;
+}
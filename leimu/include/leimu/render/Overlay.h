@@ -0,0 +1,34 @@
+#pragma once
+
+#include "leimu/framework.h"
+#include "leimu/feature/GLFW.h"
+#include "leimu/feature/Vulkan.h"
+#include "leimu/render/DeletionQueue.h"
+#include "leimu/render/Descriptor.h"
+#include "leimu/render/Profiler.h"
+
+namespace leimu::render {
+
+  /**
+   * ImGui overlay showing profiler timings, drawn into the main render pass.
+   * Needs a window; there is no overlay when headless. Frame thread only.
+   */
+  class Overlay {
+    feature::VulkanDevice _device;
+    DescriptorPool _pool;
+    std::shared_ptr<DeletionQueue> _deletion;
+    bool _glfw = false;
+    bool _vulkan = false;
+
+  public:
+    Overlay(const feature::GLFW &glfw, const feature::Vulkan &vulkan) noexcept;
+    ~Overlay();
+
+    /**
+     * Builds and records the overlay; cmd must be inside subpass 0 of vulkan.renderPass() with inline contents.
+     */
+    void draw(VkCommandBuffer cmd, const Profiler &profiler) noexcept;
+
+    bool operator!() const { return !_vulkan; }
+  };
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "leimu/framework.h"
+#include "leimu/feature/Vulkan.h"
+
+namespace leimu::render {
+
+  LEIMU_VK_T(VkPipelineLayout, PipelineLayout);
+  LEIMU_VK_T(VkPipeline, Pipeline);
+
+  struct GraphicsPipelineDesc {
+    std::filesystem::path vertex;
+    std::filesystem::path fragment;
+
+    PipelineLayout layout;
+    feature::VulkanRenderPass renderPass;
+    u32 subpass = 0;
+
+    std::vector<VkVertexInputBindingDescription> bindings;
+    std::vector<VkVertexInputAttributeDescription> attributes;
+
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+  };
+
+  struct ComputePipelineDesc {
+    std::filesystem::path shader;
+
+    PipelineLayout layout;
+  };
+
+  [[nodiscard]] PipelineLayout CreatePipelineLayout(
+      const feature::VulkanDevice &device,
+      const std::vector<VkDescriptorSetLayout> &setLayouts,
+      const std::vector<VkPushConstantRange> &pushConstants) noexcept;
+
+  /**
+   * Compiles a graphics pipeline on the calling thread. Viewport and scissor are dynamic.
+   */
+  [[nodiscard]] Pipeline CreateGraphicsPipeline(
+      const feature::VulkanDevice &device,
+      const feature::VulkanPipelineCache &cache,
+      const GraphicsPipelineDesc &desc) noexcept;
+
+  /**
+   * Compiles a compute pipeline on the calling thread.
+   */
+  [[nodiscard]] Pipeline CreateComputePipeline(
+      const feature::VulkanDevice &device,
+      const feature::VulkanPipelineCache &cache,
+      const ComputePipelineDesc &desc) noexcept;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "leimu/framework.h"
+#include "leimu/job/Scheduler.h"
+#include "leimu/render/Pipeline.h"
+#include "leimu/render/Shader.h"
+
+namespace leimu::render {
+
+  /**
+   * Pipeline being compiled in the background.
+   * Readiness is a single atomic load, so it can be polled per draw.
+   */
+  class AsyncPipeline_T {
+    std::atomic<bool> _ready = false;
+    Pipeline _pipeline;
+    std::promise<Pipeline> _promise;
+    std::shared_future<Pipeline> _future;
+
+  public:
+    AsyncPipeline_T() : _future(_promise.get_future().share()) {}
+
+    void resolve(Pipeline pipeline);
+
+    [[nodiscard]] bool ready() const { return _ready.load(std::memory_order_acquire); }
+
+    /**
+     * @return The compiled pipeline if ready (and compiled successfully), otherwise fallback
+     */
+    [[nodiscard]] const Pipeline &get(const Pipeline &fallback) const {
+      return ready() && _pipeline ? _pipeline : fallback;
+    }
+
+    [[nodiscard]] const std::shared_future<Pipeline> &future() const { return _future; }
+  };
+
+  using AsyncPipeline = std::shared_ptr<AsyncPipeline_T>;
+
+  /**
+   * Builds shaders and pipelines as background jobs, sharing the device's pipeline cache.
+   * Jobs hold their own references to the device and cache, so they may outlive the compiler.
+   */
+  class PipelineCompiler {
+    feature::VulkanDevice _device;
+    feature::VulkanPipelineCache _cache;
+    job::Scheduler &_jobs;
+
+  public:
+    PipelineCompiler(const feature::Vulkan &vulkan, job::Scheduler &jobs);
+
+    [[nodiscard]] AsyncPipeline compile(GraphicsPipelineDesc desc);
+    [[nodiscard]] AsyncPipeline compile(ComputePipelineDesc desc);
+    [[nodiscard]] std::shared_future<Shader> load(std::filesystem::path path);
+  };
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "leimu/framework.h"
+#include "leimu/feature/Vulkan.h"
+#include "leimu/config/ProfilerConfig.h"
+
+namespace leimu::render {
+
+  LEIMU_VK_T(VkQueryPool, QueryPool);
+
+  struct ProfileTiming {
+    std::string name;
+    u32 depth;
+    f64 ms;
+    f64 averageMs;
+  };
+
+  /**
+   * GPU profiler built on timestamp queries, one query pool per frame slot.
+   * Results of a slot are read back once beginFrame has waited on its fence, so reading never stalls;
+   * they lag by framesInFlight frames. Frame thread only.
+   */
+  class Profiler {
+    struct Query {
+      std::string name;
+      u32 depth;
+      u32 begin;
+    };
+
+    struct Slot {
+      QueryPool pool;
+      std::vector<Query> queries;
+      u32 used = 0;
+      bool pending = false;
+    };
+
+    feature::VulkanDevice _device;
+    // nanoseconds per tick
+    f64 _period = 0;
+    u64 _mask = 0;
+    u32 _capacity;
+    f64 _averageWeight;
+
+    std::vector<Slot> _slots;
+    Slot *_current = nullptr;
+    // queries of the scopes still open, innermost last
+    std::vector<u32> _open;
+
+    std::vector<ProfileTiming> _timings;
+    struct Average {
+      f64 ms;
+      // resolved frame the scope was last seen in
+      u64 seen;
+    };
+
+    std::map<std::string, Average, std::less<>> _averages;
+    // frames whose timings were read back
+    u64 _resolved = 0;
+
+    std::chrono::steady_clock::time_point _lastFrame{};
+    f64 _cpuMs = 0;
+    f64 _cpuAverageMs = 0;
+
+    [[nodiscard]] u32 push(VkCommandBuffer cmd, std::string name) noexcept;
+    void pop(VkCommandBuffer cmd) noexcept;
+
+  public:
+    class Scope {
+      Profiler *_profiler;
+      VkCommandBuffer _cmd;
+
+    public:
+      Scope(Profiler *profiler, const VkCommandBuffer cmd) : _profiler(profiler), _cmd(cmd) {}
+      Scope(const Scope &) = delete;
+      Scope &operator=(const Scope &) = delete;
+
+      ~Scope() {
+        if (_profiler) {
+          _profiler->pop(_cmd);
+        }
+      }
+    };
+
+    Profiler(
+        const feature::VulkanPhysicalDevice &phy,
+        feature::VulkanDevice device,
+        u32 family,
+        u32 framesInFlight,
+        const config::ProfilerConfig &config) noexcept;
+
+    /**
+     * Reads back the slot's previous frame and resets its queries. Call right after beginning the frame's command buffer.
+     */
+    void begin(const feature::VkFrame_T &frame) noexcept;
+
+    /**
+     * Call right before ending the frame's command buffer.
+     */
+    void end(const feature::VkFrame_T &frame) noexcept;
+
+    /**
+     * Times the commands recorded into cmd until the scope is destroyed. Scopes nest.
+     */
+    [[nodiscard]] Scope scope(VkCommandBuffer cmd, std::string name) noexcept;
+
+    [[nodiscard]] bool enabled() const { return !_slots.empty(); }
+
+    /**
+     * @return Timings of the latest frame read back, in recording order; the first one is the whole frame
+     */
+    [[nodiscard]] const std::vector<ProfileTiming> &timings() const { return _timings; }
+
+    [[nodiscard]] f64 cpuMs() const { return _cpuMs; }
+    [[nodiscard]] f64 cpuAverageMs() const { return _cpuAverageMs; }
+  };
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "leimu/framework.h"
+#include "leimu/feature/Vulkan.h"
+#include "leimu/job/Scheduler.h"
+
+namespace leimu::render {
+
+  /**
+   * Render pass state that secondary command buffers continue.
+   */
+  struct RecordTarget {
+    VkRenderPass renderPass;
+    u32 subpass;
+    VkFramebuffer framebuffer;
+  };
+
+  using RecordTask = std::function<void(VkCommandBuffer)>;
+
+  /**
+   * Records secondary command buffers as jobs and executes them from the frame's primary buffer.
+   * Every scheduler thread owns one command pool per frame slot, so recording never contends on a pool;
+   * a slot's pools are reset on its first use in a frame, after beginFrame has waited on its fence.
+   * Must be called from a single non-worker thread, which shares pools of index 0.
+   */
+  class Recorder {
+    struct Context {
+      feature::VulkanCommandPool pool;
+      std::vector<VkCommandBuffer> buffers;
+      u32 used = 0;
+    };
+
+    struct Slot {
+      u64 number = UINT64_MAX;
+      // indexed by scheduler thread index
+      std::vector<Context> contexts;
+    };
+
+    feature::VulkanDevice _device;
+    u32 _family;
+    job::Scheduler &_jobs;
+    std::vector<Slot> _slots;
+    std::vector<VkCommandBuffer> _results;
+
+    [[nodiscard]] VkCommandBuffer acquire(Context &context) const noexcept;
+
+  public:
+    Recorder(const feature::Vulkan &vulkan, job::Scheduler &jobs);
+
+    /**
+     * Records every task into its own secondary command buffer, then executes them in task order.
+     * The render pass of target must already be begun on frame with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+     * Blocks until all tasks are recorded; the calling thread records too.
+     */
+    void record(const feature::VkFrame_T &frame, const RecordTarget &target, std::span<const RecordTask> tasks) noexcept;
+  };
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include "leimu/framework.h"
+#include "leimu/feature/Vulkan.h"
+#include "leimu/memory/Allocator.h"
+#include "leimu/render/DeletionQueue.h"
+
+namespace leimu::render {
+
+  /**
+   * How a pass touches a resource; determines stages, access masks, image layout and required usage.
+   */
+  enum class Access : u8 {
+    // read-write, e.g. blending
+    ColorAttachment,
+    DepthAttachment,
+    DepthRead,
+    FragmentRead,
+    ComputeRead,
+    ComputeWrite,
+    TransferRead,
+    TransferWrite,
+    VertexInput,
+    Uniform,
+    Indirect,
+  };
+
+  struct ImageDesc {
+    VkFormat format;
+    VkExtent2D extent;
+    u32 mipLevels = 1;
+    u32 arrayLayers = 1;
+    // added to the usage implied by accesses
+    VkImageUsageFlags usage = 0;
+  };
+
+  struct BufferDesc {
+    VkDeviceSize size;
+    // added to the usage implied by accesses
+    VkBufferUsageFlags usage = 0;
+  };
+
+  struct ImageHandle {
+    u32 index;
+  };
+
+  struct BufferHandle {
+    u32 index;
+  };
+
+  class RenderGraph;
+
+  class PassBuilder {
+    RenderGraph &_graph;
+    u32 _pass;
+
+  public:
+    PassBuilder(RenderGraph &graph, const u32 pass) : _graph(graph), _pass(pass) {}
+
+    /**
+     * Declares an access of the pass; each resource may be declared once per pass.
+     */
+    ImageHandle use(ImageHandle image, Access access);
+    BufferHandle use(BufferHandle buffer, Access access);
+
+    /**
+     * Keeps the pass even if nothing reads what it writes.
+     */
+    void sideEffect();
+  };
+
+  /**
+   * Frame graph on top of feature::Vulkan.
+   * Passes are declared in submission order with the resources they access, then compiled once:
+   * passes contributing to no imported resource are culled, pipeline barriers and layout transitions
+   * are computed and batched per pass, and transient resources whose lifetimes do not overlap share memory.
+   * Imported resources (e.g. the swapchain image) may be rebound every frame without recompiling.
+   *
+   * Render passes begun inside a pass must keep their attachments in the layouts implied by the declared accesses.
+   */
+  class RenderGraph {
+    friend class PassBuilder;
+
+    using Execute = std::function<void(VkCommandBuffer, const RenderGraph &)>;
+
+    struct Use {
+      u32 resource;
+      Access access;
+    };
+
+    struct Pass {
+      std::string name;
+      Execute execute;
+      std::vector<Use> uses;
+      bool sideEffect = false;
+
+      u32 references = 0;
+      bool culled = false;
+    };
+
+    struct Resource {
+      std::string name;
+      bool image;
+      bool imported;
+
+      ImageDesc imageDesc{};
+      BufferDesc bufferDesc{};
+
+      // imported only
+      VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      VkPipelineStageFlags producerStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+      VkImage imageHandle = VK_NULL_HANDLE;
+      VkImageView view = VK_NULL_HANDLE;
+      VkBuffer bufferHandle = VK_NULL_HANDLE;
+
+      // transient only
+      memory::Image ownedImage;
+      memory::Buffer ownedBuffer;
+      feature::VulkanImageView ownedView;
+
+      std::vector<u32> writers;
+      u32 references = 0;
+      u32 first = UINT32_MAX;
+      u32 last = 0;
+      u32 bucket = UINT32_MAX;
+    };
+
+    struct Bucket {
+      memory::ResourceKind kind;
+      VkMemoryRequirements requirements;
+      // ordered by first use
+      std::vector<u32> members;
+      memory::Allocation allocation;
+    };
+
+    struct Transition {
+      u32 resource;
+      VkAccessFlags srcAccess;
+      VkAccessFlags dstAccess;
+      VkImageLayout oldLayout;
+      VkImageLayout newLayout;
+    };
+
+    struct Barrier {
+      VkPipelineStageFlags srcStages = 0;
+      VkPipelineStageFlags dstStages = 0;
+      VkAccessFlags srcAccess = 0;
+      VkAccessFlags dstAccess = 0;
+      std::vector<Transition> transitions;
+    };
+
+    struct State {
+      VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+      // stages and accesses of the last write (or layout transition) still to be waited on
+      VkPipelineStageFlags writeStages = 0;
+      VkAccessFlags writeAccess = 0;
+      // stages that read since the last write
+      VkPipelineStageFlags readStages = 0;
+      // stages and accesses the last write has been made visible to
+      VkPipelineStageFlags visibleStages = 0;
+      VkAccessFlags visibleAccess = 0;
+    };
+
+    feature::VulkanDevice _device;
+    std::shared_ptr<memory::Allocator> _allocator;
+    std::shared_ptr<DeletionQueue> _deletion;
+
+    std::vector<Pass> _passes;
+    std::vector<Resource> _resources;
+    std::vector<Bucket> _buckets;
+
+    // [pass] barriers recorded before it; one extra at the end for final transitions
+    std::vector<Barrier> _barriers;
+    bool _compiled = false;
+
+    void cull();
+    void computeLifetimes();
+    [[nodiscard]] bool allocate() noexcept;
+    // hands transient resources over to the deletion queue; frames in flight may still use them
+    void retire();
+    [[nodiscard]] std::vector<State> simulate(const std::vector<State> &initial, bool emit);
+    void emit(VkCommandBuffer cmd, const Barrier &barrier) const;
+
+  public:
+    RenderGraph(const feature::Vulkan &vulkan);
+    ~RenderGraph();
+
+    [[nodiscard]] ImageHandle createImage(std::string name, const ImageDesc &desc);
+    [[nodiscard]] BufferHandle createBuffer(std::string name, const BufferDesc &desc);
+
+    /**
+     * @param initialLayout Layout the image is in when the graph starts executing
+     * @param finalLayout Layout the image is left in; VK_IMAGE_LAYOUT_UNDEFINED keeps the layout of its last use
+     * @param producerStage Stage the image's previous producer is waited on at, e.g. through a semaphore
+     */
+    [[nodiscard]] ImageHandle importImage(
+        std::string name,
+        const ImageDesc &desc,
+        VkImageLayout initialLayout,
+        VkImageLayout finalLayout,
+        VkPipelineStageFlags producerStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    [[nodiscard]] BufferHandle importBuffer(std::string name, VkDeviceSize size);
+
+    /**
+     * Rebinds an imported resource, e.g. to the swapchain image acquired this frame.
+     */
+    void bind(ImageHandle image, VkImage handle, VkImageView view);
+    void bind(BufferHandle buffer, VkBuffer handle);
+
+    void addPass(std::string name, const std::function<void(PassBuilder &)> &setup, Execute execute);
+
+    /**
+     * Culls passes, computes barriers and (re)creates transient resources.
+     * Transient resources from an earlier compilation are retired to the deletion queue, so frames still in flight
+     * keep them until they complete; compiling never waits for the device.
+     */
+    bool compile() noexcept;
+
+    /**
+     * Records every surviving pass in declaration order, with its barriers, into cmd.
+     */
+    void execute(VkCommandBuffer cmd) const;
+
+    [[nodiscard]] VkImage image(const ImageHandle handle) const { return _resources[handle.index].imageHandle; }
+    [[nodiscard]] VkImageView view(const ImageHandle handle) const { return _resources[handle.index].view; }
+    [[nodiscard]] VkBuffer buffer(const BufferHandle handle) const { return _resources[handle.index].bufferHandle; }
+  };
+}
@@ -7,6 +7,11 @@ namespace leimu::render {
 
   using Shader = std::shared_ptr<VkShaderModule_T>;
 
+  /**
+   * Creates a shader module, or returns the live one created from identical SPIR-V on the same device.
+   * Modules are keyed by a hash of their code and only weakly referenced, so unused ones are still freed.
+   * Thread-safe.
+   */
   Shader CreateShader(
       feature::VulkanDevice device,
       size_t size,
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "leimu/framework.h"
+#include "leimu/feature/Vulkan.h"
+#include "leimu/job/Scheduler.h"
+#include "leimu/memory/Allocator.h"
+#include "leimu/memory/Uploader.h"
+#include "leimu/render/DeletionQueue.h"
+
+namespace leimu::render {
+
+  enum class TextureState : u8 {
+    Pending,
+    Ready,
+    Failed,
+  };
+
+  class Texture_T;
+  using Texture = std::shared_ptr<Texture_T>;
+
+  /**
+   * Sampled 2D image being streamed in.
+   * Until it is resident every accessor forwards to the placeholder, so it can be bound from the start;
+   * residency is a single atomic load, so it can be polled per draw.
+   * Dropping the last reference retires the image to the deletion queue, since frames in flight may still sample it.
+   */
+  class Texture_T {
+    friend class TextureStreamer;
+
+    std::atomic<TextureState> _state = TextureState::Pending;
+    Texture _placeholder;
+    std::shared_ptr<DeletionQueue> _deletion;
+
+    memory::Image _image;
+    feature::VulkanImageView _view;
+
+    void resolve(TextureState state) { _state.store(state, std::memory_order_release); }
+
+  public:
+    Texture_T(Texture placeholder, std::shared_ptr<DeletionQueue> deletion)
+      : _placeholder(std::move(placeholder)), _deletion(std::move(deletion)) {}
+    ~Texture_T();
+
+    Texture_T(const Texture_T &) = delete;
+    Texture_T &operator=(const Texture_T &) = delete;
+
+    [[nodiscard]] TextureState state() const { return _state.load(std::memory_order_acquire); }
+    [[nodiscard]] bool ready() const { return state() == TextureState::Ready; }
+
+    /**
+     * @return The texture's image if resident, otherwise the placeholder's.
+     *         Stays in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL either way.
+     */
+    [[nodiscard]] VkImage image() const;
+    [[nodiscard]] VkImageView view() const;
+    [[nodiscard]] VkExtent3D extent() const;
+    [[nodiscard]] u32 mipLevels() const;
+  };
+
+  /**
+   * Loads textures without stalling the frame thread.
+   * Files are memory-mapped and decoded by stb_image as background jobs, uploaded through memory::Uploader,
+   * then mip chains are blitted on the graphics queue at the start of the frame acquiring the upload;
+   * textures are resident from that point of the frame on.
+   * KTX2 files (e.g. from leimu-cook) are copied level by level straight from the mapping instead.
+   * Jobs hold their own references to what they use, so they may outlive the streamer.
+   */
+  class TextureStreamer {
+    // bytes staged by streaming jobs but not acquired by a frame yet
+    struct Budget {
+      std::atomic<VkDeviceSize> pending = 0;
+      VkDeviceSize limit = 0;
+
+      // Blocks while other textures hold the budget
+      void acquire(VkDeviceSize size);
+      void release(VkDeviceSize size);
+    };
+
+    feature::VulkanPhysicalDevice _physicalDevice;
+    feature::VulkanDevice _device;
+    std::shared_ptr<memory::Allocator> _allocator;
+    std::shared_ptr<memory::Uploader> _uploader;
+    std::shared_ptr<DeletionQueue> _deletion;
+    job::Scheduler &_jobs;
+    std::shared_ptr<Budget> _budget;
+
+    // whether RGBA8 supports linear blits; if not, textures get a single level
+    bool _mipmaps = false;
+    Texture _placeholder;
+
+    std::mutex _lock;
+    std::map<std::pair<std::filesystem::path, bool>, std::weak_ptr<Texture_T>> _cache;
+    // cache size at which expired entries are swept next
+    size_t _sweepAt = 64;
+
+  public:
+    TextureStreamer(const feature::Vulkan &vulkan, job::Scheduler &jobs) noexcept;
+
+    /**
+     * Returns immediately; a texture already streaming or resident is shared.
+     * @param srgb Whether texels are sRGB-encoded, e.g. colour maps, rather than linear data;
+     *             ignored for KTX2 files, whose format says so
+     */
+    [[nodiscard]] Texture load(const std::filesystem::path &path, bool srgb = true);
+
+    /**
+     * Checkerboard shown by textures which aren't resident yet or failed to load.
+     */
+    [[nodiscard]] const Texture &placeholder() const { return _placeholder; }
+  };
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "leimu/framework.h"
+#include "leimu/feature/Vulkan.h"
+
+namespace leimu::render {
+
+  enum class QueueKind : u8 {
+    Graphics,
+    Present,
+    Transfer,
+    Compute,
+  };
+
+  class Timeline_T;
+  using Timeline = std::shared_ptr<Timeline_T>;
+
+  /**
+   * Submission waiting on and signaling any mix of binary and timeline semaphores.
+   */
+  struct TimelineSubmit {
+    std::vector<VkCommandBuffer> commandBuffers;
+
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<VkPipelineStageFlags> waitStages;
+    // ignored for binary semaphores
+    std::vector<u64> waitValues;
+
+    std::vector<VkSemaphore> signalSemaphores;
+    std::vector<u64> signalValues;
+
+    /**
+     * Waits until timeline has reached value, e.g. for work submitted to another queue.
+     */
+    void wait(const Timeline_T &timeline, u64 value, VkPipelineStageFlags stage);
+    void wait(VkSemaphore binary, VkPipelineStageFlags stage);
+    void signal(VkSemaphore binary);
+  };
+
+  /**
+   * Monotonically increasing counter of the work completed on a queue.
+   * Every submission through it signals the next value, so one 64-bit value stands in for a fence per submission:
+   * whether some work is done is a comparison, mostly against a cached counter. Thread-safe.
+   * Its lock is the queue's: where timelines exist, everything submitted or presented to the queue goes through it.
+   */
+  class Timeline_T {
+    feature::VulkanDevice _device;
+    feature::VulkanQueue _queue;
+    feature::VulkanSemaphore _semaphore;
+
+    // serializes access to the queue, so that values are signaled in order
+    std::mutex _lock;
+    std::atomic<u64> _submitted = 0;
+    mutable std::atomic<u64> _completed = 0;
+
+  public:
+    Timeline_T(feature::VulkanDevice device, feature::VulkanQueue queue, feature::VulkanSemaphore semaphore)
+      : _device(std::move(device)), _queue(std::move(queue)), _semaphore(std::move(semaphore)) {}
+
+    /**
+     * Submits to the queue; the submission additionally signals the next value.
+     * @param fence Signaled along, for code still waiting on fences
+     * @return The value reached once the submission completes, or 0 if it failed
+     */
+    [[nodiscard]] u64 submit(TimelineSubmit submit, VkFence fence = VK_NULL_HANDLE) noexcept;
+
+    /**
+     * Presents on the queue; advances no value, since presentation can't signal timeline semaphores.
+     */
+    [[nodiscard]] VkResult present(const VkPresentInfoKHR &presentInfo) noexcept;
+
+    /**
+     * @return Whether the work which signals value has completed; 0 always has
+     */
+    [[nodiscard]] bool completed(u64 value) const noexcept;
+
+    /**
+     * Blocks until the work which signals value has completed.
+     * @return false on timeout or device loss
+     */
+    bool wait(u64 value, u64 timeout = UINT64_MAX) const noexcept;
+
+    /**
+     * @return The value most recently reached, straight from the device
+     */
+    [[nodiscard]] u64 value() const noexcept;
+
+    /**
+     * @return The value signaled by the latest submission
+     */
+    [[nodiscard]] u64 submitted() const { return _submitted.load(std::memory_order_acquire); }
+
+    [[nodiscard]] VkSemaphore semaphore() const { return _semaphore.get(); }
+    [[nodiscard]] VkQueue queue() const { return _queue.get(); }
+  };
+
+  /**
+   * One timeline per queue. Roles sharing a queue, e.g. graphics and present, share its timeline.
+   * Presentation can't signal timeline semaphores, so the present timeline only
+   * advances by work submitted to the present queue.
+   */
+  class Timelines {
+    std::array<Timeline, 4> _timelines;
+
+  public:
+    Timelines(
+        const feature::VulkanDevice &device,
+        std::span<const feature::VulkanQueue, 4> queues) noexcept;
+
+    [[nodiscard]] bool operator!() const { return !_timelines[0]; }
+
+    [[nodiscard]] const Timeline &get(QueueKind kind) const { return _timelines[static_cast<u8>(kind)]; }
+  };
+
+  /**
+   * @return A timeline semaphore starting at value, or nullptr if the device has no timeline semaphores
+   */
+  [[nodiscard]] feature::VulkanSemaphore CreateTimelineSemaphore(
+      const feature::VulkanDevice &device,
+      u64 value = 0) noexcept;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "leimu/framework.h"
+
+namespace leimu::trace {
+  /**
+   * @return Nanoseconds since the process started
+   */
+  [[nodiscard]] u64 Now() noexcept;
+
+  /**
+   * Appends a completed zone to the calling thread's buffer. name must outlive the trace, e.g. a literal.
+   * Zones are dropped while the buffer is full; Collect() drains it.
+   */
+  void Record(const char *name, u64 begin, u64 end) noexcept;
+
+  void SetThreadName(std::string name);
+
+  /**
+   * Moves zones out of every thread's buffer; call regularly (e.g. once a frame) so that buffers don't fill up.
+   */
+  void Collect() noexcept;
+
+  /**
+   * Writes everything collected so far as Chrome trace event JSON (chrome://tracing, ui.perfetto.dev).
+   */
+  bool Dump(const std::filesystem::path &path) noexcept;
+
+  class Zone {
+    const char *_name;
+    u64 _begin;
+
+  public:
+    explicit Zone(const char *name) noexcept : _name(name), _begin(Now()) {}
+    Zone(const Zone &) = delete;
+    Zone &operator=(const Zone &) = delete;
+    ~Zone() { Record(_name, _begin, Now()); }
+  };
+
+  /**
+   * Back-to-back zones; each next() ends the current one, e.g. to time the steps of a long function.
+   */
+  class Steps {
+    const char *_name = nullptr;
+    u64 _begin = 0;
+
+  public:
+    Steps() = default;
+    Steps(const Steps &) = delete;
+    Steps &operator=(const Steps &) = delete;
+    ~Steps() { end(); }
+
+    void next(const char *name) noexcept {
+      end();
+      _name = name;
+      _begin = Now();
+    }
+
+    void end() noexcept {
+      if (_name) {
+        Record(_name, _begin, Now());
+        _name = nullptr;
+      }
+    }
+  };
+}
+
+#define LEIMU_TRACE_CONCAT_(a, b) a##b
+#define LEIMU_TRACE_CONCAT(a, b) LEIMU_TRACE_CONCAT_(a, b)
+
+#if LEIMU_TRACE
+#define LEIMU_ZONE(name) const ::leimu::trace::Zone LEIMU_TRACE_CONCAT(_leimuZone, __LINE__)(name)
+#define LEIMU_STEPS(var) ::leimu::trace::Steps var
+#define LEIMU_STEP(var, name) (var).next(name)
+#define LEIMU_TRACE_THREAD(name) ::leimu::trace::SetThreadName(name)
+#define LEIMU_TRACE_COLLECT() ::leimu::trace::Collect()
+#else
+#define LEIMU_ZONE(name) ((void) 0)
+#define LEIMU_STEPS(var) ((void) 0)
+#define LEIMU_STEP(var, name) ((void) 0)
+#define LEIMU_TRACE_THREAD(name) ((void) 0)
+#define LEIMU_TRACE_COLLECT() ((void) 0)
+#endif
@@ -3,6 +3,7 @@
 #include "leimu/framework.h"
 
 #include "leimu/App.h"
+#include "leimu/trace.h"
 
 leimu::ContextLifetimeNote::ContextLifetimeNote(const std::string &init, std::string fini)
   : _finiNote(std::move(fini)) {
@@ -19,7 +20,14 @@ leimu::App::App(std::string name, Config config)
 
     _name(std::move(name)),
     _config(std::move(config)),
+    _glfw(*this),
     _vulkan(*this),
+    _jobs(*this),
+    _compiler(_vulkan, _jobs),
+    _recorder(_vulkan, _jobs),
+    _overlay(_glfw, _vulkan),
+    _textures(_vulkan, _jobs),
+    _reader(_jobs, _config->jobs().ioDepth),
 
     _endNote("application initialized", "application closing...") {
   if (!_glfw || !_vulkan) {
@@ -27,12 +35,84 @@ leimu::App::App(std::string name, Config config)
   }
 }
 
-leimu::App::~App() = default;
+leimu::App::~App() {
+  // Members are destroyed before _vulkan, while the last frames may still use
+  // the recorder's command pools and the compiled pipelines
+  _vulkan.waitIdle();
+
+#if LEIMU_TRACE
+  if (const auto &path = _config->profiler().tracePath; !path.empty()) {
+    (void) trace::Dump(path);
+  }
+#endif
+}
+
+bool leimu::App::shouldClose() const {
+  if (const auto limit = _config->vulkan().frameLimit; limit && _frameCount >= limit) {
+    return true;
+  }
+
+  return !_glfw.headless() && glfwWindowShouldClose(_glfw.window());
+}
 
 void leimu::App::run() {
-  while (!glfwWindowShouldClose(_glfw.window())) {
-    glfwPollEvents();
+  LEIMU_TRACE_THREAD("frame");
+
+  while (!shouldClose()) {
+    LEIMU_ZONE("frame");
+    LEIMU_TRACE_COLLECT();
+
+    if (!_glfw.headless()) {
+      LEIMU_ZONE("frame: poll events");
+      glfwPollEvents();
+    }
+
+    // Nothing can be presented to a zero-sized surface; sleep instead of spinning
+    if (_glfw.minimized()) {
+      glfwWaitEvents();
+      continue;
+    }
+
+    // Blocks only until the oldest frame in flight is retired, so recording overlaps GPU work
+    const auto frame = _vulkan.beginFrame();
+    if (!frame) {
+      continue;
+    }
+
+    {
+      LEIMU_ZONE("frame: record");
+      record(*frame);
+    }
+
+    _vulkan.endFrame(*frame);
+    ++_frameCount;
+  }
+}
+
+void leimu::App::record(const feature::VkFrame_T &frame) {
+  constexpr VkClearValue clear{
+      .color = {{0.0f, 0.0f, 0.0f, 1.0f}}
+  };
+
+  const VkRenderPassBeginInfo beginInfo{
+      .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+      .renderPass = _vulkan.renderPass().get(),
+      .framebuffer = _vulkan.framebuffers()[frame.imageIndex].get(),
+      .renderArea = {
+          .offset = {0, 0},
+          .extent = _vulkan.extent(),
+      },
+      .clearValueCount = 1,
+      .pClearValues = &clear,
+  };
+
+  const auto scope = _vulkan.profiler()->scope(frame.commandBuffer, "main pass");
+
+  vkCmdBeginRenderPass(frame.commandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+  if (_config->profiler().overlay) {
+    _overlay.draw(frame.commandBuffer, *_vulkan.profiler());
   }
+  vkCmdEndRenderPass(frame.commandBuffer);
 }
 
 bool leimu::App::operator!() const { return !_glfw || !_vulkan; }
@@ -0,0 +1,226 @@
+#include "leimu/asset/Archive.h"
+#include "leimu/hash.h"
+#include "leimu/logging.h"
+#include "leimu/trace.h"
+
+namespace {
+  // Touching one byte every 4 KiB faults in every page on any page size
+  constexpr size_t TouchStride = 4096;
+
+  u64 Align(const u64 value, const u64 alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+  }
+
+  bool Less(const leimu::asset::ArchiveEntry &entry, const u64 hash, const std::string_view name, const char *names) {
+    if (entry.hash != hash) {
+      return entry.hash < hash;
+    }
+    return std::string_view(names + entry.nameOffset, entry.nameLength) < name;
+  }
+}
+
+std::string_view leimu::asset::Archive_T::name(const size_t index) const {
+  const auto &entry = _entries[index];
+  return _names.substr(entry.nameOffset, entry.nameLength);
+}
+
+std::span<const u8> leimu::asset::Archive_T::data(const size_t index) const {
+  const auto &entry = _entries[index];
+  return {static_cast<const u8 *>(_mapping->ptr()) + entry.offset, entry.size};
+}
+
+std::optional<std::span<const u8>> leimu::asset::Archive_T::find(const std::string_view name) const {
+  const auto hash = Hash(name.data(), name.size());
+  const auto it = std::lower_bound(
+      _entries.begin(), _entries.end(), name,
+      [this, hash](const ArchiveEntry &entry, const std::string_view key) {
+        return Less(entry, hash, key, _names.data());
+      });
+
+  if (it == _entries.end() || it->hash != hash || _names.substr(it->nameOffset, it->nameLength) != name) {
+    return std::nullopt;
+  }
+  return data(it - _entries.begin());
+}
+
+void leimu::asset::Archive_T::advise(const std::span<const u8> blob, const native::Advice advice) const {
+  const auto offset = blob.data() - static_cast<const u8 *>(_mapping->ptr());
+  _mapping->advise(static_cast<size_t>(offset), blob.size(), advice);
+}
+
+void leimu::asset::Archive_T::prefetch(
+    job::Scheduler &jobs,
+    const std::span<const u8> blob,
+    const job::Counter &signal) const {
+
+  advise(blob, native::Advice::WillNeed);
+
+  // The job holds the mapping, so the blob outlives it even if the archive doesn't
+  jobs.background(
+      [mapping = _mapping, blob] {
+        LEIMU_ZONE("archive: prefetch");
+
+        u8 sink = 0;
+        for (size_t i = 0; i < blob.size(); i += TouchStride) {
+          sink ^= *static_cast<const volatile u8 *>(&blob[i]);
+        }
+        if (!blob.empty()) {
+          sink ^= *static_cast<const volatile u8 *>(&blob.back());
+        }
+        (void) sink;
+      },
+      signal);
+}
+
+leimu::asset::Archive leimu::asset::OpenArchive(const std::filesystem::path &path, const native::Advice advice) noexcept {
+  LEIMU_ZONE("archive: open");
+
+  auto mapping = native::CreateFileMapping(path, advice);
+  if (!mapping) {
+    return nullptr;
+  }
+
+  const auto base = static_cast<const u8 *>(mapping->ptr());
+  const auto size = mapping->size();
+
+  ArchiveHeader header;
+  if (size < sizeof(header)) {
+    std::println(errs(), "[archive] '{}' is too small to be an archive", path.string());
+    return nullptr;
+  }
+  memcpy(&header, base, sizeof(header));
+
+  if (header.magic != ArchiveMagic || header.version != ArchiveVersion) {
+    std::println(errs(), "[archive] '{}' isn't an archive of version {}", path.string(), ArchiveVersion);
+    return nullptr;
+  }
+
+  // The mapping is page-aligned, so an aligned offset is an aligned address
+  const auto tocSize = static_cast<u64>(header.count) * sizeof(ArchiveEntry);
+  if (header.tocOffset % alignof(ArchiveEntry) ||
+      header.tocOffset > size || tocSize > size - header.tocOffset ||
+      header.namesOffset > size || header.namesSize > size - header.namesOffset) {
+    std::println(errs(), "[archive] Table of contents of '{}' lies outside of the file", path.string());
+    return nullptr;
+  }
+
+  const std::span entries(reinterpret_cast<const ArchiveEntry *>(base + header.tocOffset), header.count);
+  const std::string_view names(reinterpret_cast<const char *>(base + header.namesOffset), header.namesSize);
+
+  for (const auto &entry: entries) {
+    if (entry.offset > size || entry.size > size - entry.offset ||
+        entry.nameOffset > names.size() || entry.nameLength > names.size() - entry.nameOffset) {
+      std::println(errs(), "[archive] Entry of '{}' lies outside of the file", path.string());
+      return nullptr;
+    }
+  }
+
+  // The table is only ever searched, so it won't be touched again until a lookup; keep it resident
+  mapping->advise(header.tocOffset, tocSize, native::Advice::WillNeed);
+  mapping->advise(header.namesOffset, header.namesSize, native::Advice::WillNeed);
+
+  return std::make_shared<Archive_T>(std::move(mapping), entries, names);
+}
+
+bool leimu::asset::WriteArchive(
+    const std::filesystem::path &path,
+    const std::span<const std::pair<std::string, std::filesystem::path>> files,
+    const u64 alignment) noexcept {
+
+  if (alignment < alignof(ArchiveEntry) || !std::has_single_bit(alignment)) {
+    std::println(errs(), "[archive] Alignment {} isn't a power of two of at least 8", alignment);
+    return false;
+  }
+
+  std::ofstream out(path, std::ios::binary);
+  if (!out) {
+    std::println(errs(), "[archive] Couldn't create '{}'", path.string());
+    return false;
+  }
+
+  const auto pad = [&out](const u64 offset) {
+    static constexpr std::array<char, 64> zeros{};
+    for (auto at = static_cast<u64>(out.tellp()); at < offset;) {
+      const auto n = std::min<u64>(offset - at, zeros.size());
+      out.write(zeros.data(), static_cast<std::streamsize>(n));
+      at += n;
+    }
+  };
+
+  std::vector<ArchiveEntry> entries;
+  std::string names;
+  entries.reserve(files.size());
+
+  ArchiveHeader header{
+      .magic = ArchiveMagic,
+      .version = ArchiveVersion,
+      .count = static_cast<u32>(files.size()),
+      .alignment = alignment,
+  };
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  u64 offset = sizeof(header);
+  for (const auto &[name, file]: files) {
+    std::error_code error;
+    const auto size = std::filesystem::file_size(file, error);
+    if (error) {
+      std::println(errs(), "[archive] Couldn't stat '{}': {}", file.string(), error.message());
+      return false;
+    }
+
+    offset = Align(offset, alignment);
+    pad(offset);
+
+    // Empty files can't be mapped, and have nothing to write anyway
+    if (size) {
+      const auto mapping = native::CreateFileMapping(file, native::Advice::Sequential);
+      if (!mapping) {
+        return false;
+      }
+      out.write(static_cast<const char *>(mapping->ptr()), static_cast<std::streamsize>(mapping->size()));
+    }
+
+    entries.push_back(
+        {
+            .hash = Hash(name.data(), name.size()),
+            .offset = offset,
+            .size = size,
+            .nameOffset = static_cast<u32>(names.size()),
+            .nameLength = static_cast<u32>(name.size()),
+        });
+    names += name;
+    offset += size;
+  }
+
+  const auto namesData = names.data();
+  std::ranges::sort(entries, [namesData](const ArchiveEntry &a, const ArchiveEntry &b) {
+    return Less(a, b.hash, {namesData + b.nameOffset, b.nameLength}, namesData);
+  });
+
+  for (size_t i = 1; i < entries.size(); ++i) {
+    const auto &a = entries[i - 1];
+    const auto &b = entries[i];
+    if (a.hash == b.hash && names.compare(a.nameOffset, a.nameLength, names, b.nameOffset, b.nameLength) == 0) {
+      std::println(errs(), "[archive] '{}' is packed twice", names.substr(a.nameOffset, a.nameLength));
+      return false;
+    }
+  }
+
+  header.tocOffset = Align(offset, alignof(ArchiveEntry));
+  pad(header.tocOffset);
+  out.write(reinterpret_cast<const char *>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(ArchiveEntry)));
+
+  header.namesOffset = header.tocOffset + entries.size() * sizeof(ArchiveEntry);
+  header.namesSize = names.size();
+  out.write(names.data(), static_cast<std::streamsize>(names.size()));
+
+  out.seekp(0);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  if (!out.flush()) {
+    std::println(errs(), "[archive] Couldn't write '{}'", path.string());
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1 @@
+#include "leimu/config/ProfilerConfig.h"
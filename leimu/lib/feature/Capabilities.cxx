@@ -0,0 +1,213 @@
+#include "leimu/feature/Capabilities.h"
+
+namespace {
+  // Highest version leimu makes use of
+  constexpr u32 TargetApiVersion = VK_API_VERSION_1_3;
+
+  std::set<std::string, std::less<>> GetAvailableExtensions(const VkPhysicalDevice device) {
+    u32 nExtension = 0;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &nExtension, nullptr);
+
+    std::vector<VkExtensionProperties> extensions(nExtension);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &nExtension, extensions.data());
+
+    std::set<std::string, std::less<>> names;
+    for (const auto &[name, _]: extensions) {
+      names.emplace(name);
+    }
+    return names;
+  }
+
+  bool IsSupported(
+      const leimu::feature::VkCapability &capability,
+      const u32 version,
+      const std::set<std::string, std::less<>> &extensions,
+      leimu::feature::VkFeatureChain &supported) {
+    return capability.version <= version &&
+           std::ranges::all_of(capability.extensions, [&extensions](const char *name) {
+             return extensions.contains(std::string_view(name));
+           }) &&
+           std::ranges::all_of(capability.features, [&supported](const leimu::feature::VkFeatureBit bit) {
+             return bit(supported) == VK_TRUE;
+           });
+  }
+}
+
+leimu::feature::VkFeatureChain::VkFeatureChain(const u32 version) {
+  // The 1.1 and 1.2 structures both came with Vulkan 1.2
+  if (version >= VK_API_VERSION_1_2) {
+    core.pNext = &v11;
+    v11.pNext = &v12;
+  }
+  if (version >= VK_API_VERSION_1_3) {
+    v12.pNext = &v13;
+  }
+}
+
+std::string_view leimu::feature::GetTierName(const VkCapabilityTier tier) {
+  switch (tier) {
+    case VkCapabilityTier::Modern:
+      return "modern";
+    case VkCapabilityTier::GpuDriven:
+      return "gpu-driven";
+    default:
+      return "baseline";
+  }
+}
+
+std::vector<leimu::feature::VkCapability> leimu::feature::GetCapabilityRequests(
+    const bool headless,
+    const std::span<const VkCapability> extra) {
+  std::vector<VkCapability> requests;
+
+  if (!headless) {
+    requests.push_back(
+        {
+            .name = std::string(capability::Swapchain),
+            .required = true,
+            .extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME},
+        });
+  }
+
+  // render::TextureStreamer; cooked textures
+  requests.push_back(
+      {
+          .name = std::string(capability::BlockCompression),
+          .features = {LEIMU_FEATURE(core.features, textureCompressionBC)},
+      });
+
+  // render::GpuScene
+  requests.push_back(
+      {
+          .name = std::string(capability::IndirectFirstInstance),
+          .features = {LEIMU_FEATURE(core.features, drawIndirectFirstInstance)},
+      });
+  requests.push_back(
+      {
+          .name = std::string(capability::MultiDrawIndirect),
+          .features = {LEIMU_FEATURE(core.features, multiDrawIndirect)},
+      });
+  requests.push_back(
+      {
+          .name = std::string(capability::IndirectCount),
+          .version = VK_API_VERSION_1_2,
+          .features = {LEIMU_FEATURE(v12, drawIndirectCount)},
+      });
+  requests.push_back(
+      {
+          .name = std::string(capability::IndirectCountKHR),
+          .extensions = {VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME},
+      });
+
+  // render::Bindless; bindless.glsl indexes non-uniformly, so that comes along
+  requests.push_back(
+      {
+          .name = std::string(capability::Bindless),
+          .version = VK_API_VERSION_1_2,
+          .features = {
+              LEIMU_FEATURE(v12, runtimeDescriptorArray),
+              LEIMU_FEATURE(v12, descriptorBindingPartiallyBound),
+              LEIMU_FEATURE(v12, descriptorBindingUpdateUnusedWhilePending),
+              LEIMU_FEATURE(v12, descriptorBindingSampledImageUpdateAfterBind),
+              LEIMU_FEATURE(v12, descriptorBindingStorageBufferUpdateAfterBind),
+              LEIMU_FEATURE(v12, shaderSampledImageArrayNonUniformIndexing),
+              LEIMU_FEATURE(v12, shaderStorageBufferArrayNonUniformIndexing),
+          },
+      });
+
+  // Synchronization and render passes
+  requests.push_back(
+      {
+          .name = std::string(capability::TimelineSemaphore),
+          .version = VK_API_VERSION_1_2,
+          .features = {LEIMU_FEATURE(v12, timelineSemaphore)},
+      });
+  requests.push_back(
+      {
+          .name = std::string(capability::Synchronization2),
+          .version = VK_API_VERSION_1_3,
+          .features = {LEIMU_FEATURE(v13, synchronization2)},
+      });
+  requests.push_back(
+      {
+          .name = std::string(capability::DynamicRendering),
+          .version = VK_API_VERSION_1_3,
+          .features = {LEIMU_FEATURE(v13, dynamicRendering)},
+      });
+
+  requests.insert(requests.end(), extra.begin(), extra.end());
+  return requests;
+}
+
+u32 leimu::feature::GetInstanceVersion() noexcept {
+  // Only 1.1+ loaders have the entry point
+  const auto enumerate = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+      vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+
+  u32 version = VK_API_VERSION_1_0;
+  if (enumerate && enumerate(&version) != VK_SUCCESS) {
+    version = VK_API_VERSION_1_0;
+  }
+  return std::min(version, TargetApiVersion);
+}
+
+leimu::feature::VkNegotiation leimu::feature::Negotiate(
+    const VkPhysicalDevice device,
+    const std::span<const VkCapability> requests) noexcept {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(device, &properties);
+
+  // The instance caps the version devices may be used at
+  const auto version = std::min(properties.apiVersion, GetInstanceVersion());
+  const auto extensions = GetAvailableExtensions(device);
+
+  VkFeatureChain supported(version);
+  if (version >= VK_API_VERSION_1_1) {
+    vkGetPhysicalDeviceFeatures2(device, &supported.core);
+  } else {
+    vkGetPhysicalDeviceFeatures(device, &supported.core.features);
+  }
+
+  VkNegotiation negotiation{
+      .version = version,
+      .features = std::make_unique<VkFeatureChain>(version),
+  };
+
+  for (const auto &capability: requests) {
+    if (!IsSupported(capability, version, extensions, supported)) {
+      if (capability.required) {
+        negotiation.missing.push_back(capability.name);
+      }
+      continue;
+    }
+
+    negotiation.enabled.insert(capability.name);
+    for (const auto bit: capability.features) {
+      bit(*negotiation.features) = VK_TRUE;
+    }
+    for (const auto name: capability.extensions) {
+      if (std::ranges::none_of(negotiation.extensions, [name](const char *other) { return strcmp(name, other) == 0; })) {
+        negotiation.extensions.push_back(name);
+      }
+    }
+  }
+
+  return negotiation;
+}
+
+leimu::feature::VkCapabilityTier leimu::feature::GetTier(const VkNegotiation &negotiation) noexcept {
+  const auto gpuDriven =
+      negotiation.has(capability::Bindless) &&
+      negotiation.has(capability::TimelineSemaphore) &&
+      negotiation.has(capability::IndirectFirstInstance) &&
+      negotiation.has(capability::MultiDrawIndirect) &&
+      (negotiation.has(capability::IndirectCount) || negotiation.has(capability::IndirectCountKHR));
+  if (!gpuDriven) {
+    return VkCapabilityTier::Baseline;
+  }
+
+  if (negotiation.has(capability::Synchronization2) && negotiation.has(capability::DynamicRendering)) {
+    return VkCapabilityTier::Modern;
+  }
+  return VkCapabilityTier::GpuDriven;
+}
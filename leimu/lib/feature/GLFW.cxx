@@ -2,11 +2,20 @@
 
 #include "leimu/feature/GLFW.h"
 
+#include "leimu/App.h"
+#include "leimu/trace.h"
+
 static void PrintError(int error, const char *message) {
   std::println(leimu::errs(), "[glfw] {:#X}: {}", error, message);
 }
 
-leimu::feature::GLFW::GLFW() : _window(nullptr) {
+leimu::feature::GLFW::GLFW(const App &app) : _window(nullptr), _headless(app.config()->vulkan().headless) {
+  LEIMU_ZONE("glfw: init");
+  if (_headless) {
+    std::println(outs(), "[glfw] Headless; no window is created");
+    return;
+  }
+
   glfwSetErrorCallback(PrintError);
   if (!glfwInit()) {
     return;
@@ -22,10 +31,27 @@ leimu::feature::GLFW::GLFW() : _window(nullptr) {
 }
 
 leimu::feature::GLFW::~GLFW() {
-  glfwDestroyWindow(_window);
+  if (_window) {
+    glfwDestroyWindow(_window);
+  }
   glfwTerminate();
 }
 
+VkExtent2D leimu::feature::GLFW::framebufferSize() const {
+  if (!_window) {
+    return {0, 0};
+  }
+
+  i32 w, h;
+  glfwGetFramebufferSize(_window, &w, &h);
+  return {static_cast<u32>(w), static_cast<u32>(h)};
+}
+
+bool leimu::feature::GLFW::minimized() const {
+  const auto [w, h] = framebufferSize();
+  return !_headless && (w == 0 || h == 0);
+}
+
 bool leimu::feature::GLFW::operator!() const {
-  return !_window;
+  return !_headless && !_window;
 }
@@ -3,6 +3,16 @@
 #include "leimu/feature/Vulkan.h"
 
 #include "leimu/App.h"
+#include "leimu/memory/Allocator.h"
+#include "leimu/memory/Uploader.h"
+#include "leimu/render/AsyncCompute.h"
+#include "leimu/render/Bindless.h"
+#include "leimu/render/DeletionQueue.h"
+#include "leimu/render/Descriptor.h"
+#include "leimu/render/Profiler.h"
+#include "leimu/render/Timeline.h"
+#include "leimu/trace.h"
+#include "leimu/native/mmap.h"
 
 // ReSharper disable once CppTemplateArgumentsCanBeDeduced
 const std::vector<const char *> ValidationLayers = {
@@ -47,12 +57,15 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL DebugCallback(
       {VK_DEBUG_UTILS_MESSAGE_SEVERITY_FLAG_BITS_MAX_ENUM_EXT, "crit"},
   };
 
-  if (severity <= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
-    return VK_FALSE;
-  }
+  // Filtered levels get a null stream, so dropped messages cost no formatting
+  auto &stream = severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT
+                   ? leimu::errs()
+                   : severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT
+                   ? leimu::warns()
+                   : leimu::dbgs();
 
   std::println(
-      leimu::errs(),
+      stream,
       "[vulkan] [validation] [{}] {}",
       lvs.at(severity),
       cbData->pMessage);
@@ -76,9 +89,10 @@ static void __vkAssert(const VkResult result, std::string op, std::string file,
 
 // LAYERS / EXTENSIONS
 
-std::vector<const char *> GetInstanceExtensions() {
+std::vector<const char *> GetInstanceExtensions(const bool headless) {
   u32 nExtension = 0;
-  const auto vExtension = glfwGetRequiredInstanceExtensions(&nExtension);
+  // GLFW is never initialized in headless mode, and no surface extension is needed anyway
+  const auto vExtension = headless ? nullptr : glfwGetRequiredInstanceExtensions(&nExtension);
 
   std::vector<const char *> extensions;
   extensions.reserve(nExtension + 2);
@@ -89,12 +103,6 @@ std::vector<const char *> GetInstanceExtensions() {
   return extensions;
 }
 
-std::vector<const char *> GetDeviceExtensions() {
-  return {
-      VK_KHR_SWAPCHAIN_EXTENSION_NAME
-  };
-}
-
 std::vector<const char *> GetLayers() {
   u32 nLayer;
   vkAssert(vkEnumerateInstanceLayerProperties(&nLayer, nullptr));
@@ -118,22 +126,47 @@ std::vector<const char *> GetLayers() {
   return ValidationLayers;
 }
 
-static bool CheckDeviceExtensionSupport(const VkPhysicalDevice device) {
-  u32 nExtension;
-  vkAssert(vkEnumerateDeviceExtensionProperties(device, nullptr, &nExtension, nullptr));
-
-  std::vector<VkExtensionProperties> availableExtensions(nExtension);
-  vkAssert(vkEnumerateDeviceExtensionProperties(device, nullptr, &nExtension, availableExtensions.data()));
-
-  auto extensions = GetDeviceExtensions();
-  std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
-
-  for (const auto &[name, _]: availableExtensions) {
-    requiredExtensions.erase(name);
+// PIPELINE CACHE
+
+/**
+ * Prefix of the on-disk pipeline cache.
+ * The blob's own header doesn't carry the driver version, so a driver update would otherwise feed stale data.
+ */
+struct PipelineCacheFileHeader {
+  static constexpr u32 Magic = 0x43504d4c; // 'LMPC'
+  static constexpr u32 Version = 1;
+
+  u32 magic;
+  u32 version;
+  u32 vendorID;
+  u32 deviceID;
+  u32 driverVersion;
+  u8 pipelineCacheUUID[VK_UUID_SIZE];
+  u64 dataSize;
+
+  static PipelineCacheFileHeader Of(const VkPhysicalDeviceProperties &properties, const u64 dataSize) {
+    PipelineCacheFileHeader header{
+        .magic = Magic,
+        .version = Version,
+        .vendorID = properties.vendorID,
+        .deviceID = properties.deviceID,
+        .driverVersion = properties.driverVersion,
+        .pipelineCacheUUID = {},
+        .dataSize = dataSize,
+    };
+    memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    return header;
   }
 
-  return requiredExtensions.empty();
-}
+  [[nodiscard]] bool matches(const PipelineCacheFileHeader &other) const {
+    return magic == other.magic &&
+           version == other.version &&
+           vendorID == other.vendorID &&
+           deviceID == other.deviceID &&
+           driverVersion == other.driverVersion &&
+           memcmp(pipelineCacheUUID, other.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+  }
+};
 
 // INITIALIZERS
 
@@ -234,61 +267,80 @@ VkExtent2D leimu::feature::ChooseSwapExtent(
 
 int leimu::feature::RatePhysicalDeviceSuitability(
     const VulkanPhysicalDevice &device,
-    const VulkanSurface &surface) noexcept {
+    const VulkanSurface &surface,
+    const std::span<const VkCapability> requests) noexcept {
   VkPhysicalDeviceProperties properties;
   vkGetPhysicalDeviceProperties(device.get(), &properties);
 
-  VkPhysicalDeviceFeatures features;
-  vkGetPhysicalDeviceFeatures(device.get(), &features);
-
   std::println(outs(), "[vulkan] [gpu-candidate] {}", properties.deviceName);
 
-  auto score = 0;
-  //
-  // OPTIONAL
-  //
-  if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
-    score += 1000;
-  }
-
-  // maximal size of textures (affects graphics quality)
-  score += static_cast<i32>(std::min(properties.limits.maxImageDimension2D, static_cast<u32>(INT32_MAX)));
-
   //
   // REQUIRED
   //
-  if (!features.geometryShader) {
-    std::println(outs(), "[vulkan] [gpu-eliminate] '{}' has no geometry shader feature", properties.deviceName);
-    score *= 0;
+  const auto negotiation = Negotiate(device.get(), requests);
+  if (!negotiation.satisfied()) {
+    for (const auto &name: negotiation.missing) {
+      std::println(outs(), "[vulkan] [gpu-eliminate] '{}' lacks required capability '{}'", properties.deviceName, name);
+    }
+    return 0;
   }
 
   if (!GetQueueFamilyIndices(device, surface)) {
     std::println(
         outs(), "[vulkan] [gpu-eliminate] '{}' doesn't have required queue family", properties.deviceName);
-    score *= 0;
-  }
-
-  if (!CheckDeviceExtensionSupport(device.get())) {
-    std::println(
-        outs(), "[vulkan] [gpu-eliminate] '{}' doesn't support required extension", properties.deviceName);
-    score *= 0;
+    return 0;
   }
 
-  if (score > 0 &&
+  if (surface &&
       (!GetSurfaceCapabilities(device, surface) ||
        GetPresentModes(device, surface).empty() ||
        GetSurfaceFormats(device, surface).empty())) {
 
     std::println(outs(), "[vulkan] [gpu-eliminate] There is no adequate swapchain in '{}'", properties.deviceName);
-    score *= 0;
+    return 0;
   }
 
+  //
+  // OPTIONAL
+  //
+  // Faster render paths outweigh everything else, then the kind of device, then what else it can do
+  auto score = 1;
+  score += 10000 * static_cast<i32>(GetTier(negotiation));
+
+  switch (properties.deviceType) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+      score += 4000;
+      break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+      score += 2000;
+      break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+      score += 1000;
+      break;
+    default:
+      break;
+  }
+
+  score += 100 * static_cast<i32>(negotiation.enabled.size());
+
+  // Device-local memory, in GiB up to 64
+  VkPhysicalDeviceMemoryProperties memory;
+  vkGetPhysicalDeviceMemoryProperties(device.get(), &memory);
+  VkDeviceSize local = 0;
+  for (u32 i = 0; i < memory.memoryHeapCount; ++i) {
+    if (memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      local = std::max(local, memory.memoryHeaps[i].size);
+    }
+  }
+  score += static_cast<i32>(std::min<VkDeviceSize>(local >> 30, 64));
+
   return score;
 }
 
-
-leimu::feature::VulkanInstance leimu::feature::CreateInstance(VkApplicationInfo info) noexcept {
-  auto extensions = GetInstanceExtensions();
+leimu::feature::VulkanInstance leimu::feature::CreateInstance(
+    VkApplicationInfo info,
+    const bool headless) noexcept {
+  auto extensions = GetInstanceExtensions(headless);
   for (const auto ext: extensions) {
     std::println(outs(), "[vulkan] [ext] {}", ext);
   }
@@ -363,7 +415,8 @@ leimu::feature::VulkanSurface leimu::feature::CreateSurface(
 
 leimu::feature::VulkanPhysicalDevice leimu::feature::GetPhysicalDevice(
     const VulkanInstance &instance,
-    const VulkanSurface &surface) noexcept {
+    const VulkanSurface &surface,
+    const std::span<const VkCapability> requests) noexcept {
   u32 nDevice;
   vkAssert(vkEnumeratePhysicalDevices(instance.get(), &nDevice, nullptr));
   if (!nDevice) {
@@ -376,7 +429,7 @@ leimu::feature::VulkanPhysicalDevice leimu::feature::GetPhysicalDevice(
 
   std::multimap<int, VkPhysicalDevice> candidates;
   for (const auto &device: devices) {
-    auto score = RatePhysicalDeviceSuitability(proxy(device), surface);
+    auto score = RatePhysicalDeviceSuitability(proxy(device), surface, requests);
     candidates.insert(std::make_pair(score, device));
   }
 
@@ -414,29 +467,72 @@ leimu::feature::VulkanQueueFamilyIndices leimu::feature::GetQueueFamilyIndices(
       graphics = i;
     }
 
+    // Without a surface nothing is presented; the graphics family stands in for the present family
+    if (!surface) {
+      continue;
+    }
+
     VkBool32 supportPresent = false;
     vkAssert(vkGetPhysicalDeviceSurfaceSupportKHR(device.get(), i, surface.get(), &supportPresent));
     if (supportPresent) {
       present = i;
     }
   }
+  if (!surface) {
+    present = graphics;
+  }
+
   if (graphics == -1) {
     std::println(errs(), "[vulkan] Couldn't find graphics queue");
   }
   if (present == -1) {
     std::println(errs(), "[vulkan] Couldn't find present queue");
   }
+  if (graphics == -1 || present == -1) {
+    return nullptr;
+  }
+
+  // Prefer a DMA-only family, then any non-graphics one; copies there don't compete with rendering
+  u32 transfer = graphics;
+  for (u32 i = 0, best = 0; i < nFamily; i++) {
+    const auto flags = families[i].queueFlags;
+    if (!(flags & VK_QUEUE_TRANSFER_BIT) || flags & VK_QUEUE_GRAPHICS_BIT) {
+      continue;
+    }
+
+    const u32 rank = flags & VK_QUEUE_COMPUTE_BIT ? 1 : 2;
+    if (rank > best) {
+      best = rank;
+      transfer = i;
+    }
+  }
 
-  return std::make_shared<VkQueueFamilyIndices_T>(graphics, present);
+  // Compute-only families run asynchronously to rasterization on most hardware
+  u32 compute = graphics;
+  for (u32 i = 0; i < nFamily; i++) {
+    const auto flags = families[i].queueFlags;
+    if (flags & VK_QUEUE_COMPUTE_BIT && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+      compute = i;
+      break;
+    }
+  }
+
+  return std::make_shared<VkQueueFamilyIndices_T>(graphics, present, transfer, compute);
 }
 
 leimu::feature::VulkanDevice leimu::feature::CreateDevice(
     const VulkanPhysicalDevice &phy,
-    const VulkanSurface &surface) noexcept {
+    const VulkanSurface &surface,
+    const VkNegotiation &negotiation) noexcept {
   auto indices = GetQueueFamilyIndices(phy, surface);
   assert(indices);
 
-  const std::set families = {indices.get()->graphicsQueue, indices.get()->presentQueue};
+  const std::set families = {
+      indices.get()->graphicsQueue,
+      indices.get()->presentQueue,
+      indices.get()->transferQueue,
+      indices.get()->computeQueue,
+  };
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
   queueCreateInfos.reserve(families.size());
 
@@ -451,10 +547,6 @@ leimu::feature::VulkanDevice leimu::feature::CreateDevice(
         });
   }
 
-  VkPhysicalDeviceFeatures features{};
-
-  auto extensions = GetDeviceExtensions();
-
   auto layers = GetLayers();
   VkDeviceCreateInfo createInfo{
       .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
@@ -466,12 +558,17 @@ leimu::feature::VulkanDevice leimu::feature::CreateDevice(
       .enabledLayerCount = static_cast<u32>(layers.size()),
       .ppEnabledLayerNames = layers.data(),
 
-      .enabledExtensionCount = static_cast<u32>(extensions.size()),
-      .ppEnabledExtensionNames = extensions.data(),
-
-      .pEnabledFeatures = &features,
+      .enabledExtensionCount = static_cast<u32>(negotiation.extensions.size()),
+      .ppEnabledExtensionNames = negotiation.extensions.data(),
   };
 
+  // Features of Vulkan 1.1+ are chained, which rules pEnabledFeatures out
+  if (negotiation.version >= VK_API_VERSION_1_1) {
+    createInfo.pNext = &negotiation.features->core;
+  } else {
+    createInfo.pEnabledFeatures = &negotiation.features->core.features;
+  }
+
   VkDevice device;
   if (vkCreateDevice(phy.get(), &createInfo, nullptr, &device) != VK_SUCCESS) {
     std::println(errs(), "[vulkan] Couldn't create logical device");
@@ -485,12 +582,65 @@ leimu::feature::VulkanDevice leimu::feature::CreateDevice(
   };
 }
 
+leimu::feature::VulkanCapabilities leimu::feature::GetCapabilities(
+    const VulkanPhysicalDevice &phy,
+    const VulkanDevice &device,
+    const VkNegotiation &negotiation) noexcept {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(phy.get(), &properties);
+
+  auto capabilities = std::make_shared<VkCapabilities_T>();
+  capabilities->apiVersion = negotiation.version;
+  capabilities->tier = GetTier(negotiation);
+  capabilities->enabled = negotiation.enabled;
+
+  capabilities->multiDrawIndirect = negotiation.has(capability::MultiDrawIndirect);
+  capabilities->drawIndirectFirstInstance = negotiation.has(capability::IndirectFirstInstance);
+  capabilities->maxDrawIndirectCount = properties.limits.maxDrawIndirectCount;
+
+  // The core command and the extension's are interchangeable
+  if (negotiation.has(capability::IndirectCount)) {
+    capabilities->cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+        vkGetDeviceProcAddr(device.get(), "vkCmdDrawIndexedIndirectCount"));
+  } else if (negotiation.has(capability::IndirectCountKHR)) {
+    capabilities->cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+        vkGetDeviceProcAddr(device.get(), "vkCmdDrawIndexedIndirectCountKHR"));
+  }
+
+  if ((capabilities->bindless = negotiation.has(capability::Bindless))) {
+    VkPhysicalDeviceVulkan12Properties properties12{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES};
+    VkPhysicalDeviceProperties2 properties2{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &properties12,
+    };
+    vkGetPhysicalDeviceProperties2(phy.get(), &properties2);
+
+    capabilities->maxBindlessSampledImages = std::min(
+        properties12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+        properties12.maxDescriptorSetUpdateAfterBindSampledImages);
+    capabilities->maxBindlessStorageBuffers = std::min(
+        properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+        properties12.maxDescriptorSetUpdateAfterBindStorageBuffers);
+    capabilities->maxBindlessSamplers = std::min(
+        properties12.maxPerStageDescriptorUpdateAfterBindSamplers,
+        properties12.maxDescriptorSetUpdateAfterBindSamplers);
+    capabilities->maxBindlessResources = properties12.maxPerStageUpdateAfterBindResources;
+  }
+
+  capabilities->timelineSemaphore = negotiation.has(capability::TimelineSemaphore);
+  capabilities->synchronization2 = negotiation.has(capability::Synchronization2);
+  capabilities->dynamicRendering = negotiation.has(capability::DynamicRendering);
+
+  return capabilities;
+}
+
 leimu::feature::VulkanSwapchain leimu::feature::CreateSwapchain(
     const VulkanDevice &dev,
     const VulkanSurface &surface,
     const VulkanSurfaceInfo &surfaceInfo,
     VkExtent2D extent,
-    const VulkanQueueFamilyIndices &families) noexcept {
+    const VulkanQueueFamilyIndices &families,
+    const VulkanSwapchain &oldSwapchain) noexcept {
 
   u32 nImage = surfaceInfo->capabilities.minImageCount + 1;
   if (surfaceInfo->capabilities.maxImageCount > 0 && nImage > surfaceInfo->capabilities.maxImageCount) {
@@ -510,7 +660,8 @@ leimu::feature::VulkanSwapchain leimu::feature::CreateSwapchain(
       .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
       .presentMode = surfaceInfo->mode,
       .clipped = VK_TRUE,
-      .oldSwapchain = VK_NULL_HANDLE,
+      // Lets the driver reuse resources of the retired swapchain
+      .oldSwapchain = oldSwapchain ? oldSwapchain.get() : VK_NULL_HANDLE,
   };
 
   auto indices = families->indices();
@@ -581,10 +732,38 @@ std::vector<VkImage> leimu::feature::GetImages(
   return images;
 }
 
+std::shared_ptr<leimu::memory::Image_T> leimu::feature::CreateOffscreenImage(
+    memory::Allocator &allocator,
+    const VkFormat format,
+    const VkExtent2D extent) noexcept {
+
+  VkImageCreateInfo createInfo{
+      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+      .imageType = VK_IMAGE_TYPE_2D,
+      .format = format,
+      .extent = {extent.width, extent.height, 1},
+      .mipLevels = 1,
+      .arrayLayers = 1,
+      .samples = VK_SAMPLE_COUNT_1_BIT,
+      .tiling = VK_IMAGE_TILING_OPTIMAL,
+      .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+  };
+
+  auto image = allocator.createImage(createInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  if (!image) {
+    std::println(errs(), "[vulkan] [headless] Couldn't create offscreen image");
+    return nullptr;
+  }
+
+  return image;
+}
+
 std::vector<leimu::feature::VulkanImageView> leimu::feature::CreateImageViews(
     const VulkanDevice& device,
     const std::vector<VkImage> &images,
-    const leimu::feature::VulkanSurfaceInfo &surfaceInfo) {
+    const VkFormat format) {
 
   std::vector<VulkanImageView> views(images.size());
   for (auto i = 0; i < images.size(); ++i) {
@@ -592,7 +771,7 @@ std::vector<leimu::feature::VulkanImageView> leimu::feature::CreateImageViews(
       .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
       .image = images[i],
       .viewType = VK_IMAGE_VIEW_TYPE_2D,
-      .format = surfaceInfo->format.format,
+      .format = format,
       .components = {
           VK_COMPONENT_SWIZZLE_IDENTITY,
           VK_COMPONENT_SWIZZLE_IDENTITY,
@@ -610,7 +789,7 @@ std::vector<leimu::feature::VulkanImageView> leimu::feature::CreateImageViews(
 
     VkImageView view;
     if (vkCreateImageView(device.get(), &createInfo, nullptr, &view) != VK_SUCCESS) {
-      std::println(errs(), "[vulkan] Failed to create view from swapchain image");
+      std::println(errs(), "[vulkan] Failed to create view from target image");
       return {};
     }
 
@@ -622,16 +801,338 @@ std::vector<leimu::feature::VulkanImageView> leimu::feature::CreateImageViews(
   return views;
 }
 
-leimu::feature::Vulkan::Vulkan(const App &app) {
+leimu::feature::VulkanRenderPass leimu::feature::CreateRenderPass(
+    const VulkanDevice &device,
+    const VkFormat format,
+    const VkImageLayout finalLayout) noexcept {
+
+  VkAttachmentDescription colorAttachment{
+      .format = format,
+      .samples = VK_SAMPLE_COUNT_1_BIT,
+      .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+      .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+      .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+      .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+      .finalLayout = finalLayout,
+  };
+
+  VkAttachmentReference colorReference{
+      .attachment = 0,
+      .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+  };
+
+  VkSubpassDescription subpass{
+      .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+      .colorAttachmentCount = 1,
+      .pColorAttachments = &colorReference,
+  };
+
+  // The image is acquired asynchronously; layout transition must wait for the acquire semaphore
+  VkSubpassDependency dependency{
+      .srcSubpass = VK_SUBPASS_EXTERNAL,
+      .dstSubpass = 0,
+      .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+      .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+      .srcAccessMask = 0,
+      .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+  };
+
+  VkRenderPassCreateInfo createInfo{
+      .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+      .attachmentCount = 1,
+      .pAttachments = &colorAttachment,
+      .subpassCount = 1,
+      .pSubpasses = &subpass,
+      .dependencyCount = 1,
+      .pDependencies = &dependency,
+  };
+
+  VkRenderPass renderPass;
+  if (vkCreateRenderPass(device.get(), &createInfo, nullptr, &renderPass) != VK_SUCCESS) {
+    std::println(errs(), "[vulkan] Couldn't create render pass");
+    return nullptr;
+  }
+
+  return {
+      renderPass, [=](const VkRenderPass self) {
+        vkDestroyRenderPass(device.get(), self, nullptr);
+      }
+  };
+}
+
+std::vector<leimu::feature::VulkanFramebuffer> leimu::feature::CreateFramebuffers(
+    const VulkanDevice &device,
+    const VulkanRenderPass &renderPass,
+    const std::vector<VulkanImageView> &views,
+    const VkExtent2D extent) noexcept {
+
+  std::vector<VulkanFramebuffer> framebuffers(views.size());
+  for (auto i = 0; i < views.size(); ++i) {
+    const auto view = views[i].get();
+
+    VkFramebufferCreateInfo createInfo{
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .renderPass = renderPass.get(),
+        .attachmentCount = 1,
+        .pAttachments = &view,
+        .width = extent.width,
+        .height = extent.height,
+        .layers = 1,
+    };
+
+    VkFramebuffer framebuffer;
+    if (vkCreateFramebuffer(device.get(), &createInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+      std::println(errs(), "[vulkan] Failed to create framebuffer");
+      return {};
+    }
+
+    framebuffers[i] = VulkanFramebuffer(framebuffer, [=](const VkFramebuffer self) {
+      vkDestroyFramebuffer(device.get(), self, nullptr);
+    });
+  }
+
+  return framebuffers;
+}
+
+leimu::feature::VulkanCommandPool leimu::feature::CreateCommandPool(
+    const VulkanDevice &device,
+    const u32 family,
+    const VkCommandPoolCreateFlags flags) noexcept {
+
+  VkCommandPoolCreateInfo createInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .flags = flags,
+      .queueFamilyIndex = family,
+  };
+
+  VkCommandPool pool;
+  if (vkCreateCommandPool(device.get(), &createInfo, nullptr, &pool) != VK_SUCCESS) {
+    std::println(errs(), "[vulkan] Couldn't create command pool");
+    return nullptr;
+  }
+
+  return {
+      pool, [=](const VkCommandPool self) {
+        vkDestroyCommandPool(device.get(), self, nullptr);
+      }
+  };
+}
+
+leimu::feature::VulkanFence leimu::feature::CreateFence(
+    const VulkanDevice &device,
+    const bool signaled) noexcept {
+
+  VkFenceCreateInfo createInfo{
+      .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+      .flags = signaled ? VK_FENCE_CREATE_SIGNALED_BIT : 0u,
+  };
+
+  VkFence fence;
+  if (vkCreateFence(device.get(), &createInfo, nullptr, &fence) != VK_SUCCESS) {
+    std::println(errs(), "[vulkan] Couldn't create fence");
+    return nullptr;
+  }
+
+  return {
+      fence, [=](const VkFence self) {
+        vkDestroyFence(device.get(), self, nullptr);
+      }
+  };
+}
+
+leimu::feature::VulkanSemaphore leimu::feature::CreateSemaphore(const VulkanDevice &device) noexcept {
+  VkSemaphoreCreateInfo createInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+  };
+
+  VkSemaphore semaphore;
+  if (vkCreateSemaphore(device.get(), &createInfo, nullptr, &semaphore) != VK_SUCCESS) {
+    std::println(errs(), "[vulkan] Couldn't create semaphore");
+    return nullptr;
+  }
+
+  return {
+      semaphore, [=](const VkSemaphore self) {
+        vkDestroySemaphore(device.get(), self, nullptr);
+      }
+  };
+}
+
+std::vector<leimu::feature::VulkanSemaphore> leimu::feature::CreateSemaphores(
+    const VulkanDevice &device,
+    const size_t count) noexcept {
+
+  std::vector<VulkanSemaphore> semaphores(count);
+  for (auto &semaphore: semaphores) {
+    if (!((semaphore = CreateSemaphore(device)))) {
+      return {};
+    }
+  }
+
+  return semaphores;
+}
+
+leimu::feature::VulkanPipelineCache leimu::feature::CreatePipelineCache(
+    const VulkanPhysicalDevice &phy,
+    const VulkanDevice &device,
+    const std::filesystem::path &path) noexcept {
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(phy.get(), &properties);
+  const auto expected = PipelineCacheFileHeader::Of(properties, 0);
+
+  VkPipelineCacheCreateInfo createInfo{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+      .initialDataSize = 0,
+      .pInitialData = nullptr,
+  };
+
+  // Kept alive until the driver has consumed the initial data
+  native::FileMapping map;
+
+  std::error_code ec;
+  if (path.empty()) {
+    std::println(outs(), "[vulkan] [pipeline-cache] persistence disabled");
+  } else if (std::filesystem::file_size(path, ec) < sizeof(PipelineCacheFileHeader) || ec) {
+    std::println(outs(), "[vulkan] [pipeline-cache] no cache at '{}'; cold start", path.string());
+  } else if (!((map = native::CreateFileMapping(path)))) {
+    std::println(errs(), "[vulkan] [pipeline-cache] Couldn't map '{}'; cold start", path.string());
+  } else {
+    const auto header = static_cast<const PipelineCacheFileHeader *>(map->ptr());
+    if (!header->matches(expected) || header->dataSize != map->size() - sizeof(PipelineCacheFileHeader)) {
+      std::println(outs(), "[vulkan] [pipeline-cache] '{}' belongs to another device or driver; cold start", path.string());
+    } else {
+      // The driver reads straight from the mapping; nothing is copied on our side
+      createInfo.initialDataSize = header->dataSize;
+      createInfo.pInitialData = header + 1;
+    }
+  }
+
+  VkPipelineCache cache;
+  auto result = vkCreatePipelineCache(device.get(), &createInfo, nullptr, &cache);
+  if (result != VK_SUCCESS && createInfo.pInitialData) {
+    std::println(errs(), "[vulkan] [pipeline-cache] Driver rejected '{}'; cold start", path.string());
+    createInfo.initialDataSize = 0;
+    createInfo.pInitialData = nullptr;
+    result = vkCreatePipelineCache(device.get(), &createInfo, nullptr, &cache);
+  }
+  if (result != VK_SUCCESS) {
+    std::println(errs(), "[vulkan] Couldn't create pipeline cache");
+    return nullptr;
+  }
+
+  if (createInfo.pInitialData) {
+    std::println(outs(), "[vulkan] [pipeline-cache] warm start with {} bytes", createInfo.initialDataSize);
+  }
+
+  return {
+      cache, [=](const VkPipelineCache self) {
+        vkDestroyPipelineCache(device.get(), self, nullptr);
+      }
+  };
+}
+
+bool leimu::feature::SavePipelineCache(
+    const VulkanPhysicalDevice &phy,
+    const VulkanDevice &device,
+    const VulkanPipelineCache &cache,
+    const std::filesystem::path &path) noexcept {
+
+  size_t size;
+  if (vkGetPipelineCacheData(device.get(), cache.get(), &size, nullptr) != VK_SUCCESS) {
+    std::println(errs(), "[vulkan] [pipeline-cache] Couldn't query cache size");
+    return false;
+  }
+
+  std::vector<char> data(size);
+  if (vkGetPipelineCacheData(device.get(), cache.get(), &size, data.data()) != VK_SUCCESS) {
+    std::println(errs(), "[vulkan] [pipeline-cache] Couldn't retrieve cache data");
+    return false;
+  }
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(phy.get(), &properties);
+  const auto header = PipelineCacheFileHeader::Of(properties, size);
+
+  // Written aside and renamed over the old file, so a crashing process never leaves a torn cache behind.
+  // Nothing is synced to disk, though; after a power loss the file may be short or zeroed,
+  // which loading rejects through the header's data size and the driver through its own cache header
+  auto temp = path;
+  temp += ".tmp";
+  {
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(&header), sizeof header);
+    out.write(data.data(), static_cast<std::streamsize>(size));
+    if (!out.flush()) {
+      std::println(errs(), "[vulkan] [pipeline-cache] Couldn't write '{}'", temp.string());
+      return false;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(temp, path, ec);
+  if (ec) {
+    std::println(errs(), "[vulkan] [pipeline-cache] Couldn't replace '{}': {}", path.string(), ec.message());
+    return false;
+  }
+
+  std::println(outs(), "[vulkan] [pipeline-cache] saved {} bytes to '{}'", size, path.string());
+  return true;
+}
+
+leimu::feature::VulkanFrame leimu::feature::CreateFrame(
+    const VulkanDevice &device,
+    const VulkanQueueFamilyIndices &families,
+    const u32 index) noexcept {
+
+  auto frame = std::make_shared<VkFrame_T>();
+  frame->index = index;
+  frame->imageIndex = 0;
+  frame->number = 0;
+
+  // Buffers are reset in bulk by resetting the pool once the slot is retired
+  if (!((frame->commandPool = CreateCommandPool(device, families->graphicsQueue, 0)))) {
+    return nullptr;
+  }
+
+  VkCommandBufferAllocateInfo allocInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool = frame->commandPool.get(),
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1,
+  };
+  if (vkAllocateCommandBuffers(device.get(), &allocInfo, &frame->commandBuffer) != VK_SUCCESS) {
+    std::println(errs(), "[vulkan] Couldn't allocate command buffer");
+    return nullptr;
+  }
+
+  // Signaled at creation so that the first wait on a fresh slot doesn't block
+  if (!((frame->inFlight = CreateFence(device, true)))) {
+    return nullptr;
+  }
+
+  if (!((frame->imageAvailable = CreateSemaphore(device)))) {
+    return nullptr;
+  }
+
+  return frame;
+}
+
+leimu::feature::Vulkan::Vulkan(const App &app) : _headless(app.config()->vulkan().headless), _glfw(&app.glfw()) {
+  LEIMU_STEPS(steps);
+
+  LEIMU_STEP(steps, "vulkan: instance");
   VkApplicationInfo info{
       .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
-      .apiVersion = VK_API_VERSION_1_0,
+      .apiVersion = GetInstanceVersion(),
   };
-  if (!((_instance = CreateInstance(info)))) {
+  if (!((_instance = CreateInstance(info, _headless)))) {
     std::println(errs(), "[vulkan] Failed to create instance");
     return;
   }
 
+  LEIMU_STEP(steps, "vulkan: debug messenger");
 #if LEIMU_DEBUG
   if (!((_debugMessenger = CreateDebugUtilsMessenger(_instance)))) {
     std::println(errs(), "[vulkan] Failed to create debug messenger");
@@ -639,31 +1140,51 @@ leimu::feature::Vulkan::Vulkan(const App &app) {
   }
 #endif
 
-  if (!((_surface = CreateSurface(_instance, app.glfw())))) {
+  LEIMU_STEP(steps, "vulkan: surface");
+  if (!_headless && !((_surface = CreateSurface(_instance, app.glfw())))) {
     std::println(errs(), "[vulkan] Failed to create surface");
     return;
   }
 
-  if (!((_physicalDevice = GetPhysicalDevice(_instance, _surface)))) {
+  LEIMU_STEP(steps, "vulkan: physical device");
+  const auto requests = GetCapabilityRequests(_headless, app.config()->vulkan().capabilities);
+  if (!((_physicalDevice = GetPhysicalDevice(_instance, _surface, requests)))) {
     std::println(errs(), "[vulkan] Failed to get physical device");
     return;
   }
 
-  if (!((_surfaceInfo = RetrieveSurfaceInfo(_physicalDevice, _surface, app.config()->vulkan().latencyRelaxed)))) {
+  LEIMU_STEP(steps, "vulkan: surface info");
+  if (!_headless &&
+      !((_surfaceInfo = RetrieveSurfaceInfo(_physicalDevice, _surface, app.config()->vulkan().latencyRelaxed)))) {
     std::println(errs(), "[vulkan] Failed to retrieve surface info");
     return;
   }
 
+  LEIMU_STEP(steps, "vulkan: queue families");
   if (!((_queueIndices = GetQueueFamilyIndices(_physicalDevice, _surface)))) {
     std::println(errs(), "[vulkan] Failed to get queue indices");
     return;
   }
 
-  if (!((_device = CreateDevice(_physicalDevice, _surface)))) {
+  LEIMU_STEP(steps, "vulkan: device");
+  const auto negotiation = Negotiate(_physicalDevice.get(), requests);
+  if (!((_device = CreateDevice(_physicalDevice, _surface, negotiation)))) {
     std::println(errs(), "[vulkan] Failed to create device");
     return;
   }
 
+  _capabilities = GetCapabilities(_physicalDevice, _device, negotiation);
+  std::println(
+      outs(),
+      "[vulkan] [capabilities] Vulkan {}.{}, {} tier",
+      VK_API_VERSION_MAJOR(_capabilities->apiVersion),
+      VK_API_VERSION_MINOR(_capabilities->apiVersion),
+      GetTierName(_capabilities->tier));
+  for (const auto &name: _capabilities->enabled) {
+    std::println(outs(), "[vulkan] [capabilities] {}", name);
+  }
+
+  LEIMU_STEP(steps, "vulkan: queues");
   if (!((_graphicsQueue = GetQueue(_device, _queueIndices->graphicsQueue)))) {
     std::println(errs(), "[vulkan] Failed to get graphics queue");
     return;
@@ -674,24 +1195,453 @@ leimu::feature::Vulkan::Vulkan(const App &app) {
     return;
   }
 
-  const auto extent = ChooseSwapExtent(_surfaceInfo->capabilities, app.glfw());
+  if (!((_transferQueue = GetQueue(_device, _queueIndices->transferQueue)))) {
+    std::println(errs(), "[vulkan] Failed to get transfer queue");
+    return;
+  }
+
+  if (!((_computeQueue = GetQueue(_device, _queueIndices->computeQueue)))) {
+    std::println(errs(), "[vulkan] Failed to get compute queue");
+    return;
+  }
+
+  std::println(
+      outs(),
+      "[vulkan] [queue] graphics #{}, present #{}, transfer #{}, compute #{}",
+      _queueIndices->graphicsQueue,
+      _queueIndices->presentQueue,
+      _queueIndices->transferQueue,
+      _queueIndices->computeQueue);
+
+  LEIMU_STEP(steps, "vulkan: pipeline cache");
+  _pipelineCachePath = app.config()->vulkan().pipelineCachePath;
+  if (!((_pipelineCache = CreatePipelineCache(_physicalDevice, _device, _pipelineCachePath)))) {
+    std::println(errs(), "[vulkan] Failed to create pipeline cache");
+    return;
+  }
+
+  const auto nFrame = std::max(app.config()->vulkan().framesInFlight, 1u);
+
+  LEIMU_STEP(steps, "vulkan: allocator");
+  if (!((_allocator = memory::CreateAllocator(_physicalDevice, _device, nFrame)))) {
+    std::println(errs(), "[vulkan] Failed to create memory allocator");
+    return;
+  }
+
+  LEIMU_STEP(steps, "vulkan: timelines");
+  if (_capabilities->timelineSemaphore) {
+    const std::array queues{_graphicsQueue, _presentQueue, _transferQueue, _computeQueue};
+    _timelines = std::make_shared<render::Timelines>(_device, queues);
+    if (!*_timelines) {
+      _timelines = nullptr;
+    }
+  }
+
+  LEIMU_STEP(steps, "vulkan: uploader");
+  if (!((_uploader = memory::CreateUploader(
+    _device,
+    _allocator,
+    _queueIndices,
+    _transferQueue,
+    _timelines ? _timelines->get(render::QueueKind::Transfer) : nullptr,
+    app.config()->vulkan().stagingSize)))) {
+    std::println(errs(), "[vulkan] Failed to create uploader");
+    return;
+  }
+
+  _deletion = std::make_shared<render::DeletionQueue>();
+
+  LEIMU_STEP(steps, "vulkan: compute, descriptors, bindless, profiler");
+  _compute = std::make_shared<render::AsyncCompute>(
+      _device,
+      _queueIndices,
+      _computeQueue,
+      _timelines ? _timelines->get(render::QueueKind::Compute) : nullptr);
+  _descriptors = std::make_shared<render::DescriptorAllocator>(_device, nFrame);
+  if (_capabilities->bindless) {
+    _bindless = std::make_shared<render::Bindless>(_device, *_capabilities, _descriptors->layouts());
+    if (!*_bindless) {
+      _bindless = nullptr;
+    }
+  }
+  _profiler = std::make_shared<render::Profiler>(
+      _physicalDevice,
+      _device,
+      _queueIndices->graphicsQueue,
+      nFrame,
+      app.config()->profiler());
+
+  LEIMU_STEP(steps, "vulkan: targets");
+  if (_headless) {
+    _extent = app.config()->vulkan().headlessExtent;
+    // Mandatory color attachment format; no surface dictates anything else
+    _format = VK_FORMAT_R8G8B8A8_UNORM;
+
+    // Each slot renders into its own target so that frames never wait on each other
+    for (u32 i = 0; i < nFrame; ++i) {
+      const auto image = CreateOffscreenImage(*_allocator, _format, _extent);
+      if (!image) {
+        std::println(errs(), "[vulkan] Failed to create offscreen image #{}", i);
+        return;
+      }
+      _offscreenImages.push_back(image);
+      _images.push_back(image->handle);
+    }
+
+    std::println(outs(), "[vulkan] [headless] rendering offscreen at {}x{}", _extent.width, _extent.height);
+  } else {
+    _extent = ChooseSwapExtent(_surfaceInfo->capabilities, app.glfw());
+    _framebufferSize = app.glfw().framebufferSize();
+    _format = _surfaceInfo->format.format;
+
+    if (!((_swapchain = CreateSwapchain(_device, _surface, _surfaceInfo, _extent, _queueIndices, nullptr)))) {
+      std::println(errs(), "[vulkan] Failed to create swapchain");
+      return;
+    }
+
+    if (((_images = GetImages(_device, _swapchain))).empty()) {
+      std::println(errs(), "[vulkan] Failed to get swapchain images");
+      return;
+    }
+  }
+
+  LEIMU_STEP(steps, "vulkan: image views");
+  if (((_imageViews = CreateImageViews(_device, _images, _format))).empty()) {
+    std::println(errs(), "[vulkan] Failed to create target views");
+    return;
+  }
+
+  LEIMU_STEP(steps, "vulkan: render pass");
+  const auto finalLayout = _headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  if (!((_renderPass = CreateRenderPass(_device, _format, finalLayout)))) {
+    std::println(errs(), "[vulkan] Failed to create render pass");
+    return;
+  }
 
-  if (!((_swapchain = CreateSwapchain(_device, _surface, _surfaceInfo, extent, _queueIndices)))) {
-    std::println(errs(), "[vulkan] Failed to create swapchain");
+  LEIMU_STEP(steps, "vulkan: framebuffers");
+  if (((_framebuffers = CreateFramebuffers(_device, _renderPass, _imageViews, _extent))).empty()) {
+    std::println(errs(), "[vulkan] Failed to create framebuffers");
     return;
   }
 
-  if (((_swapchainImages = GetImages(_device, _swapchain))).empty()) {
-    std::println(errs(), "[vulkan] Failed to get swapchain images");
+  LEIMU_STEP(steps, "vulkan: semaphores");
+  if (!_headless && ((_renderFinished = CreateSemaphores(_device, _images.size()))).empty()) {
+    std::println(errs(), "[vulkan] Failed to create render semaphores");
+    return;
+  }
+
+  LEIMU_STEP(steps, "vulkan: frames");
+  for (u32 i = 0; i < nFrame; ++i) {
+    const auto frame = CreateFrame(_device, _queueIndices, i);
+    if (!frame) {
+      std::println(errs(), "[vulkan] Failed to create frame #{}", i);
+      _frames.clear();
+      return;
+    }
+    _frames.push_back(frame);
+  }
+  std::println(outs(), "[vulkan] [frame] {} frame(s) in flight", _frames.size());
+}
+
+leimu::feature::Vulkan::~Vulkan() {
+  // Every handle below may still be referenced by in-flight frames
+  waitIdle();
+  if (_deletion) {
+    _deletion->flush();
+  }
+
+  if (_pipelineCache && !_pipelineCachePath.empty()) {
+    SavePipelineCache(_physicalDevice, _device, _pipelineCache, _pipelineCachePath);
+  }
+}
+
+void leimu::feature::Vulkan::waitIdle() const noexcept {
+  if (_device) {
+    vkAssert(vkDeviceWaitIdle(_device.get()));
+  }
+}
+
+leimu::feature::VkFrame_T *leimu::feature::Vulkan::beginFrame() noexcept {
+  auto &frame = *_frames[_frameNumber % _frames.size()];
+
+  LEIMU_STEPS(steps);
+  if (_timelines) {
+    LEIMU_STEP(steps, "frame: wait timeline");
+    _timelines->get(render::QueueKind::Graphics)->wait(frame.timeline);
+  } else {
+    LEIMU_STEP(steps, "frame: wait fence");
+    const auto fence = frame.inFlight.get();
+    vkAssert(vkWaitForFences(_device.get(), 1, &fence, VK_TRUE, UINT64_MAX));
+  }
+
+  // Frames complete in submission order; the one last submitted on this slot is done, and so is everything before it
+  if (_frameNumber >= _frames.size()) {
+    _completedFrames = std::max(_completedFrames, _frameNumber - _frames.size() + 1);
+  }
+  LEIMU_STEP(steps, "frame: recycle");
+  _deletion->collect(_frameNumber, _completedFrames);
+  _allocator->resetLinear(frame.index);
+  _descriptors->reset(frame.index);
+  if (_bindless) {
+    _bindless->collect(_frameNumber, _completedFrames);
+  }
+
+  if (_headless) {
+    frame.imageIndex = frame.index;
+  } else {
+    if (const auto size = _glfw->framebufferSize();
+      size.width != _framebufferSize.width || size.height != _framebufferSize.height) {
+      _swapchainDirty = true;
+    }
+
+    LEIMU_STEP(steps, "frame: acquire");
+    if (_swapchainDirty && !recreateSwapchain()) {
+      return nullptr;
+    }
+
+    const auto result = vkAcquireNextImageKHR(
+        _device.get(),
+        _swapchain.get(),
+        UINT64_MAX,
+        frame.imageAvailable.get(),
+        VK_NULL_HANDLE,
+        &frame.imageIndex);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+      _swapchainDirty = true;
+      return nullptr;
+    }
+    if (result == VK_SUBOPTIMAL_KHR) {
+      // The image is still presentable; recreate on the next frame
+      _swapchainDirty = true;
+    } else if (result != VK_SUCCESS) {
+      std::println(errs(), "[vulkan] [frame] Couldn't acquire swapchain image ({})", static_cast<i32>(result));
+      return nullptr;
+    }
+  }
+
+  LEIMU_STEP(steps, "frame: begin commands");
+  vkAssert(vkResetCommandPool(_device.get(), frame.commandPool.get(), 0));
+
+  VkCommandBufferBeginInfo beginInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+  };
+  if (vkBeginCommandBuffer(frame.commandBuffer, &beginInfo) != VK_SUCCESS) {
+    std::println(errs(), "[vulkan] [frame] Couldn't begin command buffer");
+    if (!_headless) {
+      // The acquired image's semaphore would stay signaled otherwise
+      frame.waitSemaphores = {frame.imageAvailable.get()};
+      frame.waitStages = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+      frame.signalSemaphores.clear();
+      abandon(frame);
+    }
+    return nullptr;
+  }
+  _profiler->begin(frame);
+
+  // Uploads recorded since the last frame go out now; this frame takes ownership of everything submitted so far
+  frame.waitSemaphores.clear();
+  frame.waitStages.clear();
+  frame.signalSemaphores.clear();
+  LEIMU_STEP(steps, "frame: uploads");
+  _uploader->flush(_completedFrames);
+  _uploader->acquire(frame.commandBuffer, _frameNumber, frame.waitSemaphores, frame.waitStages);
+  _compute->consume(_frameNumber, _completedFrames, frame.waitSemaphores, frame.waitStages);
+
+  frame.number = _frameNumber;
+  return &frame;
+}
+
+void leimu::feature::Vulkan::endFrame(VkFrame_T &frame) noexcept {
+  LEIMU_STEPS(steps);
+  LEIMU_STEP(steps, "frame: submit");
+  _profiler->end(frame);
+  vkAssert(vkEndCommandBuffer(frame.commandBuffer));
+
+  const auto renderFinished = _headless ? VK_NULL_HANDLE : _renderFinished[frame.imageIndex].get();
+  if (!_headless) {
+    frame.waitSemaphores.push_back(frame.imageAvailable.get());
+    frame.waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    frame.signalSemaphores.push_back(renderFinished);
+  }
+
+  if (_timelines) {
+    // The timeline value replaces the fence
+    const auto value = _timelines->get(render::QueueKind::Graphics)->submit(
+        {
+            .commandBuffers = {frame.commandBuffer},
+            .waitSemaphores = frame.waitSemaphores,
+            .waitStages = frame.waitStages,
+            .waitValues = std::vector<u64>(frame.waitSemaphores.size()),
+            .signalSemaphores = frame.signalSemaphores,
+            .signalValues = std::vector<u64>(frame.signalSemaphores.size()),
+        });
+    if (!value) {
+      std::println(errs(), "[vulkan] [frame] Couldn't submit frame #{}", frame.number);
+      abandon(frame);
+      ++_frameNumber;
+      return;
+    }
+    frame.timeline = value;
+  } else {
+    VkSubmitInfo submitInfo{
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .waitSemaphoreCount = static_cast<u32>(frame.waitSemaphores.size()),
+        .pWaitSemaphores = frame.waitSemaphores.data(),
+        .pWaitDstStageMask = frame.waitStages.data(),
+        .commandBufferCount = 1,
+        .pCommandBuffers = &frame.commandBuffer,
+        .signalSemaphoreCount = static_cast<u32>(frame.signalSemaphores.size()),
+        .pSignalSemaphores = frame.signalSemaphores.data(),
+    };
+    // Reset only right before the submission signaling it; otherwise the next wait would never return
+    const auto fence = frame.inFlight.get();
+    vkAssert(vkResetFences(_device.get(), 1, &fence));
+    if (vkQueueSubmit(_graphicsQueue.get(), 1, &submitInfo, fence) != VK_SUCCESS) {
+      std::println(errs(), "[vulkan] [frame] Couldn't submit frame #{}", frame.number);
+      abandon(frame);
+      ++_frameNumber;
+      return;
+    }
+  }
+
+  if (_headless) {
+    ++_frameNumber;
     return;
   }
 
-  if (((_swapchainViews = CreateImageViews(_device, _swapchainImages, _surfaceInfo))).empty()) {
-    std::println(errs(), "[vulkan] Failed to create swapchain views");
+  LEIMU_STEP(steps, "frame: present");
+  const auto swapchain = _swapchain.get();
+  VkPresentInfoKHR presentInfo{
+      .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+      .waitSemaphoreCount = 1,
+      .pWaitSemaphores = &renderFinished,
+      .swapchainCount = 1,
+      .pSwapchains = &swapchain,
+      .pImageIndices = &frame.imageIndex,
+  };
+  const auto result = _timelines
+                        ? _timelines->get(render::QueueKind::Present)->present(presentInfo)
+                        : vkQueuePresentKHR(_presentQueue.get(), &presentInfo);
+  if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+    _swapchainDirty = true;
+  } else if (result != VK_SUCCESS) {
+    std::println(errs(), "[vulkan] [frame] Couldn't present frame #{} ({})", frame.number, static_cast<i32>(result));
+  }
+
+  ++_frameNumber;
+}
+
+void leimu::feature::Vulkan::abandon(VkFrame_T &frame) noexcept {
+  // Nothing will present the acquired image; a new swapchain gets all images back
+  if (!_headless) {
+    _swapchainDirty = true;
+  }
+
+  // An empty submission consumes the frame's waits and stands in for its signals. Semaphores others wait on,
+  // e.g. those of AsyncCompute::after(), are signaled as if the frame ran; the one for presentation isn't
+  auto signals = frame.signalSemaphores;
+  if (!_headless && frame.imageIndex < _renderFinished.size()) {
+    std::erase(signals, _renderFinished[frame.imageIndex].get());
+  }
+
+  if (_timelines) {
+    if (const auto value = _timelines->get(render::QueueKind::Graphics)->submit(
+        {
+            .waitSemaphores = frame.waitSemaphores,
+            .waitStages = frame.waitStages,
+            .waitValues = std::vector<u64>(frame.waitSemaphores.size()),
+            .signalSemaphores = signals,
+            .signalValues = std::vector<u64>(signals.size()),
+        })) {
+      frame.timeline = value;
+    } else {
+      std::println(errs(), "[vulkan] [frame] Couldn't recover slot of frame #{}", frame.number);
+    }
     return;
   }
+
+  const VkSubmitInfo submitInfo{
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .waitSemaphoreCount = static_cast<u32>(frame.waitSemaphores.size()),
+      .pWaitSemaphores = frame.waitSemaphores.data(),
+      .pWaitDstStageMask = frame.waitStages.data(),
+      .signalSemaphoreCount = static_cast<u32>(signals.size()),
+      .pSignalSemaphores = signals.data(),
+  };
+  const auto fence = frame.inFlight.get();
+  vkAssert(vkResetFences(_device.get(), 1, &fence));
+  if (vkQueueSubmit(_graphicsQueue.get(), 1, &submitInfo, fence) != VK_SUCCESS) {
+    std::println(errs(), "[vulkan] [frame] Couldn't recover slot of frame #{}", frame.number);
+  }
+}
+
+bool leimu::feature::Vulkan::recreateSwapchain() noexcept {
+  LEIMU_ZONE("swapchain: recreate");
+  const auto framebufferSize = _glfw->framebufferSize();
+  if (framebufferSize.width == 0 || framebufferSize.height == 0) {
+    return false;
+  }
+
+  const auto capabilities = GetSurfaceCapabilities(_physicalDevice, _surface);
+  if (!capabilities) {
+    std::println(errs(), "[vulkan] [swapchain] Couldn't query surface capabilities");
+    return false;
+  }
+  _surfaceInfo->capabilities = *capabilities;
+
+  const auto extent = ChooseSwapExtent(_surfaceInfo->capabilities, *_glfw);
+  if (extent.width == 0 || extent.height == 0) {
+    return false;
+  }
+
+  // A swapchain whose images couldn't be set up last time is current still; only its resources are retried
+  const auto partial = _framebuffers.empty() && extent.width == _extent.width && extent.height == _extent.height;
+  if (!partial) {
+    auto swapchain = CreateSwapchain(_device, _surface, _surfaceInfo, extent, _queueIndices, _swapchain);
+    if (!swapchain) {
+      std::println(errs(), "[vulkan] [swapchain] Failed to recreate swapchain");
+      return false;
+    }
+
+    // The old swapchain is retired by its successor's creation, so the new one is adopted whatever follows.
+    // Frames submitted so far may still render into or present the old images;
+    // keep them alive until those frames complete instead of idling the device
+    std::vector<std::shared_ptr<void>> retired{_swapchain};
+    retired.insert(retired.end(), _imageViews.begin(), _imageViews.end());
+    retired.insert(retired.end(), _framebuffers.begin(), _framebuffers.end());
+    retired.insert(retired.end(), _renderFinished.begin(), _renderFinished.end());
+    _deletion->retire(_frameNumber, std::move(retired));
+
+    _swapchain = std::move(swapchain);
+    _images.clear();
+    _imageViews.clear();
+    _framebuffers.clear();
+    _renderFinished.clear();
+    _extent = extent;
+    _framebufferSize = framebufferSize;
+  }
+
+  auto images = GetImages(_device, _swapchain);
+  auto views = CreateImageViews(_device, images, _format);
+  auto framebuffers = CreateFramebuffers(_device, _renderPass, views, _extent);
+  auto renderFinished = CreateSemaphores(_device, images.size());
+  if (images.empty() || views.empty() || framebuffers.empty() || renderFinished.empty()) {
+    // Stays dirty; the next frame retries
+    std::println(errs(), "[vulkan] [swapchain] Failed to rebuild swapchain resources");
+    return false;
+  }
+
+  _images = std::move(images);
+  _imageViews = std::move(views);
+  _framebuffers = std::move(framebuffers);
+  _renderFinished = std::move(renderFinished);
+  _swapchainDirty = false;
+
+  std::println(outs(), "[vulkan] [swapchain] recreated at {}x{}", _extent.width, _extent.height);
+  return true;
 }
 
 bool leimu::feature::Vulkan::operator!() const {
-  return _swapchainViews.empty();
+  return _frames.empty();
 }
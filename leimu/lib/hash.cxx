@@ -0,0 +1,42 @@
+#include "leimu/hash.h"
+
+u64 leimu::Hash(const void *data, const size_t size, const u64 seed) noexcept {
+  constexpr u64 m = 0xc6a4a7935bd1e995ULL;
+  constexpr int r = 47;
+
+  const auto bytes = static_cast<const u8 *>(data);
+  const auto nBlock = size / sizeof(u64);
+
+  u64 h = seed ^ (size * m);
+
+  for (size_t i = 0; i < nBlock; ++i) {
+    u64 k;
+    memcpy(&k, bytes + i * sizeof(u64), sizeof(u64));
+
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+
+    h ^= k;
+    h *= m;
+  }
+
+  const auto tail = bytes + nBlock * sizeof(u64);
+  switch (size & 7) {
+    case 7: h ^= static_cast<u64>(tail[6]) << 48; [[fallthrough]];
+    case 6: h ^= static_cast<u64>(tail[5]) << 40; [[fallthrough]];
+    case 5: h ^= static_cast<u64>(tail[4]) << 32; [[fallthrough]];
+    case 4: h ^= static_cast<u64>(tail[3]) << 24; [[fallthrough]];
+    case 3: h ^= static_cast<u64>(tail[2]) << 16; [[fallthrough]];
+    case 2: h ^= static_cast<u64>(tail[1]) << 8; [[fallthrough]];
+    case 1: h ^= static_cast<u64>(tail[0]);
+      h *= m;
+    default: break;
+  }
+
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+
+  return h;
+}
@@ -0,0 +1,174 @@
+#include "leimu/job/Scheduler.h"
+#include "leimu/App.h"
+#include "leimu/trace.h"
+
+namespace {
+  // 1-based index of the worker running on this thread; 0 elsewhere
+  thread_local u32 ThreadIndex = 0;
+}
+
+leimu::job::Scheduler::Scheduler(const App &app) {
+  auto nWorker = app.config()->jobs().threads;
+  if (!nWorker) {
+    // Leaves one core to the frame thread, which helps whenever it waits anyway
+    nWorker = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+  }
+
+  _deques.reserve(nWorker);
+  for (u32 i = 0; i < nWorker; ++i) {
+    _deques.push_back(std::make_unique<Deque<Job, DequeSize>>());
+  }
+
+  // Deques must all exist before any worker tries to steal
+  _workers.reserve(nWorker);
+  for (u32 i = 0; i < nWorker; ++i) {
+    _workers.emplace_back([this, i](const std::stop_token &token) { work(i + 1, token); });
+  }
+
+  std::println(outs(), "[job] {} worker(s)", nWorker);
+}
+
+leimu::job::Scheduler::~Scheduler() {
+  for (auto &worker: _workers) {
+    worker.request_stop();
+  }
+  _workers.clear();
+}
+
+u32 leimu::job::Scheduler::index() {
+  return ThreadIndex;
+}
+
+void leimu::job::Scheduler::schedule(Job *job, const bool background) {
+  _queued.fetch_add(1);
+
+  if (background || !ThreadIndex || !_deques[ThreadIndex - 1]->push(job)) {
+    std::lock_guard _(_queueLock);
+    (background ? _background : _queue).push_back(job);
+  }
+
+  // Sleepers re-check _queued under _lock, so taking it once is enough to not lose the wakeup
+  if (_sleeping.load()) {
+    std::lock_guard _(_lock);
+  }
+  _signal.notify_one();
+}
+
+void leimu::job::Scheduler::execute(Job *job) {
+  job->fn();
+
+  std::vector<Job *> ready;
+  if (const auto &signal = job->signal; signal && signal->_value.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    std::lock_guard _(signal->_lock);
+    ready.swap(signal->_continuations);
+  }
+  delete job;
+
+  for (const auto next: ready) {
+    schedule(next, false);
+  }
+}
+
+leimu::job::Job *leimu::job::Scheduler::take(const u32 thread, const bool background) {
+  Job *job = nullptr;
+
+  if (thread) {
+    job = _deques[thread - 1]->pop();
+  }
+
+  if (!job) {
+    std::lock_guard _(_queueLock);
+    if (!_queue.empty()) {
+      job = _queue.front();
+      _queue.pop_front();
+    }
+  }
+
+  // Start next to ourselves so that thieves spread over the victims
+  for (size_t i = 0; !job && i < _deques.size(); ++i) {
+    job = _deques[(thread + i) % _deques.size()]->steal();
+  }
+
+  if (!job && background) {
+    std::lock_guard _(_queueLock);
+    if (!_background.empty()) {
+      job = _background.front();
+      _background.pop_front();
+    }
+  }
+
+  if (job) {
+    _queued.fetch_sub(1);
+  }
+  return job;
+}
+
+void leimu::job::Scheduler::work(const u32 thread, const std::stop_token &token) {
+  ThreadIndex = thread;
+  LEIMU_TRACE_THREAD(std::format("job worker #{}", thread));
+
+  while (true) {
+    if (const auto job = take(thread, true)) {
+      execute(job);
+      continue;
+    }
+
+    std::unique_lock lock(_lock);
+    _sleeping.fetch_add(1);
+    // On stop, keeps draining while anything is queued
+    const auto pending = _signal.wait(lock, token, [this] { return _queued.load() > 0; });
+    _sleeping.fetch_sub(1);
+
+    if (!pending) {
+      return;
+    }
+  }
+}
+
+void leimu::job::Scheduler::submit(
+    std::function<void()> fn,
+    const Counter &signal,
+    const Counter &after,
+    const bool background) {
+
+  const auto job = new Job{std::move(fn), signal};
+  if (signal) {
+    signal->_value.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  if (after && !after->done()) {
+    std::lock_guard _(after->_lock);
+    // Re-checked under the lock, which the last job signaling after takes before releasing continuations
+    if (!after->done()) {
+      after->_continuations.push_back(job);
+      return;
+    }
+  }
+
+  schedule(job, background);
+}
+
+void leimu::job::Scheduler::run(std::function<void()> fn, const Counter &signal, const Counter &after) {
+  submit(std::move(fn), signal, after, false);
+}
+
+leimu::job::Counter leimu::job::Scheduler::then(const Counter &after, std::function<void()> fn) {
+  auto signal = std::make_shared<Counter_T>();
+  submit(std::move(fn), signal, after, false);
+  return signal;
+}
+
+void leimu::job::Scheduler::background(std::function<void()> fn, const Counter &signal) {
+  submit(std::move(fn), signal, nullptr, true);
+}
+
+void leimu::job::Scheduler::wait(const Counter &counter) {
+  const auto thread = ThreadIndex;
+  while (!counter->done()) {
+    if (const auto job = take(thread, false)) {
+      execute(job);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
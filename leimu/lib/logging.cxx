@@ -4,20 +4,267 @@
 
 #ifndef LOG_NO_COLOR
 #define RED "\x1b[31m"
+#define YLW "\x1b[33m"
 #define RST "\x1b[0m"
 #else
 #define RED
+#define YLW
 #define RST
 #endif
 
-std::ostream &leimu::outs() {
-  std::cout << "[II] " << std::flush;
+namespace {
+  struct Message {
+    u64 sequence;
+    leimu::LogLevel level;
+    std::string text;
+  };
 
-  return std::cout;
+  /**
+   * Single-producer (owning thread), single-consumer (writer) queue of messages.
+   */
+  struct Ring {
+    static constexpr u64 Capacity = 1024;
+
+    std::array<Message, Capacity> messages;
+    alignas(64) std::atomic<u64> head = 0;
+    alignas(64) std::atomic<u64> tail = 0;
+  };
+
+  class Logger {
+    std::mutex _lock;
+    std::vector<std::shared_ptr<Ring>> _rings;
+
+    std::atomic<u64> _sequence = 0;
+    // every sequence number below it has been written
+    std::atomic<u64> _written = 0;
+    std::atomic<u64> _dropped = 0;
+    std::atomic<bool> _signal = false;
+    std::atomic<bool> _running = false;
+    std::thread _writer;
+    // drained, but waiting for messages with lower sequence numbers which aren't published yet; writer thread only
+    std::vector<Message> _pending;
+
+    // serializes writes once the writer is gone
+    std::mutex _syncLock;
+
+    static void write(const Message &message) {
+      switch (message.level) {
+        case leimu::LogLevel::Debug:
+          std::cout << "[DD] " << message.text;
+          break;
+        case leimu::LogLevel::Info:
+          std::cout << "[II] " << message.text;
+          break;
+        case leimu::LogLevel::Warning:
+          std::cerr << YLW "[WW] " RST << message.text;
+          break;
+        default:
+          std::cerr << RED "[EE] " RST << message.text;
+          break;
+      }
+    }
+
+    // Writer thread only; last writes out what is left even if earlier sequence numbers never showed up
+    void drain(const bool last = false) {
+      {
+        std::lock_guard _(_lock);
+        for (const auto &ring: _rings) {
+          const auto tail = ring->tail.load(std::memory_order_relaxed);
+          const auto head = ring->head.load(std::memory_order_acquire);
+          for (auto i = tail; i < head; ++i) {
+            _pending.push_back(std::move(ring->messages[i % Ring::Capacity]));
+          }
+          ring->tail.store(head, std::memory_order_release);
+        }
+      }
+
+      // Restores the order messages were logged in across threads. A producer may have taken a sequence number
+      // without having published the message yet; everything after such a gap waits for the next drain
+      std::ranges::sort(_pending, {}, &Message::sequence);
+      auto next = _written.load(std::memory_order_relaxed);
+      size_t nWritten = 0;
+      for (; nWritten < _pending.size() && (last || _pending[nWritten].sequence == next); ++nWritten) {
+        write(_pending[nWritten]);
+        next = _pending[nWritten].sequence + 1;
+      }
+      _pending.erase(_pending.begin(), _pending.begin() + static_cast<std::ptrdiff_t>(nWritten));
+
+      if (const auto dropped = _dropped.exchange(0, std::memory_order_relaxed)) {
+        std::cerr << RED "[EE] " RST << std::format("[log] {} message(s) dropped; queue full\n", dropped);
+      }
+
+      if (nWritten) {
+        std::cout.flush();
+        std::cerr.flush();
+      }
+
+      if (last) {
+        next = std::max(next, _sequence.load(std::memory_order_acquire));
+      }
+      _written.store(next, std::memory_order_release);
+      _written.notify_all();
+    }
+
+    void work() {
+      while (_running.load(std::memory_order_acquire)) {
+        _signal.wait(false, std::memory_order_acquire);
+        _signal.store(false, std::memory_order_relaxed);
+        drain();
+      }
+      drain(true);
+    }
+
+  public:
+    Logger() {
+      _running = true;
+      _writer = std::thread([this] { work(); });
+    }
+
+    void stop() {
+      if (!_running.exchange(false)) {
+        return;
+      }
+
+      _signal.store(true, std::memory_order_release);
+      _signal.notify_one();
+      _writer.join();
+    }
+
+    std::shared_ptr<Ring> registerThread() {
+      auto ring = std::make_shared<Ring>();
+      std::lock_guard _(_lock);
+      _rings.push_back(ring);
+      return ring;
+    }
+
+    void push(Ring &ring, const leimu::LogLevel level, std::string text) {
+      if (!_running.load(std::memory_order_acquire)) {
+        std::lock_guard _(_syncLock);
+        write({0, level, std::move(text)});
+        (level >= leimu::LogLevel::Warning ? std::cerr : std::cout).flush();
+        return;
+      }
+
+      // Dropped before taking a sequence number; the writer would wait for it forever otherwise.
+      // Only this thread fills the ring, so the space can't shrink in between
+      const auto head = ring.head.load(std::memory_order_relaxed);
+      if (head - ring.tail.load(std::memory_order_acquire) >= Ring::Capacity) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+
+      const auto sequence = _sequence.fetch_add(1, std::memory_order_acq_rel);
+      ring.messages[head % Ring::Capacity] = {sequence, level, std::move(text)};
+      ring.head.store(head + 1, std::memory_order_release);
+
+      // Never blocks; wakes the writer only if it's asleep
+      if (!_signal.exchange(true, std::memory_order_acq_rel)) {
+        _signal.notify_one();
+      }
+    }
+
+    void flush() {
+      if (!_running.load(std::memory_order_acquire)) {
+        return;
+      }
+
+      const auto target = _sequence.load(std::memory_order_acquire);
+      _signal.store(true, std::memory_order_release);
+      _signal.notify_one();
+
+      for (auto written = _written.load(std::memory_order_acquire); written < target;
+           written = _written.load(std::memory_order_acquire)) {
+        _written.wait(written, std::memory_order_acquire);
+      }
+    }
+  };
+
+  // Leaked; threads may log while static destructors run, and they fall back to synchronous writes then
+  Logger &GetLogger() {
+    static auto logger = new Logger;
+    return *logger;
+  }
+
+  // Writes out what is queued when the program exits
+  const struct LoggerShutdown {
+    LoggerShutdown() { (void) GetLogger(); }
+    ~LoggerShutdown() { GetLogger().stop(); }
+  } Shutdown;
+
+  // Debug messages (e.g. verbose validation output) are opt-in at runtime
+  std::atomic<leimu::LogLevel> RuntimeLevel{std::max(leimu::LogLevel::Info, leimu::CompiledLogLevel)};
+
+  class LogBuffer final : public std::streambuf {
+    std::shared_ptr<Ring> _ring;
+    leimu::LogLevel _level;
+    std::string _text;
+
+    void commit() {
+      GetLogger().push(*_ring, _level, std::move(_text));
+      _text.clear();
+    }
+
+  protected:
+    int_type overflow(const int_type c) override {
+      if (c != traits_type::eof()) {
+        _text.push_back(traits_type::to_char_type(c));
+        if (c == '\n') {
+          commit();
+        }
+      }
+      return c;
+    }
+
+    std::streamsize xsputn(const char *s, const std::streamsize n) override {
+      _text.append(s, n);
+      // std::println writes a whole message, newline included, at once
+      if (n && s[n - 1] == '\n') {
+        commit();
+      }
+      return n;
+    }
+
+  public:
+    LogBuffer(std::shared_ptr<Ring> ring, const leimu::LogLevel level) : _ring(std::move(ring)), _level(level) {}
+  };
+
+  struct ThreadStreams {
+    std::shared_ptr<Ring> ring = GetLogger().registerThread();
+    std::array<std::unique_ptr<LogBuffer>, 4> buffers;
+    std::array<std::unique_ptr<std::ostream>, 4> streams;
+
+    ThreadStreams() {
+      for (u8 i = 0; i < streams.size(); ++i) {
+        buffers[i] = std::make_unique<LogBuffer>(ring, static_cast<leimu::LogLevel>(i));
+        streams[i] = std::make_unique<std::ostream>(buffers[i].get());
+      }
+    }
+  };
+}
+
+std::ostream &leimu::nulls() {
+  // No buffer: badbit is set and std::print skips formatting altogether
+  thread_local std::ostream stream(nullptr);
+  return stream;
+}
+
+std::ostream &leimu::logs(const LogLevel level) {
+  if (level >= LogLevel::None || level < RuntimeLevel.load(std::memory_order_relaxed)) {
+    return nulls();
+  }
+
+  thread_local ThreadStreams streams;
+  return *streams.streams[static_cast<u8>(level)];
 }
 
-std::ostream &leimu::errs() {
-  std::cerr << RED "[EE] " RST << std::flush;
+void leimu::SetLogLevel(const LogLevel level) {
+  RuntimeLevel.store(std::max(level, CompiledLogLevel), std::memory_order_relaxed);
+}
+
+leimu::LogLevel leimu::GetLogLevel() {
+  return RuntimeLevel.load(std::memory_order_relaxed);
+}
 
-  return std::cerr;
+void leimu::FlushLogs() {
+  GetLogger().flush();
 }
@@ -0,0 +1,503 @@
+#include "leimu/memory/Allocator.h"
+
+// smallest buddy node; keeps free lists short for tiny buffers
+constexpr u32 MinOrder = 8;
+constexpr VkDeviceSize MaxBlockSize = 64ull << 20;
+constexpr VkDeviceSize MinBlockSize = 1ull << 20;
+constexpr VkDeviceSize LinearBlockSize = 4ull << 20;
+
+static u32 OrderOf(const VkDeviceSize size) {
+  return std::max(static_cast<u32>(std::bit_width(size - 1)), MinOrder);
+}
+
+static std::optional<VkDeviceSize> BuddyAllocate(leimu::memory::MemoryBlock_T &block, const u32 order) {
+  auto k = order;
+  while (k <= block.maxOrder && block.free[k].empty()) {
+    ++k;
+  }
+  if (k > block.maxOrder) {
+    return std::nullopt;
+  }
+
+  const auto offset = *block.free[k].begin();
+  block.free[k].erase(block.free[k].begin());
+
+  // Split until the node fits; upper halves become free buddies
+  while (k > order) {
+    --k;
+    block.free[k].insert(offset + (1ull << k));
+  }
+
+  block.used += 1ull << order;
+  return offset;
+}
+
+static void BuddyFree(leimu::memory::MemoryBlock_T &block, VkDeviceSize offset, u32 order) {
+  block.used -= 1ull << order;
+
+  while (order < block.maxOrder) {
+    const auto buddy = offset ^ (1ull << order);
+    const auto it = block.free[order].find(buddy);
+    if (it == block.free[order].end()) {
+      break;
+    }
+
+    block.free[order].erase(it);
+    offset = std::min(offset, buddy);
+    ++order;
+  }
+
+  block.free[order].insert(offset);
+}
+
+leimu::memory::Allocator::Allocator(
+    const feature::VulkanPhysicalDevice &phy,
+    feature::VulkanDevice device,
+    const u32 framesInFlight) noexcept
+  : _device(std::move(device)),
+    _linear(std::max(framesInFlight, 1u)) {
+
+  vkGetPhysicalDeviceMemoryProperties(phy.get(), &_properties);
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(phy.get(), &properties);
+  _granularity = properties.limits.bufferImageGranularity;
+  _maxAllocationCount = properties.limits.maxMemoryAllocationCount;
+
+  // Small heaps (integrated or software devices) get smaller blocks so that a few of them still fit
+  VkDeviceSize smallestHeap = MaxBlockSize * 8;
+  for (u32 i = 0; i < _properties.memoryHeapCount; ++i) {
+    smallestHeap = std::min(smallestHeap, _properties.memoryHeaps[i].size);
+  }
+  _blockSize = std::clamp(std::bit_floor(smallestHeap / 8), MinBlockSize, MaxBlockSize);
+  _linearBlockSize = std::min(LinearBlockSize, _blockSize);
+
+  std::println(
+      outs(),
+      "[memory] block {} KiB, linear {} KiB, granularity {}",
+      _blockSize >> 10,
+      _linearBlockSize >> 10,
+      _granularity);
+}
+
+leimu::memory::Allocator::~Allocator() {
+  for (auto &[_, pool]: _pools) {
+    for (const auto &block: pool.blocks) {
+      freeMemory(block->memory, block->mapped);
+    }
+  }
+
+  for (auto &slot: _linear) {
+    for (auto &[_, blocks]: slot) {
+      for (const auto &block: blocks) {
+        freeMemory(block.memory, block.mapped);
+      }
+    }
+  }
+}
+
+u32 leimu::memory::Allocator::findMemoryType(
+    const u32 typeBits,
+    const VkMemoryPropertyFlags required,
+    const VkMemoryPropertyFlags preferred) const noexcept {
+
+  for (const auto flags: {required | preferred, required}) {
+    for (u32 i = 0; i < _properties.memoryTypeCount; ++i) {
+      if (typeBits & (1u << i) && (_properties.memoryTypes[i].propertyFlags & flags) == flags) {
+        return i;
+      }
+    }
+  }
+
+  return -1;
+}
+
+VkDeviceMemory leimu::memory::Allocator::allocateMemory(
+    const VkDeviceSize size,
+    const u32 type,
+    void **mapped) noexcept {
+
+  if (_allocationCount >= _maxAllocationCount) {
+    std::println(errs(), "[memory] maxMemoryAllocationCount ({}) reached", _maxAllocationCount);
+    return VK_NULL_HANDLE;
+  }
+
+  VkMemoryAllocateInfo allocInfo{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+      .allocationSize = size,
+      .memoryTypeIndex = type,
+  };
+
+  VkDeviceMemory memory;
+  if (vkAllocateMemory(_device.get(), &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+    std::println(errs(), "[memory] Couldn't allocate {} KiB of memory type {}", size >> 10, type);
+    return VK_NULL_HANDLE;
+  }
+  ++_allocationCount;
+
+  // Host-visible memory stays mapped for its whole lifetime
+  *mapped = nullptr;
+  if (_properties.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT &&
+      vkMapMemory(_device.get(), memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+    std::println(errs(), "[memory] Couldn't map memory type {}", type);
+    *mapped = nullptr;
+  }
+
+  return memory;
+}
+
+void leimu::memory::Allocator::freeMemory(const VkDeviceMemory memory, const bool mapped) noexcept {
+  if (mapped) {
+    vkUnmapMemory(_device.get(), memory);
+  }
+  vkFreeMemory(_device.get(), memory, nullptr);
+  --_allocationCount;
+}
+
+leimu::memory::MemoryBlock_T *leimu::memory::Allocator::createBlock(const u32 type) noexcept {
+  void *mapped;
+  const auto memory = allocateMemory(_blockSize, type, &mapped);
+  if (!memory) {
+    return nullptr;
+  }
+
+  const auto maxOrder = static_cast<u32>(std::countr_zero(_blockSize));
+
+  auto block = new MemoryBlock_T{
+      .memory = memory,
+      .size = _blockSize,
+      .mapped = mapped,
+      .type = type,
+      .maxOrder = maxOrder,
+      .free = std::vector<std::set<VkDeviceSize>>(maxOrder + 1),
+  };
+  block->free[maxOrder].insert(0);
+  return block;
+}
+
+leimu::memory::Allocation leimu::memory::Allocator::allocate(
+    const VkMemoryRequirements &requirements,
+    const VkMemoryPropertyFlags required,
+    const VkMemoryPropertyFlags preferred,
+    const ResourceKind kind) noexcept {
+
+  const auto type = findMemoryType(requirements.memoryTypeBits, required, preferred);
+  if (type == -1) {
+    std::println(errs(), "[memory] There is no memory type with properties {:#x}", required);
+    return nullptr;
+  }
+
+  // Buddy nodes are naturally aligned to their size, which covers any power-of-two alignment
+  const auto order = OrderOf(std::max(requirements.size, requirements.alignment));
+
+  auto allocation = std::make_unique<Allocation_T>();
+  allocation->_size = requirements.size;
+  allocation->_type = type;
+
+  std::lock_guard _(_lock);
+
+  if ((1ull << order) > _blockSize / 2) {
+    void *mapped;
+    if (!((allocation->_memory = allocateMemory(requirements.size, type, &mapped)))) {
+      return nullptr;
+    }
+    allocation->_mapped = mapped;
+    allocation->_dedicated = true;
+    ++_dedicatedCount;
+  } else {
+    auto &pool = _pools[{type, _granularity > 1 ? kind : ResourceKind::Linear}];
+
+    MemoryBlock_T *block = nullptr;
+    std::optional<VkDeviceSize> offset;
+    for (const auto &candidate: pool.blocks) {
+      if ((offset = BuddyAllocate(*candidate, order))) {
+        block = candidate.get();
+        break;
+      }
+    }
+
+    if (!block) {
+      if (!((block = createBlock(type)))) {
+        return nullptr;
+      }
+      pool.blocks.emplace_back(block);
+      offset = BuddyAllocate(*block, order);
+    }
+
+    allocation->_memory = block->memory;
+    allocation->_offset = *offset;
+    allocation->_mapped = block->mapped ? static_cast<u8 *>(block->mapped) + *offset : nullptr;
+    allocation->_block = block;
+    allocation->_order = order;
+    block->live[*offset] = allocation.get();
+  }
+
+  return {
+      allocation.release(), [self = shared_from_this()](const Allocation_T *allocation) {
+        self->release(*allocation);
+        delete allocation;
+      }
+  };
+}
+
+void leimu::memory::Allocator::release(const Allocation_T &allocation) noexcept {
+  std::lock_guard _(_lock);
+
+  if (allocation._dedicated) {
+    freeMemory(allocation._memory, allocation._mapped);
+    --_dedicatedCount;
+    return;
+  }
+
+  const auto block = allocation._block;
+  if (!block) {
+    return;
+  }
+
+  block->live.erase(allocation._offset);
+  BuddyFree(*block, allocation._offset, allocation._order);
+
+  // Empty blocks are returned to the driver, but each pool keeps one to avoid thrashing
+  if (block->used == 0) {
+    for (auto &[key, pool]: _pools) {
+      if (key.first != block->type || pool.blocks.size() <= 1) {
+        continue;
+      }
+
+      if (const auto it = std::ranges::find_if(pool.blocks, [=](const auto &b) { return b.get() == block; });
+        it != pool.blocks.end()) {
+        freeMemory(block->memory, block->mapped);
+        pool.blocks.erase(it);
+        break;
+      }
+    }
+  }
+}
+
+leimu::memory::Allocation leimu::memory::Allocator::allocateLinear(
+    const u32 slot,
+    const VkMemoryRequirements &requirements,
+    const VkMemoryPropertyFlags required,
+    const VkMemoryPropertyFlags preferred) noexcept {
+
+  const auto type = findMemoryType(requirements.memoryTypeBits, required, preferred);
+  if (type == -1) {
+    std::println(errs(), "[memory] There is no memory type with properties {:#x}", required);
+    return nullptr;
+  }
+
+  if (requirements.size > _linearBlockSize) {
+    std::println(errs(), "[memory] {} bytes exceed the per-frame block size", requirements.size);
+    return nullptr;
+  }
+
+  std::lock_guard _(_lock);
+
+  auto &blocks = _linear[slot % _linear.size()][type];
+
+  LinearBlock *target = nullptr;
+  VkDeviceSize offset = 0;
+  for (auto &block: blocks) {
+    offset = (block.head + requirements.alignment - 1) / requirements.alignment * requirements.alignment;
+    if (offset + requirements.size <= block.size) {
+      target = &block;
+      break;
+    }
+  }
+
+  if (!target) {
+    void *mapped;
+    const auto memory = allocateMemory(_linearBlockSize, type, &mapped);
+    if (!memory) {
+      return nullptr;
+    }
+
+    target = &blocks.emplace_back(memory, _linearBlockSize, 0, mapped);
+    offset = 0;
+  }
+
+  target->head = offset + requirements.size;
+
+  const auto allocation = std::make_shared<Allocation_T>();
+  allocation->_memory = target->memory;
+  allocation->_offset = offset;
+  allocation->_size = requirements.size;
+  allocation->_type = type;
+  allocation->_mapped = target->mapped ? static_cast<u8 *>(target->mapped) + offset : nullptr;
+  return allocation;
+}
+
+void leimu::memory::Allocator::resetLinear(const u32 slot) noexcept {
+  std::lock_guard _(_lock);
+
+  for (auto &[_, blocks]: _linear[slot % _linear.size()]) {
+    for (auto &block: blocks) {
+      block.head = 0;
+    }
+  }
+}
+
+leimu::memory::Buffer leimu::memory::Allocator::createBuffer(
+    const VkBufferCreateInfo &createInfo,
+    const VkMemoryPropertyFlags required,
+    const VkMemoryPropertyFlags preferred) noexcept {
+
+  VkBuffer buffer;
+  if (vkCreateBuffer(_device.get(), &createInfo, nullptr, &buffer) != VK_SUCCESS) {
+    std::println(errs(), "[memory] Couldn't create buffer of {} bytes", createInfo.size);
+    return nullptr;
+  }
+
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(_device.get(), buffer, &requirements);
+
+  auto allocation = allocate(requirements, required, preferred, ResourceKind::Linear);
+  if (!allocation ||
+      vkBindBufferMemory(_device.get(), buffer, allocation->memory(), allocation->offset()) != VK_SUCCESS) {
+    std::println(errs(), "[memory] Couldn't back buffer of {} bytes", createInfo.size);
+    vkDestroyBuffer(_device.get(), buffer, nullptr);
+    return nullptr;
+  }
+
+  return {
+      new Buffer_T{buffer, createInfo.size, std::move(allocation)},
+      [device = _device](const Buffer_T *self) {
+        vkDestroyBuffer(device.get(), self->handle, nullptr);
+        delete self;
+      }
+  };
+}
+
+leimu::memory::Image leimu::memory::Allocator::createImage(
+    const VkImageCreateInfo &createInfo,
+    const VkMemoryPropertyFlags required,
+    const VkMemoryPropertyFlags preferred) noexcept {
+
+  VkImage image;
+  if (vkCreateImage(_device.get(), &createInfo, nullptr, &image) != VK_SUCCESS) {
+    std::println(errs(), "[memory] Couldn't create image");
+    return nullptr;
+  }
+
+  VkMemoryRequirements requirements;
+  vkGetImageMemoryRequirements(_device.get(), image, &requirements);
+
+  const auto kind = createInfo.tiling == VK_IMAGE_TILING_LINEAR ? ResourceKind::Linear : ResourceKind::Optimal;
+  auto allocation = allocate(requirements, required, preferred, kind);
+  if (!allocation ||
+      vkBindImageMemory(_device.get(), image, allocation->memory(), allocation->offset()) != VK_SUCCESS) {
+    std::println(errs(), "[memory] Couldn't back image");
+    vkDestroyImage(_device.get(), image, nullptr);
+    return nullptr;
+  }
+
+  return {
+      new Image_T{
+          image,
+          createInfo.format,
+          createInfo.extent,
+          createInfo.mipLevels,
+          createInfo.arrayLayers,
+          std::move(allocation),
+      },
+      [device = _device](const Image_T *self) {
+        vkDestroyImage(device.get(), self->handle, nullptr);
+        delete self;
+      }
+  };
+}
+
+u32 leimu::memory::Allocator::defragment(const DefragmentCallback &move, const f32 threshold) noexcept {
+  std::lock_guard _(_lock);
+
+  u32 moved = 0;
+  for (auto &[_, pool]: _pools) {
+    if (pool.blocks.size() <= 1) {
+      continue;
+    }
+
+    // Densest blocks first, so sparse ones drain into them
+    std::ranges::sort(pool.blocks, std::greater{}, [](const auto &block) { return block->used; });
+
+    for (auto src = pool.blocks.rbegin(); src != pool.blocks.rend(); ++src) {
+      auto &source = **src;
+      if (static_cast<f32>(source.used) >= static_cast<f32>(source.size) * threshold) {
+        break;
+      }
+
+      for (const auto live = source.live; const auto &[offset, allocation]: live) {
+        for (auto dst = pool.blocks.begin(); dst != src.base() - 1; ++dst) {
+          auto &target = **dst;
+          const auto dstOffset = BuddyAllocate(target, allocation->_order);
+          if (!dstOffset) {
+            continue;
+          }
+
+          Allocation_T to;
+          to._memory = target.memory;
+          to._offset = *dstOffset;
+          to._size = allocation->_size;
+          to._type = allocation->_type;
+          to._mapped = target.mapped ? static_cast<u8 *>(target.mapped) + *dstOffset : nullptr;
+          to._block = &target;
+          to._order = allocation->_order;
+
+          if (!move(*allocation, to)) {
+            BuddyFree(target, *dstOffset, allocation->_order);
+            break;
+          }
+
+          source.live.erase(offset);
+          BuddyFree(source, offset, allocation->_order);
+
+          *allocation = to;
+          target.live[*dstOffset] = allocation;
+          ++moved;
+          break;
+        }
+      }
+    }
+
+    for (auto it = pool.blocks.begin(); it != pool.blocks.end() && pool.blocks.size() > 1;) {
+      if ((*it)->used != 0) {
+        ++it;
+        continue;
+      }
+
+      freeMemory((*it)->memory, (*it)->mapped);
+      it = pool.blocks.erase(it);
+    }
+  }
+
+  if (moved) {
+    std::println(outs(), "[memory] [defragment] moved {} allocation(s)", moved);
+  }
+  return moved;
+}
+
+leimu::memory::AllocatorStatistics leimu::memory::Allocator::statistics() const noexcept {
+  std::lock_guard _(_lock);
+
+  AllocatorStatistics statistics{
+      .blocks = 0,
+      .dedicated = _dedicatedCount,
+      .reserved = 0,
+      .used = 0,
+  };
+  for (const auto &[_, pool]: _pools) {
+    for (const auto &block: pool.blocks) {
+      ++statistics.blocks;
+      statistics.reserved += block->size;
+      statistics.used += block->used;
+    }
+  }
+
+  return statistics;
+}
+
+std::shared_ptr<leimu::memory::Allocator> leimu::memory::CreateAllocator(
+    const feature::VulkanPhysicalDevice &phy,
+    const feature::VulkanDevice &device,
+    const u32 framesInFlight) noexcept {
+  return std::make_shared<Allocator>(phy, device, framesInFlight);
+}
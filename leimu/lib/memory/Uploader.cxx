@@ -0,0 +1,534 @@
+#include "leimu/memory/Uploader.h"
+
+// satisfies the offset rules of buffer copies and of every uncompressed or block-compressed texel size
+constexpr VkDeviceSize StagingAlignment = 16;
+
+namespace {
+  // Ring counter at which size bytes go after head; a single copy never wraps around the end of the ring
+  VkDeviceSize Place(const VkDeviceSize head, const VkDeviceSize size, const VkDeviceSize capacity) {
+    auto offset = (head + StagingAlignment - 1) / StagingAlignment * StagingAlignment;
+    if (const auto physical = offset % capacity; physical + size > capacity) {
+      offset += capacity - physical;
+    }
+    return offset;
+  }
+}
+
+leimu::memory::Uploader::Uploader(
+    feature::VulkanDevice device,
+    const std::shared_ptr<Allocator> &allocator,
+    const feature::VulkanQueueFamilyIndices &families,
+    feature::VulkanQueue transferQueue,
+    render::Timeline timeline,
+    const VkDeviceSize capacity) noexcept
+  : _device(std::move(device)),
+    _queue(std::move(transferQueue)),
+    _timeline(std::move(timeline)),
+    _transferFamily(families->transferQueue),
+    _graphicsFamily(families->graphicsQueue),
+    _mapped(nullptr),
+    _capacity(capacity) {
+
+  VkBufferCreateInfo createInfo{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = capacity,
+      .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+  };
+
+  _ring = allocator->createBuffer(
+      createInfo,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  if (!_ring || !_ring->allocation->mapped()) {
+    std::println(errs(), "[upload] Couldn't create staging ring of {} KiB", capacity >> 10);
+    _ring = nullptr;
+    return;
+  }
+  _mapped = static_cast<u8 *>(_ring->allocation->mapped());
+
+  std::println(
+      outs(),
+      "[upload] staging ring {} KiB{}",
+      capacity >> 10,
+      ownershipTransfer() ? " on dedicated transfer queue" : "");
+}
+
+leimu::memory::Uploader::Batch *leimu::memory::Uploader::recording() noexcept {
+  if (_recording) {
+    return _recording.get();
+  }
+
+  if (!_free.empty()) {
+    _recording = std::move(_free.back());
+    _free.pop_back();
+  } else {
+    auto batch = std::make_unique<Batch>();
+    if (!((batch->pool = feature::CreateCommandPool(_device, _transferFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT)))) {
+      return nullptr;
+    }
+
+    VkCommandBufferAllocateInfo allocInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = batch->pool.get(),
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    if (vkAllocateCommandBuffers(_device.get(), &allocInfo, &batch->commandBuffer) != VK_SUCCESS) {
+      std::println(errs(), "[upload] Couldn't allocate command buffer");
+      return nullptr;
+    }
+
+    if ((!_timeline && !((batch->fence = feature::CreateFence(_device, false)))) ||
+        !((batch->semaphore = feature::CreateSemaphore(_device)))) {
+      return nullptr;
+    }
+
+    _recording = std::move(batch);
+  }
+
+  vkResetCommandPool(_device.get(), _recording->pool.get(), 0);
+
+  VkCommandBufferBeginInfo beginInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+  };
+  if (vkBeginCommandBuffer(_recording->commandBuffer, &beginInfo) != VK_SUCCESS) {
+    std::println(errs(), "[upload] Couldn't begin command buffer");
+    _recording = nullptr;
+    return nullptr;
+  }
+
+  return _recording.get();
+}
+
+void leimu::memory::Uploader::reclaim() noexcept {
+  for (const auto &batch: _inFlight) {
+    if (batch->end <= _tail) {
+      continue;
+    }
+    if (!done(*batch)) {
+      break;
+    }
+    _tail = batch->end;
+  }
+}
+
+bool leimu::memory::Uploader::done(const Batch &batch) const noexcept {
+  if (_timeline) {
+    return _timeline->completed(batch.value);
+  }
+  return vkGetFenceStatus(_device.get(), batch.fence.get()) == VK_SUCCESS;
+}
+
+void leimu::memory::Uploader::wait(const Batch &batch) const noexcept {
+  if (_timeline) {
+    _timeline->wait(batch.value);
+    return;
+  }
+  const auto fence = batch.fence.get();
+  vkWaitForFences(_device.get(), 1, &fence, VK_TRUE, UINT64_MAX);
+}
+
+std::optional<VkDeviceSize> leimu::memory::Uploader::reserve(
+    std::unique_lock<std::mutex> &lock,
+    const VkDeviceSize size) noexcept {
+
+  if (size > _capacity) {
+    return std::nullopt;
+  }
+
+  while (true) {
+    reclaim();
+
+    if (const auto offset = Place(_head, size, _capacity); offset + size - _tail <= _capacity) {
+      _head = offset + size;
+      return offset % _capacity;
+    }
+
+    // Wait for the oldest copy still holding ring space; only the unsubmitted batch is left otherwise
+    const auto it = std::ranges::find_if(_inFlight, [this](const auto &batch) { return batch->end > _tail; });
+    if (it == _inFlight.end()) {
+      return std::nullopt;
+    }
+
+    // Pinned, so that flush() can't recycle the batch while it's waited on; the ring is checked anew afterward
+    const auto batch = it->get();
+    ++batch->waiters;
+    lock.unlock();
+    wait(*batch);
+    lock.lock();
+    --batch->waiters;
+  }
+}
+
+bool leimu::memory::Uploader::fits(const VkDeviceSize size, const VkDeviceSize chunkSize) const noexcept {
+  // Best case: everything submitted is done. Space of the recording batch is held until the next flush()
+  const auto tail = _inFlight.empty() ? _tail : std::max(_tail, _inFlight.back()->end);
+  auto head = _head;
+  for (VkDeviceSize done = 0; done < size;) {
+    const auto chunk = std::min(size - done, chunkSize);
+    const auto offset = Place(head, chunk, _capacity);
+    if (offset + chunk - tail > _capacity) {
+      return false;
+    }
+    head = offset + chunk;
+    done += chunk;
+  }
+  return true;
+}
+
+void leimu::memory::Uploader::recycle(Batch &batch) noexcept {
+  if (batch.fence) {
+    const auto fence = batch.fence.get();
+    vkResetFences(_device.get(), 1, &fence);
+  }
+  batch.bufferReleases.clear();
+  batch.imageReleases.clear();
+  batch.bufferAcquires.clear();
+  batch.imageAcquires.clear();
+  batch.resources.clear();
+  batch.acquired.clear();
+  batch.acquiredBy = UINT64_MAX;
+  batch.empty = true;
+}
+
+bool leimu::memory::Uploader::upload(
+    const Buffer &dst,
+    const VkDeviceSize dstOffset,
+    const void *data,
+    const VkDeviceSize size) noexcept {
+
+  std::unique_lock lock(_lock);
+
+  // Chunked, so that waiting for copies in flight frees ring space piecewise; what's recorded but not
+  // submitted stays held, so the upload has to fit beside it
+  const auto chunkSize = std::max(_capacity / 4, StagingAlignment);
+  if (!fits(size, chunkSize)) {
+    std::println(errs(), "[upload] Staging ring can't hold buffer upload of {} bytes before the next flush", size);
+    return false;
+  }
+
+  for (VkDeviceSize done = 0; done < size;) {
+    const auto chunk = std::min(size - done, chunkSize);
+
+    const auto offset = reserve(lock, chunk);
+    const auto batch = offset ? recording() : nullptr;
+    if (!batch) {
+      std::println(errs(), "[upload] Staging ring is full; {} of {} bytes uploaded", done, size);
+      return false;
+    }
+
+    memcpy(_mapped + *offset, static_cast<const u8 *>(data) + done, chunk);
+
+    VkBufferCopy region{
+        .srcOffset = *offset,
+        .dstOffset = dstOffset + done,
+        .size = chunk,
+    };
+    vkCmdCopyBuffer(batch->commandBuffer, _ring->handle, dst->handle, 1, &region);
+    batch->empty = false;
+    // Released chunk by chunk: other uploads may take ring space during a wait and fail a later chunk,
+    // or a flush may run meanwhile and submit earlier chunks in another batch
+    release(batch, dst, dstOffset + done, chunk);
+
+    done += chunk;
+  }
+
+  return true;
+}
+
+bool leimu::memory::Uploader::copy(
+    const Buffer &src,
+    const VkDeviceSize srcOffset,
+    const Buffer &dst,
+    const VkDeviceSize dstOffset,
+    const VkDeviceSize size) noexcept {
+
+  std::lock_guard _(_lock);
+
+  const auto batch = recording();
+  if (!batch) {
+    return false;
+  }
+
+  const VkBufferCopy region{
+      .srcOffset = srcOffset,
+      .dstOffset = dstOffset,
+      .size = size,
+  };
+  vkCmdCopyBuffer(batch->commandBuffer, src->handle, dst->handle, 1, &region);
+  batch->empty = false;
+
+  release(batch, dst, dstOffset, size);
+  batch->resources.push_back(src);
+  return true;
+}
+
+bool leimu::memory::Uploader::upload(
+    const Image &dst,
+    const void *data,
+    const VkDeviceSize size,
+    const std::span<const VkBufferImageCopy> regions,
+    const VkImageLayout finalLayout,
+    std::function<void(VkCommandBuffer)> onAcquire) noexcept {
+
+  std::unique_lock lock(_lock);
+
+  const auto offset = reserve(lock, size);
+  const auto batch = offset ? recording() : nullptr;
+  if (!batch) {
+    std::println(errs(), "[upload] Staging ring can't hold image of {} bytes", size);
+    return false;
+  }
+
+  memcpy(_mapped + *offset, data, size);
+
+  record(batch, _ring->handle, *offset, dst, regions, finalLayout, std::move(onAcquire));
+  return true;
+}
+
+bool leimu::memory::Uploader::copy(
+    const Buffer &src,
+    const Image &dst,
+    const std::span<const VkBufferImageCopy> regions,
+    const VkImageLayout finalLayout,
+    std::function<void(VkCommandBuffer)> onAcquire) noexcept {
+
+  std::lock_guard _(_lock);
+
+  const auto batch = recording();
+  if (!batch) {
+    return false;
+  }
+
+  record(batch, src->handle, 0, dst, regions, finalLayout, std::move(onAcquire));
+  batch->resources.push_back(src);
+  return true;
+}
+
+void leimu::memory::Uploader::release(
+    Batch *batch,
+    const Buffer &dst,
+    const VkDeviceSize offset,
+    const VkDeviceSize size) noexcept {
+
+  if (ownershipTransfer()) {
+    VkBufferMemoryBarrier barrier{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = 0,
+        .srcQueueFamilyIndex = _transferFamily,
+        .dstQueueFamilyIndex = _graphicsFamily,
+        .buffer = dst->handle,
+        .offset = offset,
+        .size = size,
+    };
+    batch->bufferReleases.push_back(barrier);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    batch->bufferAcquires.push_back(barrier);
+  }
+  batch->resources.push_back(dst);
+}
+
+void leimu::memory::Uploader::record(
+    Batch *batch,
+    const VkBuffer src,
+    const VkDeviceSize srcOffset,
+    const Image &dst,
+    const std::span<const VkBufferImageCopy> regions,
+    const VkImageLayout finalLayout,
+    std::function<void(VkCommandBuffer)> onAcquire) noexcept {
+
+  const VkImageSubresourceRange range{
+      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+      .baseMipLevel = 0,
+      .levelCount = dst->mipLevels,
+      .baseArrayLayer = 0,
+      .layerCount = dst->arrayLayers,
+  };
+
+  VkImageMemoryBarrier barrier{
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      .srcAccessMask = 0,
+      .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+      .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = dst->handle,
+      .subresourceRange = range,
+  };
+  vkCmdPipelineBarrier(
+      batch->commandBuffer,
+      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0,
+      0, nullptr,
+      0, nullptr,
+      1, &barrier);
+
+  std::vector<VkBufferImageCopy> copies(regions.begin(), regions.end());
+  for (auto &region: copies) {
+    region.bufferOffset += srcOffset;
+  }
+  vkCmdCopyBufferToImage(
+      batch->commandBuffer,
+      src,
+      dst->handle,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      static_cast<u32>(copies.size()),
+      copies.data());
+  batch->empty = false;
+
+  // The layout transition happens on release, so both sides agree on it
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = ownershipTransfer() ? 0 : VK_ACCESS_MEMORY_READ_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = finalLayout;
+  if (ownershipTransfer()) {
+    barrier.srcQueueFamilyIndex = _transferFamily;
+    barrier.dstQueueFamilyIndex = _graphicsFamily;
+  }
+  batch->imageReleases.push_back(barrier);
+
+  if (ownershipTransfer()) {
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    batch->imageAcquires.push_back(barrier);
+  }
+  batch->resources.push_back(dst);
+  if (onAcquire) {
+    batch->acquired.push_back(std::move(onAcquire));
+  }
+}
+
+void leimu::memory::Uploader::flush(const u64 completedFrames) noexcept {
+  std::lock_guard _(_lock);
+
+  // A batch is reusable once its copies are done and the frame that waited on its semaphore has completed
+  while (!_inFlight.empty()) {
+    auto &batch = _inFlight.front();
+    if (batch->acquiredBy == UINT64_MAX || batch->acquiredBy >= completedFrames || batch->waiters || !done(*batch)) {
+      break;
+    }
+
+    _tail = std::max(_tail, batch->end);
+    recycle(*batch);
+    _free.push_back(std::move(batch));
+    _inFlight.pop_front();
+  }
+
+  if (!_recording || _recording->empty) {
+    return;
+  }
+
+  const auto batch = _recording.get();
+  if (!batch->bufferReleases.empty() || !batch->imageReleases.empty()) {
+    vkCmdPipelineBarrier(
+        batch->commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        ownershipTransfer() ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0,
+        0, nullptr,
+        static_cast<u32>(batch->bufferReleases.size()), batch->bufferReleases.data(),
+        static_cast<u32>(batch->imageReleases.size()), batch->imageReleases.data());
+  }
+
+  // A batch that can't go out is dropped along with its copies; recording() resets and begins it anew
+  const auto drop = [this] {
+    recycle(*_recording);
+    _free.push_back(std::move(_recording));
+  };
+
+  if (vkEndCommandBuffer(batch->commandBuffer) != VK_SUCCESS) {
+    std::println(errs(), "[upload] Couldn't end command buffer; upload batch dropped");
+    drop();
+    return;
+  }
+
+  const auto semaphore = batch->semaphore.get();
+  if (_timeline) {
+    render::TimelineSubmit submit{.commandBuffers = {batch->commandBuffer}};
+    submit.signal(semaphore);
+    if (!((batch->value = _timeline->submit(std::move(submit))))) {
+      std::println(errs(), "[upload] Couldn't submit upload batch; dropped");
+      drop();
+      return;
+    }
+  } else {
+    VkSubmitInfo submitInfo{
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &batch->commandBuffer,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &semaphore,
+    };
+    if (vkQueueSubmit(_queue.get(), 1, &submitInfo, batch->fence.get()) != VK_SUCCESS) {
+      std::println(errs(), "[upload] Couldn't submit upload batch; dropped");
+      drop();
+      return;
+    }
+  }
+
+  batch->end = _head;
+  _inFlight.push_back(std::move(_recording));
+}
+
+void leimu::memory::Uploader::acquire(
+    const VkCommandBuffer commandBuffer,
+    const u64 frame,
+    std::vector<VkSemaphore> &waitSemaphores,
+    std::vector<VkPipelineStageFlags> &waitStages) noexcept {
+  std::lock_guard _(_lock);
+
+  std::vector<VkBufferMemoryBarrier> buffers;
+  std::vector<VkImageMemoryBarrier> images;
+  std::vector<Batch *> acquired;
+  for (const auto &batch: _inFlight) {
+    if (batch->acquiredBy != UINT64_MAX) {
+      continue;
+    }
+
+    buffers.insert(buffers.end(), batch->bufferAcquires.begin(), batch->bufferAcquires.end());
+    images.insert(images.end(), batch->imageAcquires.begin(), batch->imageAcquires.end());
+    waitSemaphores.push_back(batch->semaphore.get());
+    waitStages.push_back(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    batch->acquiredBy = frame;
+    acquired.push_back(batch.get());
+  }
+
+  if (!buffers.empty() || !images.empty()) {
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0,
+        0, nullptr,
+        static_cast<u32>(buffers.size()), buffers.data(),
+        static_cast<u32>(images.size()), images.data());
+  }
+
+  for (const auto batch: acquired) {
+    for (const auto &record: batch->acquired) {
+      record(commandBuffer);
+    }
+  }
+}
+
+std::shared_ptr<leimu::memory::Uploader> leimu::memory::CreateUploader(
+    const feature::VulkanDevice &device,
+    const std::shared_ptr<Allocator> &allocator,
+    const feature::VulkanQueueFamilyIndices &families,
+    const feature::VulkanQueue &transferQueue,
+    const render::Timeline &timeline,
+    const VkDeviceSize capacity) noexcept {
+
+  auto uploader = std::make_shared<Uploader>(device, allocator, families, transferQueue, timeline, capacity);
+  if (!*uploader) {
+    return nullptr;
+  }
+
+  return uploader;
+}
@@ -0,0 +1,504 @@
+#include "leimu/native/aio.h"
+
+#if __unix__
+
+#include "leimu/logging.h"
+#include "leimu/trace.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if __linux__
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
+class leimu::native::FileReader::Backend {
+protected:
+  job::Scheduler &_jobs;
+
+  void complete(ReadRequest &request, const i64 result) const {
+    if (request.done) {
+      _jobs.run([done = std::move(request.done), result] { done(result); });
+    }
+  }
+
+public:
+  explicit Backend(job::Scheduler &jobs) : _jobs(jobs) {}
+  virtual ~Backend() = default;
+
+  [[nodiscard]] virtual bool uring() const = 0;
+  virtual bool registerBuffers(std::span<const std::span<u8>> buffers) noexcept = 0;
+  virtual void submit(std::span<ReadRequest> requests) = 0;
+};
+
+namespace {
+  using Backend = leimu::native::FileReader::Backend;
+  using leimu::native::ReadRequest;
+
+  /**
+   * pread on a few threads of its own; depth is bounded by their number.
+   */
+  class ThreadBackend final : public Backend {
+    std::mutex _lock;
+    std::condition_variable_any _signal;
+    std::deque<ReadRequest> _pending;
+    std::vector<std::jthread> _threads;
+
+    void work(const u32 thread, const std::stop_token &token) {
+      LEIMU_TRACE_THREAD(std::format("io worker #{}", thread));
+
+      while (true) {
+        ReadRequest request;
+        {
+          std::unique_lock lock(_lock);
+          // Requests still queued on stop are read all the same; their buffers are waited on
+          _signal.wait(lock, token, [this] { return !_pending.empty(); });
+          if (_pending.empty()) {
+            return;
+          }
+          request = std::move(_pending.front());
+          _pending.pop_front();
+        }
+
+        LEIMU_ZONE("io: pread");
+
+        i64 done = 0;
+        while (done < static_cast<i64>(request.buffer.size())) {
+          const auto n = pread(
+              request.file->fd(),
+              request.buffer.data() + done,
+              request.buffer.size() - done,
+              static_cast<off_t>(request.offset + done));
+          if (n < 0 && errno == EINTR) {
+            continue;
+          }
+          if (n < 0) {
+            done = -errno;
+            break;
+          }
+          if (n == 0) {
+            break;
+          }
+          done += n;
+        }
+
+        complete(request, done);
+      }
+    }
+
+  public:
+    ThreadBackend(leimu::job::Scheduler &jobs, const u32 threads) : Backend(jobs) {
+      for (u32 i = 0; i < threads; ++i) {
+        _threads.emplace_back([this, i](const std::stop_token &token) { work(i + 1, token); });
+      }
+    }
+
+    ~ThreadBackend() override {
+      for (auto &thread: _threads) {
+        thread.request_stop();
+      }
+      _threads.clear();
+    }
+
+    [[nodiscard]] bool uring() const override { return false; }
+
+    bool registerBuffers(std::span<const std::span<u8>>) noexcept override { return true; }
+
+    void submit(const std::span<ReadRequest> requests) override {
+      {
+        std::lock_guard _(_lock);
+        for (auto &request: requests) {
+          _pending.push_back(std::move(request));
+        }
+      }
+      _signal.notify_all();
+    }
+  };
+
+#if __linux__
+  int UringSetup(const u32 entries, io_uring_params *params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+  }
+
+  int UringEnter(const int fd, const u32 submit, const u32 wait, const u32 flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, submit, wait, flags, nullptr, 0));
+  }
+
+  // Waits for a completion at most timeout; needs IORING_FEAT_EXT_ARG
+  int UringWait(const int fd, const u32 submit, const std::chrono::nanoseconds timeout) {
+    __kernel_timespec ts{
+        .tv_sec = timeout.count() / 1'000'000'000,
+        .tv_nsec = timeout.count() % 1'000'000'000,
+    };
+    io_uring_getevents_arg arg{
+        .ts = reinterpret_cast<u64>(&ts),
+    };
+    return static_cast<int>(syscall(
+        __NR_io_uring_enter, fd, submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg)));
+  }
+
+  // Reads are split into pieces of at most this, since an SQE length is 32-bit; keeps direct reads aligned
+  constexpr size_t MaxReadSize = size_t{1} << 30;
+
+  int UringRegister(const int fd, const u32 opcode, const void *arg, const u32 count) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+  }
+
+  /**
+   * One ring; submitters fill it under a lock, a single thread reaps completions.
+   * Reads are resubmitted until complete, so callbacks see short reads only at the end of the file.
+   */
+  class UringBackend final : public Backend {
+    struct InFlight {
+      ReadRequest request;
+      // bytes read so far
+      size_t done = 0;
+      iovec vector;
+    };
+
+    int _fd = -1;
+    u32 _depth = 0;
+    u32 _sqEntries = 0;
+
+    u8 *_sq = nullptr;
+    size_t _sqSize = 0;
+    u8 *_cq = nullptr;
+    size_t _cqSize = 0;
+    io_uring_sqe *_sqes = nullptr;
+    size_t _sqesSize = 0;
+
+    u32 *_sqHead, *_sqTail, *_sqMask, *_sqArray;
+    u32 *_cqHead, *_cqTail, *_cqMask;
+    io_uring_cqe *_cqes;
+
+    std::mutex _lock;
+    // new reads, and the remainders of short ones in front
+    std::deque<std::unique_ptr<InFlight>> _pending;
+    u32 _inFlight = 0;
+    bool _stopping = false;
+    bool _submitted = false;
+    std::vector<std::span<u8>> _registered;
+
+    std::thread _reaper;
+
+    // Locked; moves pending requests into free slots and submits them
+    void pump() {
+      auto tail = std::atomic_ref(*_sqTail).load(std::memory_order_relaxed);
+      const auto head = std::atomic_ref(*_sqHead).load(std::memory_order_acquire);
+      while (!_pending.empty() && _inFlight < _depth && tail - head < _sqEntries) {
+        auto inFlight = std::move(_pending.front());
+        _pending.pop_front();
+
+        const auto &request = inFlight->request;
+        const auto buffer = request.buffer.subspan(
+            inFlight->done,
+            std::min(request.buffer.size() - inFlight->done, MaxReadSize));
+        const auto index = tail & *_sqMask;
+        auto &sqe = _sqes[index];
+        sqe = {};
+        sqe.fd = request.file->fd();
+        sqe.off = request.offset + inFlight->done;
+        sqe.user_data = reinterpret_cast<u64>(inFlight.get());
+
+        const auto registered = std::ranges::find_if(_registered, [&buffer](const std::span<u8> region) {
+          return buffer.data() >= region.data() && buffer.data() + buffer.size() <= region.data() + region.size();
+        });
+        if (registered != _registered.end()) {
+          sqe.opcode = IORING_OP_READ_FIXED;
+          sqe.addr = reinterpret_cast<u64>(buffer.data());
+          sqe.len = static_cast<u32>(buffer.size());
+          sqe.buf_index = static_cast<u16>(registered - _registered.begin());
+        } else {
+          inFlight->vector = {buffer.data(), buffer.size()};
+          sqe.opcode = IORING_OP_READV;
+          sqe.addr = reinterpret_cast<u64>(&inFlight->vector);
+          sqe.len = 1;
+        }
+
+        _sqArray[index] = index;
+        std::atomic_ref(*_sqTail).store(++tail, std::memory_order_release);
+        (void) inFlight.release();
+        ++_inFlight;
+      }
+
+      // Entries left over by a failed enter go along with these; should it fail again, the reaper retries
+      if (const auto unsubmitted = tail - head) {
+        if (UringEnter(_fd, unsubmitted, 0, 0) < 0 && errno != EAGAIN && errno != EBUSY && errno != EINTR) {
+          std::println(leimu::errs(), "[aio] io_uring_enter failed: {}", strerror(errno));
+        }
+        _submitted = true;
+      }
+    }
+
+    void reap() {
+      LEIMU_TRACE_THREAD("io reaper");
+
+      // Woken periodically, so that entries a failed enter left behind are submitted even if nothing completes;
+      // soon while it knows of some
+      u32 unsubmitted = 0;
+      while (true) {
+        const auto timeout = unsubmitted ? std::chrono::milliseconds(1) : std::chrono::milliseconds(50);
+        if (UringWait(_fd, unsubmitted, timeout) < 0 &&
+            errno != EINTR && errno != EAGAIN && errno != EBUSY && errno != ETIME) {
+          std::println(leimu::errs(), "[aio] io_uring_enter failed: {}", strerror(errno));
+        }
+
+        auto head = std::atomic_ref(*_cqHead).load(std::memory_order_relaxed);
+        const auto tail = std::atomic_ref(*_cqTail).load(std::memory_order_acquire);
+
+        u32 completed = 0;
+        std::vector<InFlight *> resubmit;
+        for (; head != tail; ++head) {
+          const auto &cqe = _cqes[head & *_cqMask];
+          // Null user data is the wake-up sent on destruction
+          const auto inFlight = reinterpret_cast<InFlight *>(cqe.user_data);
+          if (!inFlight) {
+            continue;
+          }
+          ++completed;
+
+          if (cqe.res == -EAGAIN || cqe.res == -EINTR) {
+            resubmit.push_back(inFlight);
+            continue;
+          }
+          if (cqe.res > 0) {
+            const auto &request = inFlight->request;
+            inFlight->done += static_cast<size_t>(cqe.res);
+            if (inFlight->done < request.buffer.size() && request.offset + inFlight->done < request.file->size()) {
+              // Short, but not at the end of the file
+              resubmit.push_back(inFlight);
+              continue;
+            }
+          }
+
+          complete(inFlight->request, cqe.res < 0 ? cqe.res : static_cast<i64>(inFlight->done));
+          delete inFlight;
+        }
+        std::atomic_ref(*_cqHead).store(head, std::memory_order_release);
+
+        std::lock_guard _(_lock);
+        _inFlight -= completed;
+        for (const auto inFlight: std::views::reverse(resubmit)) {
+          _pending.emplace_front(inFlight);
+        }
+        pump();
+        unsubmitted = std::atomic_ref(*_sqTail).load(std::memory_order_relaxed) -
+                      std::atomic_ref(*_sqHead).load(std::memory_order_acquire);
+        if (_stopping && !_inFlight && _pending.empty()) {
+          return;
+        }
+      }
+    }
+
+  public:
+    UringBackend(leimu::job::Scheduler &jobs, const u32 depth) : Backend(jobs) {
+      io_uring_params params{};
+      if ((_fd = UringSetup(depth, &params)) < 0) {
+        _fd = -1;
+        std::println(leimu::warns(), "[aio] io_uring is unavailable: {}", strerror(errno));
+        return;
+      }
+      if (!(params.features & IORING_FEAT_EXT_ARG)) {
+        // The reaper needs timed waits; kernels before 5.11 go through the pread threads
+        std::println(leimu::warns(), "[aio] io_uring can't wait with a timeout here");
+        close(_fd);
+        _fd = -1;
+        return;
+      }
+      _depth = params.sq_entries;
+      _sqEntries = params.sq_entries;
+
+      _sqSize = params.sq_off.array + params.sq_entries * sizeof(u32);
+      _cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+      const auto single = params.features & IORING_FEAT_SINGLE_MMAP;
+      if (single) {
+        _sqSize = _cqSize = std::max(_sqSize, _cqSize);
+      }
+
+      auto sq = mmap(nullptr, _sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+      auto cq = single
+                  ? sq
+                  : mmap(nullptr, _cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+      _sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+      auto sqes = mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+      if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED) {
+        std::println(leimu::warns(), "[aio] Couldn't map io_uring: {}", strerror(errno));
+        if (sq != MAP_FAILED) munmap(sq, _sqSize);
+        if (cq != MAP_FAILED && !single) munmap(cq, _cqSize);
+        if (sqes != MAP_FAILED) munmap(sqes, _sqesSize);
+        close(_fd);
+        _fd = -1;
+        return;
+      }
+
+      _sq = static_cast<u8 *>(sq);
+      _cq = static_cast<u8 *>(cq);
+      _sqes = static_cast<io_uring_sqe *>(sqes);
+
+      _sqHead = reinterpret_cast<u32 *>(_sq + params.sq_off.head);
+      _sqTail = reinterpret_cast<u32 *>(_sq + params.sq_off.tail);
+      _sqMask = reinterpret_cast<u32 *>(_sq + params.sq_off.ring_mask);
+      _sqArray = reinterpret_cast<u32 *>(_sq + params.sq_off.array);
+      _cqHead = reinterpret_cast<u32 *>(_cq + params.cq_off.head);
+      _cqTail = reinterpret_cast<u32 *>(_cq + params.cq_off.tail);
+      _cqMask = reinterpret_cast<u32 *>(_cq + params.cq_off.ring_mask);
+      _cqes = reinterpret_cast<io_uring_cqe *>(_cq + params.cq_off.cqes);
+
+      _reaper = std::thread([this] { reap(); });
+    }
+
+    ~UringBackend() override {
+      if (_fd < 0) {
+        return;
+      }
+
+      {
+        std::lock_guard _(_lock);
+        _stopping = true;
+
+        // Wakes the reaper if there's room; it wakes by itself in a moment otherwise.
+        // Reads still queued or in flight are finished first, since callers own their buffers
+        auto tail = std::atomic_ref(*_sqTail).load(std::memory_order_relaxed);
+        if (tail - std::atomic_ref(*_sqHead).load(std::memory_order_acquire) < _sqEntries) {
+          const auto index = tail & *_sqMask;
+          _sqes[index] = {};
+          _sqes[index].opcode = IORING_OP_NOP;
+          _sqArray[index] = index;
+          std::atomic_ref(*_sqTail).store(++tail, std::memory_order_release);
+        }
+        pump();
+      }
+      _reaper.join();
+
+      munmap(_sqes, _sqesSize);
+      if (_cq != _sq) {
+        munmap(_cq, _cqSize);
+      }
+      munmap(_sq, _sqSize);
+      close(_fd);
+    }
+
+    [[nodiscard]] bool operator!() const { return _fd < 0; }
+
+    [[nodiscard]] bool uring() const override { return true; }
+
+    bool registerBuffers(const std::span<const std::span<u8>> buffers) noexcept override {
+      std::lock_guard _(_lock);
+      if (_submitted || !_registered.empty()) {
+        std::println(leimu::errs(), "[aio] Buffers have to be registered once, before any read");
+        return false;
+      }
+
+      std::vector<iovec> vectors;
+      vectors.reserve(buffers.size());
+      for (const auto &buffer: buffers) {
+        vectors.push_back({buffer.data(), buffer.size()});
+      }
+
+      if (UringRegister(_fd, IORING_REGISTER_BUFFERS, vectors.data(), static_cast<u32>(vectors.size())) < 0) {
+        // e.g. RLIMIT_MEMLOCK; reads into them still work
+        std::println(leimu::warns(), "[aio] Couldn't register buffers: {}", strerror(errno));
+        return false;
+      }
+
+      _registered.assign(buffers.begin(), buffers.end());
+      return true;
+    }
+
+    void submit(const std::span<ReadRequest> requests) override {
+      std::lock_guard _(_lock);
+      for (auto &request: requests) {
+        _pending.push_back(std::make_unique<InFlight>(std::move(request)));
+      }
+      pump();
+    }
+  };
+#endif
+}
+
+leimu::native::File leimu::native::OpenFile(std::filesystem::path path, const bool direct) noexcept {
+  auto isDirect = direct;
+  auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | (direct ? O_DIRECT : 0));
+  if (fd == -1 && direct && errno == EINVAL) {
+    // e.g. tmpfs
+    std::println(leimu::warns(), "[aio] '{}' can't be read directly; reading through the page cache", path.string());
+    isDirect = false;
+    fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  }
+  if (fd == -1) {
+    std::println(leimu::errs(), "[aio] Couldn't open file '{}': {}", path.string(), strerror(errno));
+    return nullptr;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st)) {
+    std::println(leimu::errs(), "[aio] Couldn't stat file '{}': {}", path.string(), strerror(errno));
+    close(fd);
+    return nullptr;
+  }
+
+  return {
+      new File_T{fd, static_cast<size_t>(st.st_size), isDirect},
+      [](const File_T *self) {
+        close(self->fd());
+        delete self;
+      }
+  };
+}
+
+leimu::native::FileReader::FileReader(job::Scheduler &jobs, const u32 depth) noexcept : _jobs(jobs) {
+#if __linux__
+  if (auto uring = std::make_unique<UringBackend>(jobs, depth); !!*uring) {
+    _backend = std::move(uring);
+    std::println(outs(), "[aio] io_uring with {} reads in flight", depth);
+    return;
+  }
+#endif
+
+  const auto threads = std::clamp(depth, 1u, 4u);
+  _backend = std::make_unique<ThreadBackend>(jobs, threads);
+  std::println(outs(), "[aio] pread on {} threads", threads);
+}
+
+leimu::native::FileReader::~FileReader() = default;
+
+bool leimu::native::FileReader::uring() const {
+  return _backend && _backend->uring();
+}
+
+bool leimu::native::FileReader::registerBuffers(const std::span<const std::span<u8>> buffers) noexcept {
+  return _backend && _backend->registerBuffers(buffers);
+}
+
+void leimu::native::FileReader::read(const std::span<ReadRequest> requests) {
+  std::vector<ReadRequest> valid;
+  valid.reserve(requests.size());
+
+  for (auto &request: requests) {
+    const auto aligned =
+        request.offset % DirectAlignment == 0 &&
+        request.buffer.size() % DirectAlignment == 0 &&
+        reinterpret_cast<uintptr_t>(request.buffer.data()) % DirectAlignment == 0;
+
+    if (!request.file || (request.file->direct() && !aligned)) {
+      if (request.file) {
+        std::println(errs(), "[aio] Direct reads have to be aligned to {} bytes", DirectAlignment);
+      }
+      if (request.done) {
+        _jobs.run([done = std::move(request.done)] { done(-EINVAL); });
+      }
+      continue;
+    }
+    valid.push_back(std::move(request));
+  }
+
+  if (!valid.empty()) {
+    _backend->submit(valid);
+  }
+}
+
+#endif
@@ -7,10 +7,43 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
 
-leimu::native::FileMapping leimu::native::CreateFileMapping(std::filesystem::path path) noexcept {
+namespace {
+  int GetAdvice(const leimu::native::Advice advice) {
+    switch (advice) {
+      case leimu::native::Advice::Sequential:
+        return MADV_SEQUENTIAL;
+      case leimu::native::Advice::Random:
+        return MADV_RANDOM;
+      case leimu::native::Advice::WillNeed:
+        return MADV_WILLNEED;
+      case leimu::native::Advice::DontNeed:
+        return MADV_DONTNEED;
+      default:
+        return MADV_NORMAL;
+    }
+  }
+}
+
+void leimu::native::FileMapping_T::advise(const size_t offset, const size_t size, const Advice advice) const noexcept {
+  if (offset >= _size || !size) {
+    return;
+  }
+
+  // madvise takes page-aligned addresses; the mapping itself starts at a page
+  static const auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  const auto begin = offset / page * page;
+  const auto end = std::min(offset + size, _size);
+
+  if (madvise(static_cast<u8 *>(_p) + begin, end - begin, GetAdvice(advice))) {
+    std::println(leimu::warns(), "[mmap.unix] madvise failed: {}", strerror(errno));
+  }
+}
+
+leimu::native::FileMapping leimu::native::CreateFileMapping(std::filesystem::path path, const Advice advice) noexcept {
   int fd;
-  if ((fd = open(path.c_str(), O_RDONLY)) == -1) {
+  if ((fd = open(path.c_str(), O_RDONLY | O_CLOEXEC)) == -1) {
     std::println(leimu::errs(), "[mmap.unix] Couldn't open file '{}': {}", path.string(), strerror(errno));
     return nullptr;
   }
@@ -18,27 +51,39 @@ leimu::native::FileMapping leimu::native::CreateFileMapping(std::filesystem::pat
   struct stat st;
   if (fstat(fd, &st)) {
     std::println(leimu::errs(), "[mmap.unix] Couldn't stat file '{}': {}", path.string(), strerror(errno));
+    close(fd);
     return nullptr;
   }
-  if (st.st_size < 0) {
+  if (st.st_size <= 0) {
     std::println(leimu::errs(), "[mmap.unix] File size must be greater than 0: {}", path.string());
+    close(fd);
     return nullptr;
   }
 
-  void *p;
-  if (!((p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0)))) {
-    std::println(leimu::errs(), "[mmap.unix] Couldn't mmap file '{}': {}", path.string(), strerror(errno));
+  const auto p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  const auto error = errno;
+  // The mapping keeps its own reference to the file
+  close(fd);
+  if (p == MAP_FAILED) {
+    std::println(leimu::errs(), "[mmap.unix] Couldn't mmap file '{}': {}", path.string(), strerror(error));
     return nullptr;
   }
 
-  return FileMapping(
+  auto mapping = FileMapping(
       new FileMapping_T{p, static_cast<size_t>(st.st_size)},
       [=](const FileMapping_T *self) {
         if (munmap(const_cast<void*>(self->ptr()), self->size())) {
           std::println(leimu::errs(), "[mmap.unix] Couldn't munmap file '{}': {}", path.string(), strerror(errno));
         }
+        delete self;
       }
   );
+
+  if (advice != Advice::Normal) {
+    mapping->advise(0, mapping->size(), advice);
+  }
+
+  return mapping;
 }
 
 #endif
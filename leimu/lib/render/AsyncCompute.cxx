@@ -0,0 +1,170 @@
+#include "leimu/render/AsyncCompute.h"
+
+leimu::render::AsyncCompute::AsyncCompute(
+    feature::VulkanDevice device,
+    const feature::VulkanQueueFamilyIndices &families,
+    feature::VulkanQueue queue,
+    Timeline timeline) noexcept
+  : _device(std::move(device)),
+    _queue(std::move(queue)),
+    _timeline(std::move(timeline)),
+    _family(families->computeQueue) {
+
+  _families.push_back(families->graphicsQueue);
+  if (_family != families->graphicsQueue) {
+    _families.push_back(_family);
+  }
+
+  std::println(outs(), "[compute] {}", async() ? "asynchronous compute queue" : "sharing graphics queue");
+}
+
+leimu::render::AsyncCompute::Batch *leimu::render::AsyncCompute::next() noexcept {
+  if (_next) {
+    return _next.get();
+  }
+
+  if (!_free.empty()) {
+    _next = std::move(_free.back());
+    _free.pop_back();
+    return _next.get();
+  }
+
+  auto batch = std::make_unique<Batch>();
+  if (!((batch->pool = feature::CreateCommandPool(_device, _family, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT)))) {
+    return nullptr;
+  }
+
+  VkCommandBufferAllocateInfo allocInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool = batch->pool.get(),
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1,
+  };
+  if (vkAllocateCommandBuffers(_device.get(), &allocInfo, &batch->commandBuffer) != VK_SUCCESS) {
+    std::println(errs(), "[compute] Couldn't allocate command buffer");
+    return nullptr;
+  }
+
+  if ((!_timeline && !((batch->fence = feature::CreateFence(_device, false)))) ||
+      !((batch->finished = feature::CreateSemaphore(_device))) ||
+      !((batch->ready = feature::CreateSemaphore(_device)))) {
+    return nullptr;
+  }
+
+  _next = std::move(batch);
+  return _next.get();
+}
+
+void leimu::render::AsyncCompute::after(feature::VkFrame_T &frame) noexcept {
+  const auto batch = next();
+  if (!batch || batch->waitsOnGraphics) {
+    return;
+  }
+
+  batch->waitsOnGraphics = true;
+  frame.signalSemaphores.push_back(batch->ready.get());
+}
+
+bool leimu::render::AsyncCompute::submit(
+    const std::function<void(VkCommandBuffer)> &record,
+    const VkPipelineStageFlags consumerStage) noexcept {
+
+  const auto batch = next();
+  if (!batch) {
+    std::println(errs(), "[compute] Couldn't prepare submission");
+    return false;
+  }
+
+  vkResetCommandPool(_device.get(), batch->pool.get(), 0);
+
+  VkCommandBufferBeginInfo beginInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+  };
+  if (vkBeginCommandBuffer(batch->commandBuffer, &beginInfo) != VK_SUCCESS) {
+    std::println(errs(), "[compute] Couldn't begin command buffer");
+    return false;
+  }
+
+  record(batch->commandBuffer);
+
+  if (vkEndCommandBuffer(batch->commandBuffer) != VK_SUCCESS) {
+    std::println(errs(), "[compute] Couldn't end command buffer");
+    return false;
+  }
+
+  const auto ready = batch->ready.get();
+  const auto finished = batch->finished.get();
+  constexpr VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+  if (_timeline) {
+    TimelineSubmit submit{.commandBuffers = {batch->commandBuffer}};
+    if (batch->waitsOnGraphics) {
+      submit.wait(ready, waitStage);
+    }
+    submit.signal(finished);
+    if (!((batch->value = _timeline->submit(std::move(submit))))) {
+      std::println(errs(), "[compute] Couldn't submit compute work");
+      return false;
+    }
+  } else {
+    VkSubmitInfo submitInfo{
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .waitSemaphoreCount = batch->waitsOnGraphics ? 1u : 0u,
+        .pWaitSemaphores = &ready,
+        .pWaitDstStageMask = &waitStage,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &batch->commandBuffer,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &finished,
+    };
+    if (vkQueueSubmit(_queue.get(), 1, &submitInfo, batch->fence.get()) != VK_SUCCESS) {
+      std::println(errs(), "[compute] Couldn't submit compute work");
+      return false;
+    }
+  }
+
+  batch->consumerStage = consumerStage;
+  _inFlight.push_back(std::move(_next));
+  return true;
+}
+
+void leimu::render::AsyncCompute::consume(
+    const u64 frame,
+    const u64 completedFrames,
+    std::vector<VkSemaphore> &waitSemaphores,
+    std::vector<VkPipelineStageFlags> &waitStages) noexcept {
+
+  while (!_inFlight.empty()) {
+    auto &batch = _inFlight.front();
+    if (batch->consumedBy == UINT64_MAX || batch->consumedBy >= completedFrames) {
+      break;
+    }
+    if (_timeline) {
+      if (!_timeline->completed(batch->value)) {
+        break;
+      }
+    } else {
+      if (vkGetFenceStatus(_device.get(), batch->fence.get()) != VK_SUCCESS) {
+        break;
+      }
+      const auto fence = batch->fence.get();
+      vkResetFences(_device.get(), 1, &fence);
+    }
+    batch->waitsOnGraphics = false;
+    batch->consumedBy = UINT64_MAX;
+
+    _free.push_back(std::move(batch));
+    _inFlight.pop_front();
+  }
+
+  for (const auto &batch: _inFlight) {
+    if (batch->consumedBy != UINT64_MAX) {
+      continue;
+    }
+
+    waitSemaphores.push_back(batch->finished.get());
+    waitStages.push_back(batch->consumerStage);
+    batch->consumedBy = frame;
+  }
+}
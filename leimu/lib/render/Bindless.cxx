@@ -0,0 +1,200 @@
+#include "leimu/render/Bindless.h"
+
+namespace {
+  constexpr std::array BindlessTypes{
+      VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      VK_DESCRIPTOR_TYPE_SAMPLER,
+  };
+
+  constexpr std::array<const char *, 3> BindlessNames{
+      "sampled image",
+      "storage buffer",
+      "sampler",
+  };
+}
+
+leimu::render::Bindless::Bindless(
+    feature::VulkanDevice device,
+    const feature::VkCapabilities_T &capabilities,
+    DescriptorLayoutCache &layouts,
+    const BindlessCapacity capacity) noexcept
+  : _device(std::move(device)) {
+
+  _tables[0].capacity = std::clamp(capacity.sampledImages, 1u, capabilities.maxBindlessSampledImages);
+  _tables[1].capacity = std::clamp(capacity.storageBuffers, 1u, capabilities.maxBindlessStorageBuffers);
+  _tables[2].capacity = std::clamp(capacity.samplers, 1u, capabilities.maxBindlessSamplers);
+
+  // Every stage sees every binding, so the sum is bound by the per-stage limit; shrink all tables alike
+  const auto total = static_cast<u64>(_tables[0].capacity) + _tables[1].capacity + _tables[2].capacity;
+  if (total > capabilities.maxBindlessResources) {
+    for (auto &table: _tables) {
+      table.capacity = std::max<u32>(1, static_cast<u64>(table.capacity) * capabilities.maxBindlessResources / total);
+    }
+  }
+
+  std::array<VkDescriptorSetLayoutBinding, BindlessTypes.size()> bindings;
+  std::array<VkDescriptorBindingFlags, BindlessTypes.size()> flags;
+  std::array<VkDescriptorPoolSize, BindlessTypes.size()> sizes;
+  for (u32 i = 0; i < bindings.size(); ++i) {
+    bindings[i] = {
+        .binding = i,
+        .descriptorType = BindlessTypes[i],
+        .descriptorCount = _tables[i].capacity,
+        .stageFlags = VK_SHADER_STAGE_ALL,
+    };
+    flags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+               VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+               VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    sizes[i] = {BindlessTypes[i], _tables[i].capacity};
+  }
+
+  if (!((_layout = layouts.get(bindings, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT, flags)))) {
+    return;
+  }
+
+  const VkDescriptorPoolCreateInfo poolCreateInfo{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+      .maxSets = 1,
+      .poolSizeCount = static_cast<u32>(sizes.size()),
+      .pPoolSizes = sizes.data(),
+  };
+
+  VkDescriptorPool pool;
+  if (vkCreateDescriptorPool(_device.get(), &poolCreateInfo, nullptr, &pool) != VK_SUCCESS) {
+    std::println(errs(), "[bindless] Couldn't create descriptor pool");
+    return;
+  }
+  _pool = {
+      pool, [device = _device](const VkDescriptorPool self) {
+        vkDestroyDescriptorPool(device.get(), self, nullptr);
+      }
+  };
+
+  const auto layout = _layout.get();
+  const VkDescriptorSetAllocateInfo allocateInfo{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .descriptorPool = pool,
+      .descriptorSetCount = 1,
+      .pSetLayouts = &layout,
+  };
+  if (vkAllocateDescriptorSets(_device.get(), &allocateInfo, &_set) != VK_SUCCESS) {
+    std::println(errs(), "[bindless] Couldn't allocate descriptor set");
+    _set = VK_NULL_HANDLE;
+    return;
+  }
+
+  std::println(
+      outs(),
+      "[bindless] {} sampled images, {} storage buffers, {} samplers",
+      _tables[0].capacity,
+      _tables[1].capacity,
+      _tables[2].capacity);
+}
+
+u32 leimu::render::Bindless::acquire(const BindlessType type) {
+  auto &table = _tables[static_cast<u8>(type)];
+  if (!table.free.empty()) {
+    const auto index = table.free.back();
+    table.free.pop_back();
+    return index;
+  }
+  if (table.next < table.capacity) {
+    return table.next++;
+  }
+
+  std::println(errs(), "[bindless] All {} {} slots are taken", table.capacity, BindlessNames[static_cast<u8>(type)]);
+  return None;
+}
+
+void leimu::render::Bindless::write(
+    const BindlessType type,
+    const u32 index,
+    const VkDescriptorImageInfo *image,
+    const VkDescriptorBufferInfo *buffer) {
+
+  const VkWriteDescriptorSet write{
+      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+      .dstSet = _set,
+      .dstBinding = static_cast<u32>(type),
+      .dstArrayElement = index,
+      .descriptorCount = 1,
+      .descriptorType = BindlessTypes[static_cast<u8>(type)],
+      .pImageInfo = image,
+      .pBufferInfo = buffer,
+  };
+  vkUpdateDescriptorSets(_device.get(), 1, &write, 0, nullptr);
+}
+
+u32 leimu::render::Bindless::add(const VkImageView view, const VkImageLayout layout) {
+  std::lock_guard _(_lock);
+
+  const auto index = acquire(BindlessType::SampledImage);
+  if (index != None) {
+    const VkDescriptorImageInfo image{.imageView = view, .imageLayout = layout};
+    write(BindlessType::SampledImage, index, &image, nullptr);
+  }
+  return index;
+}
+
+u32 leimu::render::Bindless::add(const VkBuffer buffer, const VkDeviceSize offset, const VkDeviceSize range) {
+  std::lock_guard _(_lock);
+
+  const auto index = acquire(BindlessType::StorageBuffer);
+  if (index != None) {
+    const VkDescriptorBufferInfo info{buffer, offset, range};
+    write(BindlessType::StorageBuffer, index, nullptr, &info);
+  }
+  return index;
+}
+
+u32 leimu::render::Bindless::add(const VkSampler sampler) {
+  std::lock_guard _(_lock);
+
+  const auto index = acquire(BindlessType::Sampler);
+  if (index != None) {
+    const VkDescriptorImageInfo image{.sampler = sampler};
+    write(BindlessType::Sampler, index, &image, nullptr);
+  }
+  return index;
+}
+
+void leimu::render::Bindless::remove(const BindlessType type, const u32 index) {
+  std::lock_guard _(_lock);
+
+  // The frame being recorded may read it; partially bound, so the stale descriptor can stay meanwhile
+  auto &table = _tables[static_cast<u8>(type)];
+  assert(index < table.next);
+  table.retired.emplace_back(_frame + 1, index);
+}
+
+void leimu::render::Bindless::collect(const u64 frame, const u64 completedFrames) {
+  std::lock_guard _(_lock);
+
+  _frame = frame;
+  for (auto &table: _tables) {
+    while (!table.retired.empty() && table.retired.front().first <= completedFrames) {
+      table.free.push_back(table.retired.front().second);
+      table.retired.pop_front();
+    }
+  }
+}
+
+void leimu::render::Bindless::bind(
+    const VkCommandBuffer cmd,
+    const VkPipelineBindPoint bindPoint,
+    const VkPipelineLayout layout,
+    const u32 set) const {
+  vkCmdBindDescriptorSets(cmd, bindPoint, layout, set, 1, &_set, 0, nullptr);
+}
+
+leimu::render::PipelineLayout leimu::render::Bindless::createPipelineLayout(
+    const u32 pushConstantSize,
+    const VkShaderStageFlags stages) const noexcept {
+  std::vector<VkPushConstantRange> ranges;
+  if (pushConstantSize) {
+    ranges.push_back({stages, 0, pushConstantSize});
+  }
+  return CreatePipelineLayout(_device, {_layout.get()}, ranges);
+}
@@ -0,0 +1,56 @@
+#include "leimu/render/DeletionQueue.h"
+
+void leimu::render::DeletionQueue::retire(std::vector<std::shared_ptr<void>> handles) {
+  std::lock_guard _(_lock);
+  _frames.push_back({.frames = _frame + 1, .handles = std::move(handles)});
+}
+
+void leimu::render::DeletionQueue::retire(const u64 frames, std::vector<std::shared_ptr<void>> handles) {
+  std::lock_guard _(_lock);
+  _frames.push_back({.frames = frames, .handles = std::move(handles)});
+}
+
+void leimu::render::DeletionQueue::retire(
+    Timeline timeline,
+    const u64 value,
+    std::vector<std::shared_ptr<void>> handles) {
+  std::lock_guard _(_lock);
+  _timelines.push_back({.timeline = std::move(timeline), .value = value, .handles = std::move(handles)});
+}
+
+void leimu::render::DeletionQueue::collect(const u64 frame, const u64 completedFrames) {
+  // Deleters run outside the lock; they may take a while, or retire something themselves
+  std::vector<std::shared_ptr<void>> released;
+
+  {
+    std::lock_guard _(_lock);
+    _frame = frame;
+
+    const auto frames = std::ranges::partition(_frames, [completedFrames](const feature::VkRetired_T &retired) {
+      return retired.frames > completedFrames;
+    });
+    for (auto &retired: frames) {
+      std::ranges::move(retired.handles, std::back_inserter(released));
+    }
+    _frames.erase(frames.begin(), frames.end());
+
+    const auto timelines = std::ranges::partition(_timelines, [](const TimelineRetired &retired) {
+      return !retired.timeline->completed(retired.value);
+    });
+    for (auto &retired: timelines) {
+      std::ranges::move(retired.handles, std::back_inserter(released));
+    }
+    _timelines.erase(timelines.begin(), timelines.end());
+  }
+}
+
+void leimu::render::DeletionQueue::flush() {
+  std::vector<feature::VkRetired_T> frames;
+  std::vector<TimelineRetired> timelines;
+
+  {
+    std::lock_guard _(_lock);
+    frames.swap(_frames);
+    timelines.swap(_timelines);
+  }
+}
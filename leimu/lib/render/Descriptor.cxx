@@ -0,0 +1,201 @@
+#include "leimu/render/Descriptor.h"
+#include "leimu/hash.h"
+
+constexpr u32 InitialSetsPerPool = 256;
+constexpr u32 MaxSetsPerPool = 4096;
+
+// descriptors per set, by type
+constexpr std::pair<VkDescriptorType, f32> PoolRatios[] = {
+    {VK_DESCRIPTOR_TYPE_SAMPLER,                0.5f},
+    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f},
+    {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,          4.0f},
+    {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          1.0f},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         2.0f},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         2.0f},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f},
+    {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,       0.5f},
+};
+
+static bool operator==(const VkDescriptorSetLayoutBinding &a, const VkDescriptorSetLayoutBinding &b) {
+  return a.binding == b.binding &&
+         a.descriptorType == b.descriptorType &&
+         a.descriptorCount == b.descriptorCount &&
+         a.stageFlags == b.stageFlags;
+}
+
+leimu::render::DescriptorSetLayout leimu::render::DescriptorLayoutCache::get(
+    const std::span<const VkDescriptorSetLayoutBinding> bindings,
+    const VkDescriptorSetLayoutCreateFlags flags,
+    const std::span<const VkDescriptorBindingFlags> bindingFlags) noexcept {
+
+  assert(bindingFlags.empty() || bindingFlags.size() == bindings.size());
+
+  // Sorted by binding, taking the flags along
+  std::vector<u32> order(bindings.size());
+  std::iota(order.begin(), order.end(), 0u);
+  std::ranges::sort(order, {}, [&bindings](const u32 i) { return bindings[i].binding; });
+
+  std::vector<VkDescriptorSetLayoutBinding> sorted;
+  std::vector<VkDescriptorBindingFlags> sortedFlags;
+  for (const auto i: order) {
+    sorted.push_back(bindings[i]);
+    if (!bindingFlags.empty()) {
+      sortedFlags.push_back(bindingFlags[i]);
+    }
+  }
+
+  // Bindings are hashed field by field; the struct has padding and a pointer
+  u64 hash = flags;
+  for (const auto &binding: sorted) {
+    hash = HashCombine(hash, binding.binding);
+    hash = HashCombine(hash, binding.descriptorType);
+    hash = HashCombine(hash, binding.descriptorCount);
+    hash = HashCombine(hash, binding.stageFlags);
+  }
+  hash = HashCombine(hash, sortedFlags.size());
+  for (const auto bindingFlag: sortedFlags) {
+    hash = HashCombine(hash, bindingFlag);
+  }
+
+  std::lock_guard _(_lock);
+
+  auto &bucket = _layouts[hash];
+  for (const auto &entry: bucket) {
+    if (entry.flags == flags && std::ranges::equal(entry.bindings, sorted) && entry.bindingFlags == sortedFlags) {
+      return entry.layout;
+    }
+  }
+
+  const VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+      .bindingCount = static_cast<u32>(sortedFlags.size()),
+      .pBindingFlags = sortedFlags.data(),
+  };
+  VkDescriptorSetLayoutCreateInfo createInfo{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .pNext = sortedFlags.empty() ? nullptr : &bindingFlagsInfo,
+      .flags = flags,
+      .bindingCount = static_cast<u32>(sorted.size()),
+      .pBindings = sorted.data(),
+  };
+
+  VkDescriptorSetLayout layout;
+  if (vkCreateDescriptorSetLayout(_device.get(), &createInfo, nullptr, &layout) != VK_SUCCESS) {
+    std::println(errs(), "[descriptor] Couldn't create descriptor set layout");
+    return nullptr;
+  }
+
+  DescriptorSetLayout result{
+      layout, [device = _device](const VkDescriptorSetLayout self) {
+        vkDestroyDescriptorSetLayout(device.get(), self, nullptr);
+      }
+  };
+  bucket.emplace_back(std::move(sorted), std::move(sortedFlags), flags, result);
+  return result;
+}
+
+leimu::render::DescriptorAllocator::DescriptorAllocator(
+    feature::VulkanDevice device,
+    const u32 framesInFlight) noexcept
+  : _device(std::move(device)),
+    _layouts(_device) {
+
+  for (u32 i = 0; i < std::max(framesInFlight, 1u); ++i) {
+    auto slot = std::make_unique<Slot>();
+    slot->setsPerPool = InitialSetsPerPool;
+    _slots.push_back(std::move(slot));
+  }
+}
+
+leimu::render::DescriptorPool leimu::render::DescriptorAllocator::createPool(const u32 sets) const noexcept {
+  std::vector<VkDescriptorPoolSize> sizes;
+  sizes.reserve(std::size(PoolRatios));
+  for (const auto &[type, ratio]: PoolRatios) {
+    sizes.push_back(
+        {
+            .type = type,
+            .descriptorCount = static_cast<u32>(ratio * static_cast<f32>(sets)),
+        });
+  }
+
+  VkDescriptorPoolCreateInfo createInfo{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .flags = 0,
+      .maxSets = sets,
+      .poolSizeCount = static_cast<u32>(sizes.size()),
+      .pPoolSizes = sizes.data(),
+  };
+
+  VkDescriptorPool pool;
+  if (vkCreateDescriptorPool(_device.get(), &createInfo, nullptr, &pool) != VK_SUCCESS) {
+    std::println(errs(), "[descriptor] Couldn't create descriptor pool of {} sets", sets);
+    return nullptr;
+  }
+
+  return {
+      pool, [device = _device](const VkDescriptorPool self) {
+        vkDestroyDescriptorPool(device.get(), self, nullptr);
+      }
+  };
+}
+
+VkDescriptorSet leimu::render::DescriptorAllocator::allocate(const u32 slot, const VkDescriptorSetLayout layout) noexcept {
+  auto &pools = *_slots[slot % _slots.size()];
+  std::lock_guard _(pools.lock);
+
+  VkDescriptorSetAllocateInfo allocInfo{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .descriptorSetCount = 1,
+      .pSetLayouts = &layout,
+  };
+
+  // The newest pool is the only one which may still have room
+  if (!pools.used.empty()) {
+    allocInfo.descriptorPool = pools.used.back().get();
+
+    VkDescriptorSet set;
+    const auto result = vkAllocateDescriptorSets(_device.get(), &allocInfo, &set);
+    if (result == VK_SUCCESS) {
+      return set;
+    }
+    if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+      std::println(errs(), "[descriptor] Couldn't allocate descriptor set ({})", static_cast<i32>(result));
+      return VK_NULL_HANDLE;
+    }
+  }
+
+  DescriptorPool pool;
+  if (!pools.ready.empty()) {
+    pool = std::move(pools.ready.back());
+    pools.ready.pop_back();
+  } else {
+    if (!((pool = createPool(pools.setsPerPool)))) {
+      return VK_NULL_HANDLE;
+    }
+    // Grow geometrically so that a heavy frame settles on a few large pools
+    pools.setsPerPool = std::min(pools.setsPerPool * 2, MaxSetsPerPool);
+  }
+  pools.used.push_back(pool);
+
+  allocInfo.descriptorPool = pool.get();
+
+  VkDescriptorSet set;
+  if (const auto result = vkAllocateDescriptorSets(_device.get(), &allocInfo, &set); result != VK_SUCCESS) {
+    std::println(errs(), "[descriptor] Couldn't allocate descriptor set from fresh pool ({})", static_cast<i32>(result));
+    return VK_NULL_HANDLE;
+  }
+
+  return set;
+}
+
+void leimu::render::DescriptorAllocator::reset(const u32 slot) noexcept {
+  auto &pools = *_slots[slot % _slots.size()];
+  std::lock_guard _(pools.lock);
+
+  for (auto &pool: pools.used) {
+    vkResetDescriptorPool(_device.get(), pool.get(), 0);
+    pools.ready.push_back(std::move(pool));
+  }
+  pools.used.clear();
+}
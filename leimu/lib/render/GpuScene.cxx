@@ -0,0 +1,368 @@
+#include "leimu/render/GpuScene.h"
+#include "leimu/trace.h"
+
+namespace {
+  constexpr u32 WorkgroupSize = 64;
+
+  leimu::memory::Buffer CreateDeviceBuffer(
+      leimu::memory::Allocator &allocator,
+      const VkDeviceSize size,
+      const VkBufferUsageFlags usage) noexcept {
+    const VkBufferCreateInfo createInfo{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    return allocator.createBuffer(createInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  }
+
+  /**
+   * Gribb-Hartmann; clip-space depth is [0, w]
+   */
+  std::array<glm::vec4, 6> GetFrustumPlanes(const glm::mat4 &m) {
+    const auto row = [&m](const int i) {
+      return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+    };
+
+    std::array planes{
+        row(3) + row(0),
+        row(3) - row(0),
+        row(3) + row(1),
+        row(3) - row(1),
+        row(2),
+        row(3) - row(2),
+    };
+    for (auto &plane: planes) {
+      plane /= glm::length(glm::vec3(plane));
+    }
+    return planes;
+  }
+}
+
+leimu::render::GpuScene::GpuScene(
+    const feature::Vulkan &vulkan,
+    PipelineCompiler &compiler,
+    const u32 capacity,
+    const u32 meshCapacity,
+    std::filesystem::path shader) noexcept
+  : _device(vulkan.device()),
+    _capabilities(vulkan.capabilities()),
+    _allocator(vulkan.allocator()),
+    _descriptors(vulkan.descriptors()),
+    _capacity(capacity),
+    _meshCapacity(meshCapacity),
+    _staging(vulkan.frames().size()) {
+
+  if (!_capabilities->drawIndirectFirstInstance) {
+    std::println(errs(), "[scene] Device can't draw indirectly with non-zero firstInstance");
+    return;
+  }
+
+  // A draw count above one needs multiDrawIndirect, whichever way it is given
+  _indirectCount = _capabilities->cmdDrawIndexedIndirectCount && _capabilities->multiDrawIndirect;
+  if (_capabilities->multiDrawIndirect && _capacity > _capabilities->maxDrawIndirectCount) {
+    std::println(
+        warns(), "[scene] Capacity of {} objects clamped to the device's {}",
+        _capacity, _capabilities->maxDrawIndirectCount);
+    _capacity = _capabilities->maxDrawIndirectCount;
+  }
+
+  constexpr auto Storage = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  const std::array<VkDescriptorSetLayoutBinding, 4> cullBindings{
+      {
+          {0, Storage, 1, VK_SHADER_STAGE_COMPUTE_BIT},
+          {1, Storage, 1, VK_SHADER_STAGE_COMPUTE_BIT},
+          {2, Storage, 1, VK_SHADER_STAGE_COMPUTE_BIT},
+          {3, Storage, 1, VK_SHADER_STAGE_COMPUTE_BIT},
+      }
+  };
+  const VkDescriptorSetLayoutBinding drawBinding{0, Storage, 1, VK_SHADER_STAGE_VERTEX_BIT};
+
+  _cullLayout = _descriptors->layouts().get(cullBindings);
+  _drawLayout = _descriptors->layouts().get({&drawBinding, 1});
+  if (!_cullLayout || !_drawLayout) {
+    std::println(errs(), "[scene] Couldn't create descriptor set layouts");
+    return;
+  }
+
+  _pipelineLayout = CreatePipelineLayout(
+      _device,
+      {_cullLayout.get()},
+      {{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants)}});
+  if (!_pipelineLayout) {
+    return;
+  }
+
+  if (shader.empty()) {
+    shader = std::filesystem::path(LEIMU_SHADER_DIR) / "cull.comp.spv";
+  }
+  _pipeline = compiler.compile(ComputePipelineDesc{std::move(shader), _pipelineLayout});
+
+  _instanceBuffer = CreateDeviceBuffer(
+      *_allocator, sizeof(DrawInstance) * _capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  _meshBuffer = CreateDeviceBuffer(
+      *_allocator, sizeof(DrawMesh) * meshCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  _countBuffer = CreateDeviceBuffer(
+      *_allocator, sizeof(u32), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+  if (!_instanceBuffer || !_meshBuffer || !_countBuffer) {
+    std::println(errs(), "[scene] Couldn't create scene buffers for {} objects", _capacity);
+    return;
+  }
+
+  // Created last, as operator! checks it
+  if (!((_commandBuffer = CreateDeviceBuffer(
+    *_allocator,
+    sizeof(VkDrawIndexedIndirectCommand) * _capacity,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT)))) {
+    std::println(errs(), "[scene] Couldn't create draw command buffer for {} objects", _capacity);
+    return;
+  }
+
+  std::println(
+      outs(),
+      "[scene] {} objects, {}",
+      _capacity,
+      _indirectCount ? "indirect count" : "fixed-count indirect draws");
+}
+
+u32 leimu::render::GpuScene::addMesh(const DrawMesh &mesh) {
+  if (_meshes.size() >= _meshCapacity) {
+    std::println(errs(), "[scene] Mesh capacity of {} exceeded", _meshCapacity);
+    return NoMesh;
+  }
+
+  _meshes.push_back(mesh);
+  return static_cast<u32>(_meshes.size() - 1);
+}
+
+void leimu::render::GpuScene::touch(const u32 id) {
+  if (!_isDirty[id]) {
+    _isDirty[id] = true;
+    _dirty.push_back(id);
+  }
+}
+
+u32 leimu::render::GpuScene::add(const DrawInstance &instance) {
+  u32 id;
+  if (!_free.empty()) {
+    id = _free.back();
+    _free.pop_back();
+  } else if (_instances.size() < _capacity) {
+    id = static_cast<u32>(_instances.size());
+    _instances.emplace_back();
+    _isDirty.push_back(false);
+  } else {
+    std::println(errs(), "[scene] Object capacity of {} exceeded", _capacity);
+    return NoInstance;
+  }
+
+  set(id, instance);
+  return id;
+}
+
+void leimu::render::GpuScene::set(const u32 id, const DrawInstance &instance) {
+  assert(id < _instances.size() && instance.mesh < _meshes.size());
+  _instances[id] = instance;
+  touch(id);
+}
+
+void leimu::render::GpuScene::remove(const u32 id) {
+  assert(id < _instances.size() && _instances[id].mesh != NoMesh);
+  // The slot stays in the buffer; the cull shader skips it
+  _instances[id].mesh = NoMesh;
+  _free.push_back(id);
+  touch(id);
+}
+
+bool leimu::render::GpuScene::upload(const VkCommandBuffer cmd, const u32 slot) noexcept {
+  const auto meshes = _meshes.size() - _uploadedMeshes;
+  const auto size = _dirty.size() * sizeof(DrawInstance) + meshes * sizeof(DrawMesh);
+  if (!size) {
+    return true;
+  }
+
+  // The slot's fence has signaled, so its staging buffer is free to be rewritten or replaced
+  auto &staging = _staging[slot];
+  if (!staging || staging->size < size) {
+    const VkBufferCreateInfo createInfo{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = std::bit_ceil(size),
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    staging = _allocator->createBuffer(
+        createInfo,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (!staging || !staging->allocation->mapped()) {
+      std::println(errs(), "[scene] Couldn't create staging buffer of {} KiB", size >> 10);
+      staging = nullptr;
+      return false;
+    }
+  }
+
+  const auto mapped = static_cast<u8 *>(staging->allocation->mapped());
+  VkDeviceSize offset = 0;
+
+  // Sorted so that neighbouring objects are copied as one region
+  std::ranges::sort(_dirty);
+  std::vector<VkBufferCopy> regions;
+  for (const auto id: _dirty) {
+    memcpy(mapped + offset, &_instances[id], sizeof(DrawInstance));
+    _isDirty[id] = false;
+
+    const auto dst = static_cast<VkDeviceSize>(id) * sizeof(DrawInstance);
+    if (!regions.empty() &&
+        regions.back().dstOffset + regions.back().size == dst &&
+        regions.back().srcOffset + regions.back().size == offset) {
+      regions.back().size += sizeof(DrawInstance);
+    } else {
+      regions.push_back({offset, dst, sizeof(DrawInstance)});
+    }
+    offset += sizeof(DrawInstance);
+  }
+  _dirty.clear();
+
+  if (!regions.empty()) {
+    vkCmdCopyBuffer(cmd, staging->handle, _instanceBuffer->handle, static_cast<u32>(regions.size()), regions.data());
+  }
+
+  if (meshes) {
+    memcpy(mapped + offset, &_meshes[_uploadedMeshes], meshes * sizeof(DrawMesh));
+    const VkBufferCopy region{offset, _uploadedMeshes * sizeof(DrawMesh), meshes * sizeof(DrawMesh)};
+    vkCmdCopyBuffer(cmd, staging->handle, _meshBuffer->handle, 1, &region);
+    _uploadedMeshes = static_cast<u32>(_meshes.size());
+  }
+
+  return true;
+}
+
+void leimu::render::GpuScene::cull(const feature::VkFrame_T &frame, const glm::mat4 &viewProjection) noexcept {
+  LEIMU_ZONE("scene: cull");
+
+  _culled = false;
+  if (!*this) {
+    return;
+  }
+
+  const auto cmd = frame.commandBuffer;
+  const auto count = static_cast<u32>(_instances.size());
+
+  // Earlier frames may still read what this one overwrites
+  VkMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  vkCmdPipelineBarrier(
+      cmd,
+      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+  if (!upload(cmd, frame.index)) {
+    return;
+  }
+
+  vkCmdFillBuffer(cmd, _countBuffer->handle, 0, sizeof(u32), 0);
+  if (!_indirectCount && count) {
+    // Every slot is drawn; those left over must draw nothing
+    vkCmdFillBuffer(cmd, _commandBuffer->handle, 0, count * sizeof(VkDrawIndexedIndirectCommand), 0);
+  }
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(
+      cmd,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+      0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+  const auto pipeline = _pipeline->get(nullptr);
+  if (!pipeline || !count) {
+    return;
+  }
+
+  const auto set = _descriptors->allocate(frame.index, _cullLayout.get());
+  if (!set) {
+    return;
+  }
+
+  const std::array<VkDescriptorBufferInfo, 4> buffers{
+      {
+          {_instanceBuffer->handle, 0, VK_WHOLE_SIZE},
+          {_meshBuffer->handle, 0, VK_WHOLE_SIZE},
+          {_commandBuffer->handle, 0, VK_WHOLE_SIZE},
+          {_countBuffer->handle, 0, VK_WHOLE_SIZE},
+      }
+  };
+  std::array<VkWriteDescriptorSet, 4> writes{};
+  for (u32 i = 0; i < writes.size(); ++i) {
+    writes[i] = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = set,
+        .dstBinding = i,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo = &buffers[i],
+    };
+  }
+  vkUpdateDescriptorSets(_device.get(), writes.size(), writes.data(), 0, nullptr);
+
+  const PushConstants constants{GetFrustumPlanes(viewProjection), count};
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.get());
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout.get(), 0, 1, &set, 0, nullptr);
+  vkCmdPushConstants(
+      cmd, _pipelineLayout.get(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+  vkCmdDispatch(cmd, (count + WorkgroupSize - 1) / WorkgroupSize, 1, 1);
+
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  vkCmdPipelineBarrier(
+      cmd,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+      0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+  _culled = true;
+}
+
+void leimu::render::GpuScene::draw(
+    const feature::VkFrame_T &frame,
+    const PipelineLayout &layout,
+    const u32 set) noexcept {
+
+  // Nothing is drawn until the cull pipeline has compiled
+  if (!_culled) {
+    return;
+  }
+
+  const auto cmd = frame.commandBuffer;
+  const auto count = static_cast<u32>(_instances.size());
+  constexpr auto stride = static_cast<u32>(sizeof(VkDrawIndexedIndirectCommand));
+
+  const auto descriptor = _descriptors->allocate(frame.index, _drawLayout.get());
+  if (!descriptor) {
+    return;
+  }
+
+  const VkDescriptorBufferInfo buffer{_instanceBuffer->handle, 0, VK_WHOLE_SIZE};
+  const VkWriteDescriptorSet write{
+      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+      .dstSet = descriptor,
+      .dstBinding = 0,
+      .descriptorCount = 1,
+      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .pBufferInfo = &buffer,
+  };
+  vkUpdateDescriptorSets(_device.get(), 1, &write, 0, nullptr);
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout.get(), set, 1, &descriptor, 0, nullptr);
+
+  if (_indirectCount) {
+    _capabilities->cmdDrawIndexedIndirectCount(
+        cmd, _commandBuffer->handle, 0, _countBuffer->handle, 0, count, stride);
+  } else if (_capabilities->multiDrawIndirect) {
+    vkCmdDrawIndexedIndirect(cmd, _commandBuffer->handle, 0, count, stride);
+  } else {
+    for (u32 i = 0; i < count; ++i) {
+      vkCmdDrawIndexedIndirect(cmd, _commandBuffer->handle, i * stride, 1, stride);
+    }
+  }
+}
@@ -0,0 +1,250 @@
+#include "leimu/render/Ktx2.h"
+#include "leimu/logging.h"
+
+// KTX2 is little-endian, as is every platform leimu runs on; fields are read and written with memcpy
+
+namespace {
+  constexpr std::array<u8, 12> Identifier{0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+  struct Header {
+    u32 format;
+    u32 typeSize;
+    u32 width;
+    u32 height;
+    u32 depth;
+    u32 layerCount;
+    u32 faceCount;
+    u32 levelCount;
+    u32 supercompressionScheme;
+
+    u32 dfdByteOffset;
+    u32 dfdByteLength;
+    u32 kvdByteOffset;
+    u32 kvdByteLength;
+    // 64-bit offset and length, split since the header leaves them unaligned
+    std::array<u32, 4> sgd;
+  };
+  static_assert(sizeof(Header) == 68);
+
+  struct LevelIndex {
+    u64 byteOffset;
+    u64 byteLength;
+    u64 uncompressedByteLength;
+  };
+  static_assert(sizeof(LevelIndex) == 24);
+
+  constexpr VkDeviceSize HeaderSize = Identifier.size() + sizeof(Header);
+
+  struct Sample {
+    u16 bitOffset;
+    u8 channel;
+  };
+
+  struct FormatInfo {
+    VkFormat format;
+    // KHR_DF_MODEL_*
+    u8 model;
+    u8 blockBytes;
+    bool srgb;
+    std::vector<Sample> samples;
+  };
+
+  const std::vector<FormatInfo> &GetFormats() {
+    static const std::vector<FormatInfo> formats{
+        {VK_FORMAT_BC1_RGB_UNORM_BLOCK, 128, 8, false, {{0, 0}}},
+        {VK_FORMAT_BC1_RGB_SRGB_BLOCK, 128, 8, true, {{0, 0}}},
+        {VK_FORMAT_BC3_UNORM_BLOCK, 130, 16, false, {{0, 15}, {64, 0}}},
+        {VK_FORMAT_BC3_SRGB_BLOCK, 130, 16, true, {{0, 15}, {64, 0}}},
+        {VK_FORMAT_BC4_UNORM_BLOCK, 131, 8, false, {{0, 0}}},
+        {VK_FORMAT_BC5_UNORM_BLOCK, 132, 16, false, {{0, 0}, {64, 1}}},
+    };
+    return formats;
+  }
+
+  template<typename T>
+  void Append(std::vector<u8> &out, const T &value) {
+    const auto p = reinterpret_cast<const u8 *>(&value);
+    out.insert(out.end(), p, p + sizeof(T));
+  }
+
+  // 0 for anything but BCn; those are all the textures are cooked to
+  u32 GetBlockBytes(const VkFormat format) {
+    switch (format) {
+      case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+      case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+      case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+      case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+      case VK_FORMAT_BC4_UNORM_BLOCK:
+      case VK_FORMAT_BC4_SNORM_BLOCK:
+        return 8;
+      case VK_FORMAT_BC2_UNORM_BLOCK:
+      case VK_FORMAT_BC2_SRGB_BLOCK:
+      case VK_FORMAT_BC3_UNORM_BLOCK:
+      case VK_FORMAT_BC3_SRGB_BLOCK:
+      case VK_FORMAT_BC5_UNORM_BLOCK:
+      case VK_FORMAT_BC5_SNORM_BLOCK:
+      case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+      case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+      case VK_FORMAT_BC7_UNORM_BLOCK:
+      case VK_FORMAT_BC7_SRGB_BLOCK:
+        return 16;
+      default:
+        return 0;
+    }
+  }
+
+  VkDeviceSize Align(const VkDeviceSize value, const VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+  }
+}
+
+std::optional<leimu::render::Ktx2> leimu::render::ParseKtx2(const std::span<const u8> data) noexcept {
+  if (data.size() < HeaderSize || !std::equal(Identifier.begin(), Identifier.end(), data.begin())) {
+    std::println(errs(), "[ktx2] Not a KTX2 file");
+    return std::nullopt;
+  }
+
+  Header header;
+  memcpy(&header, data.data() + Identifier.size(), sizeof(header));
+
+  if (header.format == VK_FORMAT_UNDEFINED) {
+    std::println(errs(), "[ktx2] Universal (Basis) textures aren't supported; cook with a Vulkan format instead");
+    return std::nullopt;
+  }
+  if (header.supercompressionScheme) {
+    std::println(errs(), "[ktx2] Supercompression scheme {} isn't supported", header.supercompressionScheme);
+    return std::nullopt;
+  }
+  if (!header.width || !header.height || header.depth || header.layerCount > 1 || header.faceCount != 1) {
+    std::println(errs(), "[ktx2] Only single-layer 2D textures are supported");
+    return std::nullopt;
+  }
+
+  const auto blockBytes = GetBlockBytes(static_cast<VkFormat>(header.format));
+  if (!blockBytes) {
+    std::println(errs(), "[ktx2] Format {} isn't block-compressed", header.format);
+    return std::nullopt;
+  }
+
+  // A level count of zero asks the loader to generate mips, which block-compressed data can't have
+  const auto levelCount = std::max(header.levelCount, 1u);
+  if (levelCount > static_cast<u32>(std::bit_width(std::max(header.width, header.height)))) {
+    std::println(errs(), "[ktx2] {} levels are more than a {}x{} texture has", levelCount, header.width, header.height);
+    return std::nullopt;
+  }
+  if (data.size() < HeaderSize + levelCount * sizeof(LevelIndex)) {
+    std::println(errs(), "[ktx2] Level index is truncated");
+    return std::nullopt;
+  }
+
+  Ktx2 ktx{
+      .format = static_cast<VkFormat>(header.format),
+      .extent = {header.width, header.height, 1},
+  };
+  ktx.levels.reserve(levelCount);
+  for (u32 i = 0; i < levelCount; ++i) {
+    LevelIndex index;
+    memcpy(&index, data.data() + HeaderSize + i * sizeof(LevelIndex), sizeof(index));
+    if (index.byteOffset > data.size() || index.byteLength > data.size() - index.byteOffset) {
+      std::println(errs(), "[ktx2] Level {} lies outside of the file", i);
+      return std::nullopt;
+    }
+
+    // The copy reads this much regardless of what the index claims
+    const VkDeviceSize width = std::max(header.width >> i, 1u);
+    const VkDeviceSize height = std::max(header.height >> i, 1u);
+    if (const auto expected = (width + 3) / 4 * ((height + 3) / 4) * blockBytes; index.byteLength < expected) {
+      std::println(errs(), "[ktx2] Level {} holds {} bytes instead of {}", i, index.byteLength, expected);
+      return std::nullopt;
+    }
+    ktx.levels.push_back({index.byteOffset, index.byteLength});
+  }
+
+  return ktx;
+}
+
+bool leimu::render::WriteKtx2(
+    const std::filesystem::path &path,
+    const VkFormat format,
+    const VkExtent2D extent,
+    const std::span<const std::vector<u8>> levels) noexcept {
+
+  const auto &formats = GetFormats();
+  const auto info = std::ranges::find(formats, format, &FormatInfo::format);
+  if (info == formats.end()) {
+    std::println(errs(), "[ktx2] Format {} can't be written", static_cast<u32>(format));
+    return false;
+  }
+
+  // Basic data format descriptor
+  std::vector<u8> dfd;
+  const auto blockSize = static_cast<u16>(24 + 16 * info->samples.size());
+  Append<u32>(dfd, 4 + blockSize);
+  Append<u32>(dfd, 0);                 // vendor: Khronos, type: basic
+  Append<u16>(dfd, 2);                 // version
+  Append<u16>(dfd, blockSize);
+  Append<u8>(dfd, info->model);
+  Append<u8>(dfd, 1);                  // BT.709 primaries
+  Append<u8>(dfd, info->srgb ? 2 : 1); // sRGB or linear transfer
+  Append<u8>(dfd, 0);                  // straight alpha
+  for (const u8 dimension: {3, 3, 0, 0}) {
+    Append<u8>(dfd, dimension);        // 4x4 blocks
+  }
+  Append<u8>(dfd, info->blockBytes);
+  for (auto i = 0; i < 7; ++i) {
+    Append<u8>(dfd, 0);
+  }
+  for (const auto &[bitOffset, channel]: info->samples) {
+    Append<u16>(dfd, bitOffset);
+    Append<u8>(dfd, 63);               // 64 bits
+    Append<u8>(dfd, channel);
+    Append<u32>(dfd, 0);               // sample position
+    Append<u32>(dfd, 0);
+    Append<u32>(dfd, UINT32_MAX);
+  }
+
+  const auto dfdOffset = HeaderSize + levels.size() * sizeof(LevelIndex);
+  const Header header{
+      .format = static_cast<u32>(format),
+      .typeSize = 1,
+      .width = extent.width,
+      .height = extent.height,
+      .depth = 0,
+      .layerCount = 0,
+      .faceCount = 1,
+      .levelCount = static_cast<u32>(levels.size()),
+      .supercompressionScheme = 0,
+      .dfdByteOffset = static_cast<u32>(dfdOffset),
+      .dfdByteLength = static_cast<u32>(dfd.size()),
+  };
+
+  // Levels are stored smallest first, each aligned to lcm(block size, 4)
+  std::vector<LevelIndex> index(levels.size());
+  auto offset = dfdOffset + dfd.size();
+  for (auto i = levels.size(); i-- > 0;) {
+    offset = Align(offset, info->blockBytes);
+    index[i] = {offset, levels[i].size(), levels[i].size()};
+    offset += levels[i].size();
+  }
+
+  std::vector<u8> out;
+  out.reserve(offset);
+  out.insert(out.end(), Identifier.begin(), Identifier.end());
+  Append(out, header);
+  for (const auto &level: index) {
+    Append(out, level);
+  }
+  out.insert(out.end(), dfd.begin(), dfd.end());
+  for (auto i = levels.size(); i-- > 0;) {
+    out.resize(index[i].byteOffset);
+    out.insert(out.end(), levels[i].begin(), levels[i].end());
+  }
+
+  std::ofstream file(path, std::ios::binary);
+  if (!file.write(reinterpret_cast<const char *>(out.data()), static_cast<std::streamsize>(out.size()))) {
+    std::println(errs(), "[ktx2] Couldn't write '{}'", path.string());
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,140 @@
+#include "leimu/render/Overlay.h"
+
+leimu::render::Overlay::Overlay(const feature::GLFW &glfw, const feature::Vulkan &vulkan) noexcept
+  : _device(vulkan.device()),
+    _deletion(vulkan.deletion()) {
+
+  if (glfw.headless() || !glfw.window() || !vulkan) {
+    return;
+  }
+
+  const auto &device = _device;
+
+  // Font atlas only, plus headroom for user textures
+  const VkDescriptorPoolSize size{
+      .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+      .descriptorCount = 16,
+  };
+  VkDescriptorPoolCreateInfo createInfo{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+      .maxSets = 16,
+      .poolSizeCount = 1,
+      .pPoolSizes = &size,
+  };
+
+  VkDescriptorPool pool;
+  if (vkCreateDescriptorPool(device.get(), &createInfo, nullptr, &pool) != VK_SUCCESS) {
+    std::println(errs(), "[overlay] Couldn't create descriptor pool");
+    return;
+  }
+  _pool = {
+      pool, [device](const VkDescriptorPool self) {
+        vkDestroyDescriptorPool(device.get(), self, nullptr);
+      }
+  };
+
+  IMGUI_CHECKVERSION();
+  ImGui::CreateContext();
+  ImGui::GetIO().IniFilename = nullptr;
+  ImGui::StyleColorsDark();
+
+  if (!((_glfw = ImGui_ImplGlfw_InitForVulkan(glfw.window(), true)))) {
+    std::println(errs(), "[overlay] Couldn't initialize ImGui GLFW backend");
+    return;
+  }
+
+  // ImGui rotates its vertex buffers per frame; it has to have one per frame in flight at least
+  const auto nImage = std::max<u32>(
+      {2u, static_cast<u32>(vulkan.frames().size()), static_cast<u32>(vulkan.images().size())});
+
+  ImGui_ImplVulkan_InitInfo initInfo{};
+  initInfo.Instance = vulkan.instance().get();
+  initInfo.PhysicalDevice = vulkan.physicalDevice().get();
+  initInfo.Device = device.get();
+  initInfo.QueueFamily = vulkan.queueIndices()->graphicsQueue;
+  initInfo.Queue = vulkan.graphicsQueue().get();
+  initInfo.PipelineCache = vulkan.pipelineCache().get();
+  initInfo.DescriptorPool = _pool.get();
+  initInfo.RenderPass = vulkan.renderPass().get();
+  initInfo.Subpass = 0;
+  initInfo.MinImageCount = 2;
+  initInfo.ImageCount = nImage;
+  initInfo.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
+
+  if (!((_vulkan = ImGui_ImplVulkan_Init(&initInfo)))) {
+    std::println(errs(), "[overlay] Couldn't initialize ImGui Vulkan backend");
+  }
+}
+
+leimu::render::Overlay::~Overlay() {
+  const auto context = ImGui::GetCurrentContext();
+  if (!context) {
+    return;
+  }
+
+  // The window may be gone by the time the renderer is torn down
+  if (_glfw) {
+    ImGui_ImplGlfw_Shutdown();
+  }
+  if (!_vulkan) {
+    ImGui::DestroyContext(context);
+    return;
+  }
+
+  // Its buffers and font descriptor may still be read by frames in flight
+  _deletion->retire(
+      {
+          std::shared_ptr<void>(
+              context, [device = _device, pool = _pool](void *self) {
+                const auto context = static_cast<ImGuiContext *>(self);
+                const auto current = ImGui::GetCurrentContext();
+
+                ImGui::SetCurrentContext(context);
+                ImGui_ImplVulkan_Shutdown();
+                ImGui::SetCurrentContext(current);
+                // Restores current unless it is context
+                ImGui::DestroyContext(context);
+              })
+      });
+}
+
+void leimu::render::Overlay::draw(const VkCommandBuffer cmd, const Profiler &profiler) noexcept {
+  if (!_vulkan) {
+    return;
+  }
+
+  ImGui_ImplVulkan_NewFrame();
+  ImGui_ImplGlfw_NewFrame();
+  ImGui::NewFrame();
+
+  ImGui::SetNextWindowPos({8, 8}, ImGuiCond_FirstUseEver);
+  if (ImGui::Begin("Profiler", nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
+    ImGui::Text("CPU frame %.2f ms (avg %.2f ms)", profiler.cpuMs(), profiler.cpuAverageMs());
+
+    if (!profiler.enabled()) {
+      ImGui::TextDisabled("GPU profiling disabled");
+    } else if (ImGui::BeginTable("gpu", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+      ImGui::TableSetupColumn("GPU scope");
+      ImGui::TableSetupColumn("ms");
+      ImGui::TableSetupColumn("avg ms");
+      ImGui::TableHeadersRow();
+
+      for (const auto &[name, depth, ms, averageMs]: profiler.timings()) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text("%*s%s", static_cast<int>(depth * 2), "", name.c_str());
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", ms);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", averageMs);
+      }
+
+      ImGui::EndTable();
+    }
+  }
+  ImGui::End();
+
+  ImGui::Render();
+  ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
+}
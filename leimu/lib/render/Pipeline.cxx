@@ -0,0 +1,178 @@
+#include "leimu/render/Pipeline.h"
+#include "leimu/render/Shader.h"
+
+leimu::render::PipelineLayout leimu::render::CreatePipelineLayout(
+    const feature::VulkanDevice &device,
+    const std::vector<VkDescriptorSetLayout> &setLayouts,
+    const std::vector<VkPushConstantRange> &pushConstants) noexcept {
+
+  VkPipelineLayoutCreateInfo createInfo{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .setLayoutCount = static_cast<u32>(setLayouts.size()),
+      .pSetLayouts = setLayouts.data(),
+      .pushConstantRangeCount = static_cast<u32>(pushConstants.size()),
+      .pPushConstantRanges = pushConstants.data(),
+  };
+
+  VkPipelineLayout layout;
+  if (vkCreatePipelineLayout(device.get(), &createInfo, nullptr, &layout) != VK_SUCCESS) {
+    std::println(errs(), "[vulkan] Couldn't create pipeline layout");
+    return nullptr;
+  }
+
+  return {
+      layout, [=](const VkPipelineLayout self) {
+        vkDestroyPipelineLayout(device.get(), self, nullptr);
+      }
+  };
+}
+
+leimu::render::Pipeline leimu::render::CreateGraphicsPipeline(
+    const feature::VulkanDevice &device,
+    const feature::VulkanPipelineCache &cache,
+    const GraphicsPipelineDesc &desc) noexcept {
+
+  const auto vertex = CreateShaderFromFile(device, desc.vertex);
+  const auto fragment = CreateShaderFromFile(device, desc.fragment);
+  if (!vertex || !fragment) {
+    std::println(errs(), "[pipeline] Couldn't load shaders of '{}'", desc.vertex.string());
+    return nullptr;
+  }
+
+  const VkPipelineShaderStageCreateInfo stages[] = {
+      {
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+          .stage = VK_SHADER_STAGE_VERTEX_BIT,
+          .module = vertex.get(),
+          .pName = "main",
+      },
+      {
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+          .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+          .module = fragment.get(),
+          .pName = "main",
+      },
+  };
+
+  VkPipelineVertexInputStateCreateInfo vertexInput{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+      .vertexBindingDescriptionCount = static_cast<u32>(desc.bindings.size()),
+      .pVertexBindingDescriptions = desc.bindings.data(),
+      .vertexAttributeDescriptionCount = static_cast<u32>(desc.attributes.size()),
+      .pVertexAttributeDescriptions = desc.attributes.data(),
+  };
+
+  VkPipelineInputAssemblyStateCreateInfo inputAssembly{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+      .topology = desc.topology,
+      .primitiveRestartEnable = VK_FALSE,
+  };
+
+  VkPipelineViewportStateCreateInfo viewport{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+      .viewportCount = 1,
+      .scissorCount = 1,
+  };
+
+  VkPipelineRasterizationStateCreateInfo rasterization{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+      .polygonMode = VK_POLYGON_MODE_FILL,
+      .cullMode = desc.cullMode,
+      .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+      .lineWidth = 1.0f,
+  };
+
+  VkPipelineMultisampleStateCreateInfo multisample{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+      .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+  };
+
+  VkPipelineColorBlendAttachmentState blendAttachment{
+      .blendEnable = VK_FALSE,
+      .colorWriteMask = VK_COLOR_COMPONENT_R_BIT
+                        | VK_COLOR_COMPONENT_G_BIT
+                        | VK_COLOR_COMPONENT_B_BIT
+                        | VK_COLOR_COMPONENT_A_BIT,
+  };
+
+  VkPipelineColorBlendStateCreateInfo blend{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+      .attachmentCount = 1,
+      .pAttachments = &blendAttachment,
+  };
+
+  // Swapchain recreation must not invalidate pipelines
+  constexpr VkDynamicState dynamicStates[] = {
+      VK_DYNAMIC_STATE_VIEWPORT,
+      VK_DYNAMIC_STATE_SCISSOR,
+  };
+
+  VkPipelineDynamicStateCreateInfo dynamic{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+      .dynamicStateCount = static_cast<u32>(std::size(dynamicStates)),
+      .pDynamicStates = dynamicStates,
+  };
+
+  VkGraphicsPipelineCreateInfo createInfo{
+      .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+      .stageCount = static_cast<u32>(std::size(stages)),
+      .pStages = stages,
+      .pVertexInputState = &vertexInput,
+      .pInputAssemblyState = &inputAssembly,
+      .pViewportState = &viewport,
+      .pRasterizationState = &rasterization,
+      .pMultisampleState = &multisample,
+      .pColorBlendState = &blend,
+      .pDynamicState = &dynamic,
+      .layout = desc.layout.get(),
+      .renderPass = desc.renderPass.get(),
+      .subpass = desc.subpass,
+  };
+
+  VkPipeline pipeline;
+  if (vkCreateGraphicsPipelines(device.get(), cache.get(), 1, &createInfo, nullptr, &pipeline) != VK_SUCCESS) {
+    std::println(errs(), "[pipeline] Couldn't create graphics pipeline from '{}'", desc.vertex.string());
+    return nullptr;
+  }
+
+  return {
+      pipeline, [=](const VkPipeline self) {
+        vkDestroyPipeline(device.get(), self, nullptr);
+      }
+  };
+}
+
+leimu::render::Pipeline leimu::render::CreateComputePipeline(
+    const feature::VulkanDevice &device,
+    const feature::VulkanPipelineCache &cache,
+    const ComputePipelineDesc &desc) noexcept {
+
+  const auto shader = CreateShaderFromFile(device, desc.shader);
+  if (!shader) {
+    std::println(errs(), "[pipeline] Couldn't load shader '{}'", desc.shader.string());
+    return nullptr;
+  }
+
+  VkComputePipelineCreateInfo createInfo{
+      .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+      .stage = {
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+          .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+          .module = shader.get(),
+          .pName = "main",
+      },
+      .layout = desc.layout.get(),
+  };
+
+  VkPipeline pipeline;
+  if (vkCreateComputePipelines(device.get(), cache.get(), 1, &createInfo, nullptr, &pipeline) != VK_SUCCESS) {
+    std::println(errs(), "[pipeline] Couldn't create compute pipeline from '{}'", desc.shader.string());
+    return nullptr;
+  }
+
+  return {
+      pipeline, [=](const VkPipeline self) {
+        vkDestroyPipeline(device.get(), self, nullptr);
+      }
+  };
+}
@@ -0,0 +1,42 @@
+#include "leimu/render/PipelineCompiler.h"
+#include "leimu/trace.h"
+
+void leimu::render::AsyncPipeline_T::resolve(Pipeline pipeline) {
+  _pipeline = pipeline;
+  _ready.store(true, std::memory_order_release);
+  _promise.set_value(std::move(pipeline));
+}
+
+leimu::render::PipelineCompiler::PipelineCompiler(const feature::Vulkan &vulkan, job::Scheduler &jobs)
+  : _device(vulkan.device()),
+    _cache(vulkan.pipelineCache()),
+    _jobs(jobs) {
+}
+
+leimu::render::AsyncPipeline leimu::render::PipelineCompiler::compile(GraphicsPipelineDesc desc) {
+  auto pipeline = std::make_shared<AsyncPipeline_T>();
+  _jobs.background([device = _device, cache = _cache, pipeline, desc = std::move(desc)] {
+    LEIMU_ZONE("pipeline: compile graphics");
+    pipeline->resolve(CreateGraphicsPipeline(device, cache, desc));
+  });
+  return pipeline;
+}
+
+leimu::render::AsyncPipeline leimu::render::PipelineCompiler::compile(ComputePipelineDesc desc) {
+  auto pipeline = std::make_shared<AsyncPipeline_T>();
+  _jobs.background([device = _device, cache = _cache, pipeline, desc = std::move(desc)] {
+    LEIMU_ZONE("pipeline: compile compute");
+    pipeline->resolve(CreateComputePipeline(device, cache, desc));
+  });
+  return pipeline;
+}
+
+std::shared_future<leimu::render::Shader> leimu::render::PipelineCompiler::load(std::filesystem::path path) {
+  auto promise = std::make_shared<std::promise<Shader>>();
+  auto future = promise->get_future().share();
+  _jobs.background([device = _device, promise, path = std::move(path)] {
+    LEIMU_ZONE("pipeline: load shader");
+    promise->set_value(CreateShaderFromFile(device, path));
+  });
+  return future;
+}
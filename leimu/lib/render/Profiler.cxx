@@ -0,0 +1,159 @@
+#include "leimu/render/Profiler.h"
+
+// resolved frames a scope may go unseen before its average is dropped
+constexpr u64 AverageRetention = 256;
+
+leimu::render::Profiler::Profiler(
+    const feature::VulkanPhysicalDevice &phy,
+    feature::VulkanDevice device,
+    const u32 family,
+    const u32 framesInFlight,
+    const config::ProfilerConfig &config) noexcept
+  : _device(std::move(device)),
+    _capacity(std::max(config.maxScopes, 1u) * 2),
+    _averageWeight(1.0 / std::max(config.averageFrames, 1u)) {
+
+  if (!config.enabled) {
+    return;
+  }
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(phy.get(), &properties);
+  _period = properties.limits.timestampPeriod;
+
+  u32 nFamily;
+  vkGetPhysicalDeviceQueueFamilyProperties(phy.get(), &nFamily, nullptr);
+  std::vector<VkQueueFamilyProperties> families(nFamily);
+  vkGetPhysicalDeviceQueueFamilyProperties(phy.get(), &nFamily, families.data());
+
+  const auto validBits = family < nFamily ? families[family].timestampValidBits : 0;
+  if (!validBits) {
+    std::println(errs(), "[profiler] Graphics queue doesn't support timestamps; GPU profiling disabled");
+    return;
+  }
+  _mask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+
+  std::vector<Slot> slots(framesInFlight);
+  for (auto &slot: slots) {
+    VkQueryPoolCreateInfo createInfo{
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = _capacity,
+    };
+
+    VkQueryPool pool;
+    if (vkCreateQueryPool(_device.get(), &createInfo, nullptr, &pool) != VK_SUCCESS) {
+      std::println(errs(), "[profiler] Couldn't create timestamp query pool; GPU profiling disabled");
+      return;
+    }
+
+    slot.pool = {
+        pool, [device = _device](const VkQueryPool self) {
+          vkDestroyQueryPool(device.get(), self, nullptr);
+        }
+    };
+  }
+  _slots = std::move(slots);
+}
+
+void leimu::render::Profiler::begin(const feature::VkFrame_T &frame) noexcept {
+  const auto now = std::chrono::steady_clock::now();
+  if (_lastFrame != std::chrono::steady_clock::time_point{}) {
+    _cpuMs = std::chrono::duration<f64, std::milli>(now - _lastFrame).count();
+    _cpuAverageMs = _cpuAverageMs ? _cpuAverageMs + (_cpuMs - _cpuAverageMs) * _averageWeight : _cpuMs;
+  }
+  _lastFrame = now;
+
+  if (!enabled()) {
+    return;
+  }
+
+  auto &slot = _slots[frame.index];
+  if (slot.pending && slot.used) {
+    // The slot's fence has signaled, so every query is available and this doesn't wait
+    std::vector<u64> ticks(slot.used);
+    if (vkGetQueryPoolResults(
+        _device.get(),
+        slot.pool.get(),
+        0,
+        slot.used,
+        ticks.size() * sizeof(u64),
+        ticks.data(),
+        sizeof(u64),
+        VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+
+      _timings.clear();
+      ++_resolved;
+      for (const auto &[name, depth, begin]: slot.queries) {
+        const auto ms = static_cast<f64>((ticks[begin + 1] - ticks[begin]) & _mask) * _period / 1e6;
+
+        auto [average, inserted] = _averages.try_emplace(name, Average{ms, _resolved});
+        if (!inserted) {
+          average->second.ms += (ms - average->second.ms) * _averageWeight;
+          average->second.seen = _resolved;
+        }
+
+        _timings.push_back({name, depth, ms, average->second.ms});
+      }
+
+      // Scopes named after transient things, e.g. per-object passes, would pile up otherwise
+      std::erase_if(_averages, [this](const auto &average) {
+        return average.second.seen + AverageRetention < _resolved;
+      });
+    }
+  }
+
+  vkCmdResetQueryPool(frame.commandBuffer, slot.pool.get(), 0, _capacity);
+  slot.queries.clear();
+  slot.used = 0;
+  slot.pending = false;
+
+  _current = &slot;
+  _open.clear();
+  (void) push(frame.commandBuffer, "frame");
+}
+
+void leimu::render::Profiler::end(const feature::VkFrame_T &frame) noexcept {
+  if (!_current) {
+    return;
+  }
+
+  // Closes scopes left open along with the frame itself
+  while (!_open.empty()) {
+    pop(frame.commandBuffer);
+  }
+
+  _current->pending = true;
+  _current = nullptr;
+}
+
+u32 leimu::render::Profiler::push(const VkCommandBuffer cmd, std::string name) noexcept {
+  if (!_current || _current->used + 2 > _capacity) {
+    return UINT32_MAX;
+  }
+
+  auto &slot = *_current;
+  slot.queries.push_back({std::move(name), static_cast<u32>(_open.size()), slot.used});
+  vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot.pool.get(), slot.used);
+  slot.used += 2;
+
+  _open.push_back(static_cast<u32>(slot.queries.size() - 1));
+  return _open.back();
+}
+
+void leimu::render::Profiler::pop(const VkCommandBuffer cmd) noexcept {
+  if (!_current || _open.empty()) {
+    return;
+  }
+
+  const auto &query = _current->queries[_open.back()];
+  _open.pop_back();
+  vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _current->pool.get(), query.begin + 1);
+}
+
+leimu::render::Profiler::Scope leimu::render::Profiler::scope(const VkCommandBuffer cmd, std::string name) noexcept {
+  if (push(cmd, std::move(name)) == UINT32_MAX) {
+    return {nullptr, cmd};
+  }
+  return {this, cmd};
+}
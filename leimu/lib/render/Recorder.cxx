@@ -0,0 +1,97 @@
+#include "leimu/render/Recorder.h"
+
+leimu::render::Recorder::Recorder(const feature::Vulkan &vulkan, job::Scheduler &jobs)
+  : _device(vulkan.device()),
+    _family(vulkan.queueIndices() ? vulkan.queueIndices()->graphicsQueue : 0),
+    _jobs(jobs),
+    _slots(vulkan.frames().size()) {
+
+  for (auto &slot: _slots) {
+    slot.contexts.resize(_jobs.threads());
+  }
+}
+
+VkCommandBuffer leimu::render::Recorder::acquire(Context &context) const noexcept {
+  // Pools are created lazily, since most threads never record for most passes
+  if (!context.pool &&
+      !((context.pool = feature::CreateCommandPool(_device, _family, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT)))) {
+    return VK_NULL_HANDLE;
+  }
+
+  if (context.used == context.buffers.size()) {
+    VkCommandBufferAllocateInfo allocInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = context.pool.get(),
+        .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+        .commandBufferCount = 1,
+    };
+
+    VkCommandBuffer buffer;
+    if (vkAllocateCommandBuffers(_device.get(), &allocInfo, &buffer) != VK_SUCCESS) {
+      std::println(errs(), "[recorder] Couldn't allocate secondary command buffer");
+      return VK_NULL_HANDLE;
+    }
+    context.buffers.push_back(buffer);
+  }
+
+  return context.buffers[context.used++];
+}
+
+void leimu::render::Recorder::record(
+    const feature::VkFrame_T &frame,
+    const RecordTarget &target,
+    const std::span<const RecordTask> tasks) noexcept {
+
+  if (tasks.empty()) {
+    return;
+  }
+
+  auto &slot = _slots[frame.index];
+  if (slot.number != frame.number) {
+    // beginFrame waited on this slot's fence, so nothing recorded from these pools is pending
+    for (auto &context: slot.contexts) {
+      if (context.pool) {
+        vkResetCommandPool(_device.get(), context.pool.get(), 0);
+      }
+      context.used = 0;
+    }
+    slot.number = frame.number;
+  }
+
+  const VkCommandBufferInheritanceInfo inheritance{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+      .renderPass = target.renderPass,
+      .subpass = target.subpass,
+      .framebuffer = target.framebuffer,
+  };
+
+  const VkCommandBufferBeginInfo beginInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+      .pInheritanceInfo = &inheritance,
+  };
+
+  _results.assign(tasks.size(), VK_NULL_HANDLE);
+  _jobs.parallelFor(static_cast<u32>(tasks.size()), 1, [&](const u32 begin, const u32 end) {
+    // A thread runs one job at a time, so its context is never shared
+    auto &context = slot.contexts[job::Scheduler::index()];
+    for (auto i = begin; i < end; ++i) {
+      const auto buffer = acquire(context);
+      if (buffer && vkBeginCommandBuffer(buffer, &beginInfo) == VK_SUCCESS) {
+        tasks[i](buffer);
+        if (vkEndCommandBuffer(buffer) == VK_SUCCESS) {
+          _results[i] = buffer;
+          continue;
+        }
+      }
+
+      std::println(errs(), "[recorder] Couldn't record task #{}; it is skipped", i);
+    }
+  });
+
+  // Stitch in task order, independent of which thread recorded what
+  std::erase(_results, VK_NULL_HANDLE);
+  if (!_results.empty()) {
+    vkCmdExecuteCommands(frame.commandBuffer, static_cast<u32>(_results.size()), _results.data());
+  }
+}
@@ -0,0 +1,723 @@
+#include "leimu/render/RenderGraph.h"
+
+struct AccessInfo {
+  VkPipelineStageFlags stages;
+  VkAccessFlags access;
+  VkImageLayout layout;
+  VkImageUsageFlags imageUsage;
+  VkBufferUsageFlags bufferUsage;
+  bool write;
+};
+
+constexpr VkAccessFlags WriteAccess =
+    VK_ACCESS_SHADER_WRITE_BIT |
+    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_TRANSFER_WRITE_BIT |
+    VK_ACCESS_HOST_WRITE_BIT |
+    VK_ACCESS_MEMORY_WRITE_BIT;
+
+static AccessInfo GetAccessInfo(const leimu::render::Access access) {
+  using enum leimu::render::Access;
+
+  switch (access) {
+    case ColorAttachment:
+      return {
+          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+          VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+          VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+          VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 0,
+          true
+      };
+    case DepthAttachment:
+      return {
+          VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+          VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+          VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0,
+          true
+      };
+    case DepthRead:
+      return {
+          VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+          VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+          VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0,
+          false
+      };
+    case FragmentRead:
+      return {
+          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+          VK_ACCESS_SHADER_READ_BIT,
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+          VK_IMAGE_USAGE_SAMPLED_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+          false
+      };
+    case ComputeRead:
+      return {
+          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+          VK_ACCESS_SHADER_READ_BIT,
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+          VK_IMAGE_USAGE_SAMPLED_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+          false
+      };
+    case ComputeWrite:
+      return {
+          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+          VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+          VK_IMAGE_LAYOUT_GENERAL,
+          VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+          true
+      };
+    case TransferRead:
+      return {
+          VK_PIPELINE_STAGE_TRANSFER_BIT,
+          VK_ACCESS_TRANSFER_READ_BIT,
+          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+          VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+          false
+      };
+    case TransferWrite:
+      return {
+          VK_PIPELINE_STAGE_TRANSFER_BIT,
+          VK_ACCESS_TRANSFER_WRITE_BIT,
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+          true
+      };
+    case VertexInput:
+      return {
+          VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+          VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT,
+          VK_IMAGE_LAYOUT_UNDEFINED,
+          0, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+          false
+      };
+    case Uniform:
+      return {
+          VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+          VK_ACCESS_UNIFORM_READ_BIT,
+          VK_IMAGE_LAYOUT_UNDEFINED,
+          0, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+          false
+      };
+    case Indirect:
+      return {
+          VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+          VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+          VK_IMAGE_LAYOUT_UNDEFINED,
+          0, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+          false
+      };
+  }
+
+  std::unreachable();
+}
+
+static VkImageAspectFlags GetAspect(const VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+      return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_S8_UINT:
+      return VK_IMAGE_ASPECT_STENCIL_BIT;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+      return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+      return VK_IMAGE_ASPECT_COLOR_BIT;
+  }
+}
+
+leimu::render::ImageHandle leimu::render::PassBuilder::use(const ImageHandle image, const Access access) {
+  auto &pass = _graph._passes[_pass];
+  pass.uses.push_back({image.index, access});
+  if (GetAccessInfo(access).write) {
+    _graph._resources[image.index].writers.push_back(_pass);
+  }
+  return image;
+}
+
+leimu::render::BufferHandle leimu::render::PassBuilder::use(const BufferHandle buffer, const Access access) {
+  auto &pass = _graph._passes[_pass];
+  pass.uses.push_back({buffer.index, access});
+  if (GetAccessInfo(access).write) {
+    _graph._resources[buffer.index].writers.push_back(_pass);
+  }
+  return buffer;
+}
+
+void leimu::render::PassBuilder::sideEffect() {
+  _graph._passes[_pass].sideEffect = true;
+}
+
+leimu::render::RenderGraph::RenderGraph(const feature::Vulkan &vulkan)
+  : _device(vulkan.device()),
+    _allocator(vulkan.allocator()),
+    _deletion(vulkan.deletion()) {
+}
+
+leimu::render::RenderGraph::~RenderGraph() {
+  retire();
+}
+
+leimu::render::ImageHandle leimu::render::RenderGraph::createImage(std::string name, const ImageDesc &desc) {
+  _compiled = false;
+  _resources.push_back({.name = std::move(name), .image = true, .imported = false, .imageDesc = desc});
+  return {static_cast<u32>(_resources.size() - 1)};
+}
+
+leimu::render::BufferHandle leimu::render::RenderGraph::createBuffer(std::string name, const BufferDesc &desc) {
+  _compiled = false;
+  _resources.push_back({.name = std::move(name), .image = false, .imported = false, .bufferDesc = desc});
+  return {static_cast<u32>(_resources.size() - 1)};
+}
+
+leimu::render::ImageHandle leimu::render::RenderGraph::importImage(
+    std::string name,
+    const ImageDesc &desc,
+    const VkImageLayout initialLayout,
+    const VkImageLayout finalLayout,
+    const VkPipelineStageFlags producerStage) {
+
+  _compiled = false;
+  _resources.push_back(
+      {
+          .name = std::move(name),
+          .image = true,
+          .imported = true,
+          .imageDesc = desc,
+          .initialLayout = initialLayout,
+          .finalLayout = finalLayout,
+          .producerStage = producerStage,
+      });
+  return {static_cast<u32>(_resources.size() - 1)};
+}
+
+leimu::render::BufferHandle leimu::render::RenderGraph::importBuffer(std::string name, const VkDeviceSize size) {
+  _compiled = false;
+  _resources.push_back(
+      {
+          .name = std::move(name),
+          .image = false,
+          .imported = true,
+          .bufferDesc = {.size = size},
+      });
+  return {static_cast<u32>(_resources.size() - 1)};
+}
+
+void leimu::render::RenderGraph::bind(const ImageHandle image, const VkImage handle, const VkImageView view) {
+  auto &resource = _resources[image.index];
+  resource.imageHandle = handle;
+  resource.view = view;
+}
+
+void leimu::render::RenderGraph::bind(const BufferHandle buffer, const VkBuffer handle) {
+  _resources[buffer.index].bufferHandle = handle;
+}
+
+void leimu::render::RenderGraph::addPass(
+    std::string name,
+    const std::function<void(PassBuilder &)> &setup,
+    Execute execute) {
+
+  _compiled = false;
+  _passes.push_back({.name = std::move(name), .execute = std::move(execute)});
+
+  PassBuilder builder(*this, static_cast<u32>(_passes.size() - 1));
+  setup(builder);
+}
+
+void leimu::render::RenderGraph::cull() {
+  for (auto &resource: _resources) {
+    // Whatever is imported is read by someone outside the graph
+    resource.references = resource.imported ? 1 : 0;
+  }
+
+  for (auto &pass: _passes) {
+    pass.culled = false;
+    pass.references = pass.sideEffect ? 1 : 0;
+    for (const auto &[resource, access]: pass.uses) {
+      if (GetAccessInfo(access).write) {
+        ++pass.references;
+      } else {
+        ++_resources[resource].references;
+      }
+    }
+  }
+
+  std::vector<u32> unreferenced;
+  for (u32 i = 0; i < _resources.size(); ++i) {
+    if (!_resources[i].references) {
+      unreferenced.push_back(i);
+    }
+  }
+
+  while (!unreferenced.empty()) {
+    const auto resource = unreferenced.back();
+    unreferenced.pop_back();
+
+    for (const auto writer: _resources[resource].writers) {
+      auto &pass = _passes[writer];
+      if (pass.culled || --pass.references) {
+        continue;
+      }
+
+      pass.culled = true;
+      for (const auto &[read, access]: pass.uses) {
+        if (!GetAccessInfo(access).write && !--_resources[read].references) {
+          unreferenced.push_back(read);
+        }
+      }
+    }
+  }
+}
+
+void leimu::render::RenderGraph::computeLifetimes() {
+  for (auto &resource: _resources) {
+    resource.first = UINT32_MAX;
+    resource.last = 0;
+  }
+
+  for (u32 i = 0; i < _passes.size(); ++i) {
+    if (_passes[i].culled) {
+      continue;
+    }
+
+    for (const auto &use: _passes[i].uses) {
+      auto &resource = _resources[use.resource];
+      resource.first = std::min(resource.first, i);
+      resource.last = std::max(resource.last, i);
+    }
+  }
+}
+
+void leimu::render::RenderGraph::retire() {
+  if (_buckets.empty()) {
+    return;
+  }
+
+  std::vector<std::shared_ptr<void>> handles;
+  for (auto &resource: _resources) {
+    if (resource.ownedView) {
+      handles.push_back(std::move(resource.ownedView));
+    }
+    if (resource.ownedImage) {
+      handles.push_back(std::move(resource.ownedImage));
+    }
+    if (resource.ownedBuffer) {
+      handles.push_back(std::move(resource.ownedBuffer));
+    }
+  }
+  for (auto &bucket: _buckets) {
+    handles.push_back(std::move(bucket.allocation));
+  }
+  _buckets.clear();
+
+  _deletion->retire(std::move(handles));
+}
+
+bool leimu::render::RenderGraph::allocate() noexcept {
+  retire();
+
+  for (auto &resource: _resources) {
+    if (!resource.imported) {
+      resource.imageHandle = VK_NULL_HANDLE;
+      resource.view = VK_NULL_HANDLE;
+      resource.bufferHandle = VK_NULL_HANDLE;
+    }
+    resource.ownedImage = nullptr;
+    resource.ownedBuffer = nullptr;
+    resource.ownedView = nullptr;
+    resource.bucket = UINT32_MAX;
+  }
+
+  std::vector<u32> transients;
+  std::vector<VkMemoryRequirements> requirements(_resources.size());
+
+  for (u32 i = 0; i < _resources.size(); ++i) {
+    auto &resource = _resources[i];
+    if (resource.imported || resource.first == UINT32_MAX) {
+      continue;
+    }
+
+    VkImageUsageFlags imageUsage = resource.imageDesc.usage;
+    VkBufferUsageFlags bufferUsage = resource.bufferDesc.usage;
+    for (const auto &pass: _passes) {
+      if (pass.culled) {
+        continue;
+      }
+      for (const auto &use: pass.uses) {
+        if (use.resource == i) {
+          imageUsage |= GetAccessInfo(use.access).imageUsage;
+          bufferUsage |= GetAccessInfo(use.access).bufferUsage;
+        }
+      }
+    }
+
+    if (resource.image) {
+      const auto &desc = resource.imageDesc;
+      VkImageCreateInfo createInfo{
+          .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+          .imageType = VK_IMAGE_TYPE_2D,
+          .format = desc.format,
+          .extent = {desc.extent.width, desc.extent.height, 1},
+          .mipLevels = desc.mipLevels,
+          .arrayLayers = desc.arrayLayers,
+          .samples = VK_SAMPLE_COUNT_1_BIT,
+          .tiling = VK_IMAGE_TILING_OPTIMAL,
+          .usage = imageUsage,
+          .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+          .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+      };
+
+      VkImage image;
+      if (vkCreateImage(_device.get(), &createInfo, nullptr, &image) != VK_SUCCESS) {
+        std::println(errs(), "[graph] Couldn't create transient image '{}'", resource.name);
+        return false;
+      }
+
+      // Memory is owned by the bucket, which the image only shares
+      resource.ownedImage = {
+          new memory::Image_T{image, desc.format, createInfo.extent, desc.mipLevels, desc.arrayLayers, nullptr},
+          [device = _device](const memory::Image_T *self) {
+            vkDestroyImage(device.get(), self->handle, nullptr);
+            delete self;
+          }
+      };
+      resource.imageHandle = image;
+      vkGetImageMemoryRequirements(_device.get(), image, &requirements[i]);
+    } else {
+      VkBufferCreateInfo createInfo{
+          .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+          .size = resource.bufferDesc.size,
+          .usage = bufferUsage,
+          .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      };
+
+      VkBuffer buffer;
+      if (vkCreateBuffer(_device.get(), &createInfo, nullptr, &buffer) != VK_SUCCESS) {
+        std::println(errs(), "[graph] Couldn't create transient buffer '{}'", resource.name);
+        return false;
+      }
+
+      resource.ownedBuffer = {
+          new memory::Buffer_T{buffer, createInfo.size, nullptr},
+          [device = _device](const memory::Buffer_T *self) {
+            vkDestroyBuffer(device.get(), self->handle, nullptr);
+            delete self;
+          }
+      };
+      resource.bufferHandle = buffer;
+      vkGetBufferMemoryRequirements(_device.get(), buffer, &requirements[i]);
+    }
+
+    transients.push_back(i);
+  }
+
+  // Largest first, so that smaller resources fill the buckets sized by larger ones
+  std::ranges::sort(transients, std::greater{}, [&](const u32 i) { return requirements[i].size; });
+
+  VkDeviceSize unaliased = 0;
+  for (const auto i: transients) {
+    auto &resource = _resources[i];
+    const auto &req = requirements[i];
+    const auto kind = resource.image ? memory::ResourceKind::Optimal : memory::ResourceKind::Linear;
+    unaliased += req.size;
+
+    const auto overlaps = [&](const u32 other) {
+      return resource.first <= _resources[other].last && _resources[other].first <= resource.last;
+    };
+
+    auto bucket = std::ranges::find_if(_buckets, [&](const Bucket &candidate) {
+      return candidate.kind == kind &&
+             (candidate.requirements.memoryTypeBits & req.memoryTypeBits) &&
+             std::ranges::none_of(candidate.members, overlaps);
+    });
+
+    if (bucket == _buckets.end()) {
+      _buckets.push_back({.kind = kind, .requirements = req});
+      bucket = std::prev(_buckets.end());
+    } else {
+      bucket->requirements.size = std::max(bucket->requirements.size, req.size);
+      bucket->requirements.alignment = std::max(bucket->requirements.alignment, req.alignment);
+      bucket->requirements.memoryTypeBits &= req.memoryTypeBits;
+    }
+
+    bucket->members.push_back(i);
+    resource.bucket = static_cast<u32>(bucket - _buckets.begin());
+  }
+
+  VkDeviceSize aliased = 0;
+  for (auto &bucket: _buckets) {
+    std::ranges::sort(bucket.members, {}, [&](const u32 i) { return _resources[i].first; });
+
+    if (!((bucket.allocation = _allocator->allocate(
+        bucket.requirements,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        0,
+        bucket.kind)))) {
+      std::println(errs(), "[graph] Couldn't allocate {} bytes for transient resources", bucket.requirements.size);
+      return false;
+    }
+    aliased += bucket.requirements.size;
+
+    const auto memory = bucket.allocation->memory();
+    const auto offset = bucket.allocation->offset();
+    for (const auto i: bucket.members) {
+      auto &resource = _resources[i];
+
+      if (resource.image) {
+        resource.ownedImage->allocation = bucket.allocation;
+        if (vkBindImageMemory(_device.get(), resource.imageHandle, memory, offset) != VK_SUCCESS) {
+          std::println(errs(), "[graph] Couldn't bind memory of '{}'", resource.name);
+          return false;
+        }
+
+        const auto &desc = resource.imageDesc;
+        // Views sample depth only; depth and stencil can't be sampled through one view
+        auto aspect = GetAspect(desc.format);
+        if (aspect & VK_IMAGE_ASPECT_DEPTH_BIT) {
+          aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+        }
+
+        VkImageViewCreateInfo createInfo{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = resource.imageHandle,
+            .viewType = desc.arrayLayers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D,
+            .format = desc.format,
+            .subresourceRange = {
+                .aspectMask = aspect,
+                .baseMipLevel = 0,
+                .levelCount = desc.mipLevels,
+                .baseArrayLayer = 0,
+                .layerCount = desc.arrayLayers,
+            },
+        };
+
+        VkImageView view;
+        if (vkCreateImageView(_device.get(), &createInfo, nullptr, &view) != VK_SUCCESS) {
+          std::println(errs(), "[graph] Couldn't create view of '{}'", resource.name);
+          return false;
+        }
+
+        resource.ownedView = {
+            view, [device = _device](const VkImageView self) {
+              vkDestroyImageView(device.get(), self, nullptr);
+            }
+        };
+        resource.view = view;
+      } else {
+        resource.ownedBuffer->allocation = bucket.allocation;
+        if (vkBindBufferMemory(_device.get(), resource.bufferHandle, memory, offset) != VK_SUCCESS) {
+          std::println(errs(), "[graph] Couldn't bind memory of '{}'", resource.name);
+          return false;
+        }
+      }
+    }
+  }
+
+  std::println(
+      outs(),
+      "[graph] {} transient resource(s) in {} allocation(s): {} KiB ({} KiB without aliasing)",
+      transients.size(),
+      _buckets.size(),
+      aliased >> 10,
+      unaliased >> 10);
+
+  return true;
+}
+
+std::vector<leimu::render::RenderGraph::State> leimu::render::RenderGraph::simulate(
+    const std::vector<State> &initial,
+    const bool emit) {
+
+  auto states = initial;
+  std::vector<Barrier> barriers(_passes.size() + 1);
+
+  for (u32 i = 0; i < _passes.size(); ++i) {
+    if (_passes[i].culled) {
+      continue;
+    }
+
+    auto &barrier = barriers[i];
+    for (const auto &use: _passes[i].uses) {
+      const auto &resource = _resources[use.resource];
+      const auto info = GetAccessInfo(use.access);
+      auto &state = states[use.resource];
+
+      const auto relayout = resource.image && state.layout != info.layout;
+      if (info.write || relayout) {
+        // Waits for the last write and every read since (WAW, WAR); a layout transition is a write too
+        const auto src = state.writeStages | state.readStages;
+        if (relayout) {
+          barrier.transitions.push_back({use.resource, state.writeAccess, info.access, state.layout, info.layout});
+        } else if (state.writeAccess) {
+          barrier.srcAccess |= state.writeAccess;
+          barrier.dstAccess |= info.access;
+        }
+
+        if (src || relayout) {
+          barrier.srcStages |= src ? src : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+          barrier.dstStages |= info.stages;
+        }
+
+        if (resource.image) {
+          state.layout = info.layout;
+        }
+        state.writeStages = info.stages;
+        state.writeAccess = info.write ? info.access & WriteAccess : 0;
+        state.readStages = info.write ? 0 : info.stages;
+        state.visibleStages = info.write ? 0 : info.stages;
+        state.visibleAccess = info.write ? 0 : info.access;
+      } else {
+        // Reads only wait for the last write, and only once per stage and access
+        if (state.writeStages &&
+            ((info.stages & ~state.visibleStages) || (info.access & ~state.visibleAccess))) {
+          barrier.srcStages |= state.writeStages;
+          barrier.dstStages |= info.stages;
+          barrier.srcAccess |= state.writeAccess;
+          barrier.dstAccess |= info.access;
+          state.visibleStages |= info.stages;
+          state.visibleAccess |= info.access;
+        }
+        state.readStages |= info.stages;
+      }
+    }
+  }
+
+  auto &last = barriers.back();
+  for (u32 i = 0; i < _resources.size(); ++i) {
+    const auto &resource = _resources[i];
+    auto &state = states[i];
+    if (!resource.imported ||
+        !resource.image ||
+        resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED ||
+        resource.finalLayout == state.layout) {
+      continue;
+    }
+
+    last.srcStages |= state.writeStages | state.readStages | VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    last.dstStages |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    last.transitions.push_back({i, state.writeAccess, 0, state.layout, resource.finalLayout});
+    state.layout = resource.finalLayout;
+  }
+
+  if (emit) {
+    _barriers = std::move(barriers);
+  }
+  return states;
+}
+
+bool leimu::render::RenderGraph::compile() noexcept {
+  _compiled = false;
+
+  cull();
+  computeLifetimes();
+  if (!allocate()) {
+    return false;
+  }
+
+  std::vector<State> initial(_resources.size());
+  for (u32 i = 0; i < _resources.size(); ++i) {
+    if (const auto &resource = _resources[i]; resource.imported) {
+      initial[i] = {
+          .layout = resource.initialLayout,
+          .writeStages = resource.producerStage,
+          .writeAccess = VK_ACCESS_MEMORY_WRITE_BIT,
+      };
+    }
+  }
+
+  // Every execution starts where the previous one ended: a transient's first use must wait for the
+  // last use of whatever occupied its memory before, which, for the first occupant, is the last one
+  // of the previous execution
+  const auto ends = simulate(initial, false);
+  for (const auto &bucket: _buckets) {
+    for (size_t i = 0; i < bucket.members.size(); ++i) {
+      const auto previous = bucket.members[(i + bucket.members.size() - 1) % bucket.members.size()];
+      initial[bucket.members[i]] = {
+          .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+          .writeStages = ends[previous].writeStages | ends[previous].readStages,
+          .writeAccess = ends[previous].writeAccess,
+      };
+    }
+  }
+  (void) simulate(initial, true);
+
+  const auto culled = std::ranges::count_if(_passes, &Pass::culled);
+  std::println(outs(), "[graph] compiled {} pass(es), {} culled", _passes.size() - culled, culled);
+
+  _compiled = true;
+  return true;
+}
+
+void leimu::render::RenderGraph::emit(const VkCommandBuffer cmd, const Barrier &barrier) const {
+  if (!barrier.srcStages) {
+    return;
+  }
+
+  const VkMemoryBarrier memoryBarrier{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = barrier.srcAccess,
+      .dstAccessMask = barrier.dstAccess,
+  };
+  const auto hasMemoryBarrier = barrier.srcAccess || barrier.dstAccess;
+
+  std::vector<VkImageMemoryBarrier> imageBarriers;
+  imageBarriers.reserve(barrier.transitions.size());
+  for (const auto &transition: barrier.transitions) {
+    const auto &resource = _resources[transition.resource];
+    imageBarriers.push_back(
+        {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = transition.srcAccess,
+            .dstAccessMask = transition.dstAccess,
+            .oldLayout = transition.oldLayout,
+            .newLayout = transition.newLayout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = resource.imageHandle,
+            .subresourceRange = {
+                .aspectMask = GetAspect(resource.imageDesc.format),
+                .baseMipLevel = 0,
+                .levelCount = VK_REMAINING_MIP_LEVELS,
+                .baseArrayLayer = 0,
+                .layerCount = VK_REMAINING_ARRAY_LAYERS,
+            },
+        });
+  }
+
+  vkCmdPipelineBarrier(
+      cmd,
+      barrier.srcStages,
+      barrier.dstStages,
+      0,
+      hasMemoryBarrier ? 1 : 0,
+      &memoryBarrier,
+      0,
+      nullptr,
+      static_cast<u32>(imageBarriers.size()),
+      imageBarriers.data());
+}
+
+void leimu::render::RenderGraph::execute(const VkCommandBuffer cmd) const {
+  if (!_compiled) {
+    std::println(errs(), "[graph] Executing a graph which is not compiled");
+    return;
+  }
+
+  for (size_t i = 0; i < _passes.size(); ++i) {
+    if (_passes[i].culled) {
+      continue;
+    }
+
+    emit(cmd, _barriers[i]);
+    _passes[i].execute(cmd, *this);
+  }
+
+  emit(cmd, _barriers.back());
+}
@@ -1,10 +1,43 @@
 #include "leimu/render/Shader.h"
+#include "leimu/hash.h"
 #include "leimu/native/mmap.h"
 
-leimu::render::Shader leimu::render::CreateShader(
-    feature::VulkanDevice device,
-    size_t size,
-    const void *code) noexcept {
+namespace {
+  struct ShaderKey {
+    VkDevice device;
+    u64 hash;
+    size_t size;
+
+    auto operator<=>(const ShaderKey &) const = default;
+  };
+
+  struct ShaderEntry {
+    std::weak_ptr<VkShaderModule_T> module;
+    // compared on every hit; the hash alone may collide
+    std::vector<std::byte> code;
+
+    [[nodiscard]] bool matches(const void *other) const {
+      return std::memcmp(code.data(), other, code.size()) == 0;
+    }
+  };
+
+  struct ShaderRegistry {
+    std::mutex lock;
+    std::map<ShaderKey, ShaderEntry> modules;
+  };
+
+  ShaderRegistry &GetShaderRegistry() {
+    // Leaked on purpose; modules outliving static destruction still unregister themselves
+    static const auto registry = new ShaderRegistry;
+    return *registry;
+  }
+}
+
+static leimu::render::Shader CompileShaderModule(
+    const leimu::feature::VulkanDevice &device,
+    const size_t size,
+    const void *code,
+    const ShaderKey key) noexcept {
 
   VkShaderModuleCreateInfo createInfo{
       .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
@@ -20,7 +53,7 @@ leimu::render::Shader leimu::render::CreateShader(
 #endif
 
     std::println(
-        errs(),
+        leimu::errs(),
         "[vulkan] Failed to create shader module\n"
 #if LEIMU_DEBUG
         "=== SOURCE ===\n"
@@ -32,13 +65,61 @@ leimu::render::Shader leimu::render::CreateShader(
     return nullptr;
   }
 
-  return Shader{
+  return leimu::render::Shader{
       module, [=](const VkShaderModule self) {
+        auto &registry = GetShaderRegistry();
+        {
+          std::lock_guard _(registry.lock);
+          // A concurrent loader may already have replaced the entry with a live module
+          if (const auto it = registry.modules.find(key); it != registry.modules.end() && it->second.module.expired()) {
+            registry.modules.erase(it);
+          }
+        }
+
         vkDestroyShaderModule(device.get(), self, nullptr);
       }
   };
 }
 
+leimu::render::Shader leimu::render::CreateShader(
+    feature::VulkanDevice device,
+    const size_t size,
+    const void *code) noexcept {
+
+  const ShaderKey key{device.get(), Hash(code, size), size};
+  auto &registry = GetShaderRegistry();
+
+  {
+    std::lock_guard _(registry.lock);
+    if (const auto it = registry.modules.find(key); it != registry.modules.end()) {
+      if (auto shader = it->second.module.lock(); shader && it->second.matches(code)) {
+        return shader;
+      }
+    }
+  }
+
+  // Compiled outside the lock so that loaders of different modules don't serialize on the driver
+  auto shader = CompileShaderModule(device, size, code, key);
+  if (!shader) {
+    return nullptr;
+  }
+
+  std::lock_guard _(registry.lock);
+  auto &entry = registry.modules[key];
+  if (auto existing = entry.module.lock()) {
+    if (entry.matches(code)) {
+      // Lost the race; the duplicate is destroyed when it goes out of scope
+      return existing;
+    }
+    // A colliding module holds the entry; this one goes uncached
+    return shader;
+  }
+
+  const auto bytes = static_cast<const std::byte *>(code);
+  entry = {.module = shader, .code = {bytes, bytes + size}};
+  return shader;
+}
+
 leimu::render::Shader leimu::render::CreateShaderFromFile(
     leimu::feature::VulkanDevice device,
     std::filesystem::path path) {
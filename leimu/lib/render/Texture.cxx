@@ -0,0 +1,466 @@
+#include "leimu/render/Texture.h"
+#include "leimu/render/Ktx2.h"
+#include "leimu/native/mmap.h"
+#include "leimu/trace.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_NO_STDIO
+#include <stb_image.h>
+
+namespace {
+  VkFormat GetFormat(const bool srgb) {
+    return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+  }
+
+  leimu::feature::VulkanImageView CreateView(
+      const leimu::feature::VulkanDevice &device,
+      const leimu::memory::Image &image) noexcept {
+
+    const VkImageViewCreateInfo createInfo{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = image->handle,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = image->format,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = image->mipLevels,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+    };
+
+    VkImageView view;
+    if (vkCreateImageView(device.get(), &createInfo, nullptr, &view) != VK_SUCCESS) {
+      std::println(leimu::errs(), "[texture] Couldn't create image view");
+      return nullptr;
+    }
+
+    return {
+        view, [device](const VkImageView self) {
+          vkDestroyImageView(device.get(), self, nullptr);
+        }
+    };
+  }
+
+  /**
+   * Writes every level from the one above it. Every level has to be in TRANSFER_DST_OPTIMAL;
+   * all of them are left in SHADER_READ_ONLY_OPTIMAL.
+   */
+  void GenerateMips(const VkCommandBuffer cmd, const leimu::memory::Image &image) {
+    VkImageMemoryBarrier barrier{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image->handle,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+    };
+
+    auto width = static_cast<i32>(image->extent.width);
+    auto height = static_cast<i32>(image->extent.height);
+    for (u32 level = 1; level < image->mipLevels; ++level) {
+      barrier.subresourceRange.baseMipLevel = level - 1;
+      vkCmdPipelineBarrier(
+          cmd,
+          VK_PIPELINE_STAGE_TRANSFER_BIT,
+          VK_PIPELINE_STAGE_TRANSFER_BIT,
+          0,
+          0, nullptr,
+          0, nullptr,
+          1, &barrier);
+
+      const auto nextWidth = std::max(width / 2, 1);
+      const auto nextHeight = std::max(height / 2, 1);
+      const VkImageBlit blit{
+          .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1},
+          .srcOffsets = {{0, 0, 0}, {width, height, 1}},
+          .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},
+          .dstOffsets = {{0, 0, 0}, {nextWidth, nextHeight, 1}},
+      };
+      vkCmdBlitImage(
+          cmd,
+          image->handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+          image->handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          1, &blit,
+          VK_FILTER_LINEAR);
+
+      width = nextWidth;
+      height = nextHeight;
+    }
+
+    // Every level but the last has been read from
+    std::array<VkImageMemoryBarrier, 2> barriers{barrier, barrier};
+    barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[0].subresourceRange.baseMipLevel = 0;
+    barriers[0].subresourceRange.levelCount = image->mipLevels - 1;
+
+    barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[1].subresourceRange.baseMipLevel = image->mipLevels - 1;
+    barriers[1].subresourceRange.levelCount = 1;
+
+    vkCmdPipelineBarrier(
+        cmd,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        static_cast<u32>(barriers.size()), barriers.data());
+  }
+
+  /**
+   * What to upload for a texture file: the image to create and the data of its levels.
+   */
+  struct Source {
+    VkImageCreateInfo createInfo;
+    const void *data;
+    VkDeviceSize size;
+    std::vector<VkBufferImageCopy> regions;
+    // whether levels past the first are to be blitted on the GPU
+    bool generateMips;
+    // decoded pixels, if data doesn't point into the mapping
+    std::shared_ptr<void> storage;
+  };
+
+  VkImageCreateInfo GetCreateInfo(const VkFormat format, const VkExtent3D extent, const u32 levels) {
+    return {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = format,
+        .extent = extent,
+        .mipLevels = levels,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+  }
+
+  std::optional<Source> DecodeImage(
+      const leimu::native::FileMapping &mapping,
+      const std::filesystem::path &path,
+      const bool srgb,
+      const bool mipmaps) {
+
+    i32 width, height, channels;
+    std::shared_ptr<stbi_uc> pixels(
+        stbi_load_from_memory(
+            static_cast<const stbi_uc *>(mapping->ptr()),
+            static_cast<i32>(mapping->size()),
+            &width, &height, &channels,
+            STBI_rgb_alpha),
+        &stbi_image_free);
+    if (!pixels) {
+      std::println(leimu::errs(), "[texture] Couldn't decode '{}': {}", path.string(), stbi_failure_reason());
+      return std::nullopt;
+    }
+
+    const VkExtent3D extent{static_cast<u32>(width), static_cast<u32>(height), 1};
+    const auto levels = mipmaps ? static_cast<u32>(std::bit_width(std::max(extent.width, extent.height))) : 1u;
+
+    return Source{
+        .createInfo = GetCreateInfo(GetFormat(srgb), extent, levels),
+        .data = pixels.get(),
+        .size = static_cast<VkDeviceSize>(width) * height * 4,
+        .regions = {
+            {
+                .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+                .imageExtent = extent,
+            }
+        },
+        .generateMips = levels > 1,
+        .storage = std::move(pixels),
+    };
+  }
+
+  /**
+   * Host-visible copy of data, for images the staging ring can't hold.
+   */
+  leimu::memory::Buffer CreateStagingBuffer(
+      leimu::memory::Allocator &allocator,
+      const void *data,
+      const VkDeviceSize size) noexcept {
+
+    const VkBufferCreateInfo createInfo{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    auto buffer = allocator.createBuffer(
+        createInfo,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (!buffer || !buffer->allocation->mapped()) {
+      std::println(leimu::errs(), "[texture] Couldn't create staging buffer of {} KiB", size >> 10);
+      return nullptr;
+    }
+
+    memcpy(buffer->allocation->mapped(), data, size);
+    return buffer;
+  }
+
+  /**
+   * Levels are copied from the mapping as they are, without any transform on the CPU.
+   */
+  std::optional<Source> ReadKtx2(
+      const leimu::feature::VulkanPhysicalDevice &physicalDevice,
+      const leimu::native::FileMapping &mapping,
+      const std::filesystem::path &path) {
+
+    const std::span file(static_cast<const u8 *>(mapping->ptr()), mapping->size());
+    const auto ktx = leimu::render::ParseKtx2(file);
+    if (!ktx) {
+      std::println(leimu::errs(), "[texture] Couldn't read '{}'", path.string());
+      return std::nullopt;
+    }
+
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice.get(), ktx->format, &properties);
+    if (!(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+      std::println(
+          leimu::errs(), "[texture] Format {} of '{}' can't be sampled on this device",
+          static_cast<u32>(ktx->format), path.string());
+      return std::nullopt;
+    }
+
+    // One contiguous copy from the smallest offset on; levels are stored smallest first
+    VkDeviceSize begin = UINT64_MAX;
+    VkDeviceSize end = 0;
+    for (const auto &[offset, size]: ktx->levels) {
+      begin = std::min(begin, offset);
+      end = std::max(end, offset + size);
+    }
+
+    std::vector<VkBufferImageCopy> regions;
+    regions.reserve(ktx->levels.size());
+    for (u32 level = 0; level < ktx->levels.size(); ++level) {
+      regions.push_back(
+          {
+              .bufferOffset = ktx->levels[level].offset - begin,
+              .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},
+              .imageExtent = {
+                  std::max(ktx->extent.width >> level, 1u),
+                  std::max(ktx->extent.height >> level, 1u),
+                  1
+              },
+          });
+    }
+
+    return Source{
+        .createInfo = GetCreateInfo(ktx->format, ktx->extent, static_cast<u32>(ktx->levels.size())),
+        .data = file.data() + begin,
+        .size = end - begin,
+        .regions = std::move(regions),
+        .generateMips = false,
+    };
+  }
+}
+
+leimu::render::Texture_T::~Texture_T() {
+  if (_deletion && _image) {
+    _deletion->retire({std::move(_view), std::move(_image)});
+  }
+}
+
+VkImage leimu::render::Texture_T::image() const {
+  if (!ready() && _placeholder) {
+    return _placeholder->image();
+  }
+  return _image ? _image->handle : VK_NULL_HANDLE;
+}
+
+VkImageView leimu::render::Texture_T::view() const {
+  if (!ready() && _placeholder) {
+    return _placeholder->view();
+  }
+  return _view.get();
+}
+
+VkExtent3D leimu::render::Texture_T::extent() const {
+  if (!ready() && _placeholder) {
+    return _placeholder->extent();
+  }
+  return _image ? _image->extent : VkExtent3D{};
+}
+
+u32 leimu::render::Texture_T::mipLevels() const {
+  if (!ready() && _placeholder) {
+    return _placeholder->mipLevels();
+  }
+  return _image ? _image->mipLevels : 0;
+}
+
+void leimu::render::TextureStreamer::Budget::acquire(const VkDeviceSize size) {
+  auto current = pending.load(std::memory_order_acquire);
+  while (true) {
+    // A texture larger than the limit may still go through on its own
+    if (current && current + size > limit) {
+      pending.wait(current, std::memory_order_acquire);
+      current = pending.load(std::memory_order_acquire);
+      continue;
+    }
+    if (pending.compare_exchange_weak(current, current + size, std::memory_order_acq_rel)) {
+      return;
+    }
+  }
+}
+
+void leimu::render::TextureStreamer::Budget::release(const VkDeviceSize size) {
+  pending.fetch_sub(size, std::memory_order_acq_rel);
+  pending.notify_all();
+}
+
+leimu::render::TextureStreamer::TextureStreamer(const feature::Vulkan &vulkan, job::Scheduler &jobs) noexcept
+  : _physicalDevice(vulkan.physicalDevice()),
+    _device(vulkan.device()),
+    _allocator(vulkan.allocator()),
+    _uploader(vulkan.uploader()),
+    _deletion(vulkan.deletion()),
+    _jobs(jobs),
+    _budget(std::make_shared<Budget>()) {
+
+  if (!vulkan || !_allocator || !_uploader) {
+    return;
+  }
+
+  // Half the ring, so buffer uploads keep going while textures stream
+  _budget->limit = _uploader->capacity() / 2;
+
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(_physicalDevice.get(), GetFormat(true), &properties);
+  _mipmaps = properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  if (!_mipmaps) {
+    std::println(warns(), "[texture] RGBA8 can't be blitted linearly; textures won't have mipmaps");
+  }
+
+  const auto createInfo = GetCreateInfo(GetFormat(false), {2, 2, 1}, 1);
+
+  auto placeholder = std::make_shared<Texture_T>(nullptr, _deletion);
+  if (!((placeholder->_image = _allocator->createImage(createInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)))) {
+    std::println(errs(), "[texture] Couldn't create placeholder image");
+    return;
+  }
+  if (!((placeholder->_view = CreateView(_device, placeholder->_image)))) {
+    return;
+  }
+
+  // Magenta and black checkerboard
+  constexpr std::array<u32, 4> texels{0xFFFF00FF, 0xFF000000, 0xFF000000, 0xFFFF00FF};
+  const VkBufferImageCopy region{
+      .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+      .imageExtent = createInfo.extent,
+  };
+  if (!_uploader->upload(placeholder->_image, texels.data(), sizeof(texels), {&region, 1})) {
+    std::println(errs(), "[texture] Couldn't upload placeholder");
+    return;
+  }
+
+  // Resident before anything can be recorded: the next frame acquires every pending upload as it begins,
+  // ahead of handing out its command buffer. Textures fall back to it without checking
+  placeholder->resolve(TextureState::Ready);
+  _placeholder = std::move(placeholder);
+}
+
+leimu::render::Texture leimu::render::TextureStreamer::load(const std::filesystem::path &path, const bool srgb) {
+  std::lock_guard _(_lock);
+
+  // Entries of textures nobody holds any longer would pile up otherwise
+  if (_cache.size() >= _sweepAt) {
+    std::erase_if(_cache, [](const auto &entry) { return entry.second.expired(); });
+    _sweepAt = std::max<size_t>(_cache.size() * 2, 64);
+  }
+
+  auto &cached = _cache[{path, srgb}];
+  if (auto texture = cached.lock()) {
+    return texture;
+  }
+
+  auto texture = std::make_shared<Texture_T>(_placeholder, _deletion);
+  cached = texture;
+
+  if (!_uploader) {
+    texture->resolve(TextureState::Failed);
+    return texture;
+  }
+
+  _jobs.background(
+      [physicalDevice = _physicalDevice, device = _device, allocator = _allocator, uploader = _uploader,
+        budget = _budget, mipmaps = _mipmaps, texture, path, srgb] {
+        LEIMU_ZONE("texture: stream");
+
+        const auto mapping = native::CreateFileMapping(path);
+        if (!mapping) {
+          texture->resolve(TextureState::Failed);
+          return;
+        }
+
+        const auto source = path.extension() == ".ktx2"
+                              ? ReadKtx2(physicalDevice, mapping, path)
+                              : DecodeImage(mapping, path, srgb, mipmaps);
+        if (!source) {
+          texture->resolve(TextureState::Failed);
+          return;
+        }
+
+        // Published by the release store of resolve()
+        if (!((texture->_image = allocator->createImage(source->createInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)))) {
+          std::println(errs(), "[texture] Couldn't create image for '{}'", path.string());
+          texture->resolve(TextureState::Failed);
+          return;
+        }
+        if (!((texture->_view = CreateView(device, texture->_image)))) {
+          texture->resolve(TextureState::Failed);
+          return;
+        }
+
+        // Staged bytes are released once the frame acquires them, keeping the unsubmitted batch within the ring
+        const auto size = source->size;
+        const auto generateMips = source->generateMips;
+        const auto finalLayout =
+            generateMips ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        auto onAcquire = [texture, budget, size, generateMips](const VkCommandBuffer cmd) {
+          if (generateMips) {
+            GenerateMips(cmd, texture->_image);
+          }
+          texture->resolve(TextureState::Ready);
+          budget->release(size);
+        };
+
+        budget->acquire(size);
+        bool uploaded;
+        if (size <= budget->limit) {
+          uploaded = uploader->upload(
+              texture->_image, source->data, size, source->regions, finalLayout, std::move(onAcquire));
+        } else if (const auto staging = CreateStagingBuffer(*allocator, source->data, size)) {
+          // An image is copied in one go, so one larger than the ring goes through a buffer of its own
+          uploaded = uploader->copy(staging, texture->_image, source->regions, finalLayout, std::move(onAcquire));
+        } else {
+          uploaded = false;
+        }
+        if (!uploaded) {
+          budget->release(size);
+          texture->resolve(TextureState::Failed);
+        }
+      });
+
+  return texture;
+}
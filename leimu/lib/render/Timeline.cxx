@@ -0,0 +1,153 @@
+#include "leimu/render/Timeline.h"
+#include "leimu/trace.h"
+
+void leimu::render::TimelineSubmit::wait(
+    const Timeline_T &timeline,
+    const u64 value,
+    const VkPipelineStageFlags stage) {
+  waitSemaphores.push_back(timeline.semaphore());
+  waitStages.push_back(stage);
+  waitValues.push_back(value);
+}
+
+void leimu::render::TimelineSubmit::wait(const VkSemaphore binary, const VkPipelineStageFlags stage) {
+  waitSemaphores.push_back(binary);
+  waitStages.push_back(stage);
+  waitValues.push_back(0);
+}
+
+void leimu::render::TimelineSubmit::signal(const VkSemaphore binary) {
+  signalSemaphores.push_back(binary);
+  signalValues.push_back(0);
+}
+
+u64 leimu::render::Timeline_T::submit(TimelineSubmit submit, const VkFence fence) noexcept {
+  std::lock_guard _(_lock);
+
+  const auto value = _submitted.load(std::memory_order_relaxed) + 1;
+  submit.signalSemaphores.push_back(_semaphore.get());
+  submit.signalValues.push_back(value);
+
+  const VkTimelineSemaphoreSubmitInfo timelineInfo{
+      .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+      .waitSemaphoreValueCount = static_cast<u32>(submit.waitValues.size()),
+      .pWaitSemaphoreValues = submit.waitValues.data(),
+      .signalSemaphoreValueCount = static_cast<u32>(submit.signalValues.size()),
+      .pSignalSemaphoreValues = submit.signalValues.data(),
+  };
+  const VkSubmitInfo submitInfo{
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .pNext = &timelineInfo,
+      .waitSemaphoreCount = static_cast<u32>(submit.waitSemaphores.size()),
+      .pWaitSemaphores = submit.waitSemaphores.data(),
+      .pWaitDstStageMask = submit.waitStages.data(),
+      .commandBufferCount = static_cast<u32>(submit.commandBuffers.size()),
+      .pCommandBuffers = submit.commandBuffers.data(),
+      .signalSemaphoreCount = static_cast<u32>(submit.signalSemaphores.size()),
+      .pSignalSemaphores = submit.signalSemaphores.data(),
+  };
+
+  if (vkQueueSubmit(_queue.get(), 1, &submitInfo, fence) != VK_SUCCESS) {
+    std::println(errs(), "[timeline] Couldn't submit value {}", value);
+    return 0;
+  }
+
+  _submitted.store(value, std::memory_order_release);
+  return value;
+}
+
+VkResult leimu::render::Timeline_T::present(const VkPresentInfoKHR &presentInfo) noexcept {
+  std::lock_guard _(_lock);
+  return vkQueuePresentKHR(_queue.get(), &presentInfo);
+}
+
+bool leimu::render::Timeline_T::completed(const u64 value) const noexcept {
+  if (value <= _completed.load(std::memory_order_acquire)) {
+    return true;
+  }
+  return value <= this->value();
+}
+
+bool leimu::render::Timeline_T::wait(const u64 value, const u64 timeout) const noexcept {
+  if (completed(value)) {
+    return true;
+  }
+
+  // A value nothing will signal would block forever
+  assert(value <= submitted());
+
+  LEIMU_ZONE("timeline: wait");
+  const auto semaphore = _semaphore.get();
+  const VkSemaphoreWaitInfo waitInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+      .semaphoreCount = 1,
+      .pSemaphores = &semaphore,
+      .pValues = &value,
+  };
+  if (vkWaitSemaphores(_device.get(), &waitInfo, timeout) != VK_SUCCESS) {
+    return false;
+  }
+
+  // Others may have seen a later value meanwhile
+  auto completed = _completed.load(std::memory_order_relaxed);
+  while (completed < value && !_completed.compare_exchange_weak(completed, value, std::memory_order_release)) {
+  }
+  return true;
+}
+
+u64 leimu::render::Timeline_T::value() const noexcept {
+  u64 value = 0;
+  if (vkGetSemaphoreCounterValue(_device.get(), _semaphore.get(), &value) != VK_SUCCESS) {
+    return _completed.load(std::memory_order_acquire);
+  }
+
+  auto completed = _completed.load(std::memory_order_relaxed);
+  while (completed < value && !_completed.compare_exchange_weak(completed, value, std::memory_order_release)) {
+  }
+  return value;
+}
+
+leimu::render::Timelines::Timelines(
+    const feature::VulkanDevice &device,
+    const std::span<const feature::VulkanQueue, 4> queues) noexcept {
+  std::map<VkQueue, Timeline> byQueue;
+
+  for (u32 i = 0; i < queues.size(); ++i) {
+    auto &timeline = byQueue[queues[i].get()];
+    if (!timeline) {
+      auto semaphore = CreateTimelineSemaphore(device);
+      if (!semaphore) {
+        _timelines = {};
+        return;
+      }
+      timeline = std::make_shared<Timeline_T>(device, queues[i], std::move(semaphore));
+    }
+    _timelines[i] = timeline;
+  }
+}
+
+leimu::feature::VulkanSemaphore leimu::render::CreateTimelineSemaphore(
+    const feature::VulkanDevice &device,
+    const u64 value) noexcept {
+  const VkSemaphoreTypeCreateInfo typeInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+      .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+      .initialValue = value,
+  };
+  const VkSemaphoreCreateInfo createInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+      .pNext = &typeInfo,
+  };
+
+  VkSemaphore semaphore;
+  if (vkCreateSemaphore(device.get(), &createInfo, nullptr, &semaphore) != VK_SUCCESS) {
+    std::println(errs(), "[timeline] Couldn't create timeline semaphore");
+    return nullptr;
+  }
+
+  return {
+      semaphore, [device](const VkSemaphore self) {
+        vkDestroySemaphore(device.get(), self, nullptr);
+      }
+  };
+}
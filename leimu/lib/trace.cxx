@@ -0,0 +1,161 @@
+#include "leimu/trace.h"
+#include "leimu/logging.h"
+
+namespace {
+  struct Event {
+    const char *name;
+    u64 begin;
+    u64 end;
+  };
+
+  struct CollectedEvent {
+    Event event;
+    u32 thread;
+  };
+
+  /**
+   * Single-producer (owning thread), single-consumer (Collect) ring.
+   */
+  struct Ring {
+    static constexpr u64 Capacity = 1 << 14;
+
+    std::array<Event, Capacity> events;
+    alignas(64) std::atomic<u64> head = 0;
+    alignas(64) std::atomic<u64> tail = 0;
+    std::atomic<u64> dropped = 0;
+
+    u32 thread;
+    // guarded by Registry::lock
+    std::string name;
+  };
+
+  // Events kept after collection; older ones are discarded
+  constexpr size_t MaxCollected = 1 << 20;
+
+  struct Registry {
+    std::mutex lock;
+    std::vector<std::shared_ptr<Ring>> rings;
+    std::deque<CollectedEvent> collected;
+    u64 dropped = 0;
+  };
+
+  // Leaked; threads may record while static destructors run
+  Registry &GetRegistry() {
+    static auto registry = new Registry;
+    return *registry;
+  }
+
+  const auto Epoch = std::chrono::steady_clock::now();
+
+  Ring &GetRing() {
+    thread_local const auto ring = [] {
+      auto &registry = GetRegistry();
+      std::lock_guard _(registry.lock);
+
+      auto ring = std::make_shared<Ring>();
+      ring->thread = static_cast<u32>(registry.rings.size());
+      ring->name = std::format("thread #{}", ring->thread);
+      registry.rings.push_back(ring);
+      return ring;
+    }();
+    return *ring;
+  }
+
+  void WriteEscaped(std::ostream &out, const std::string_view text) {
+    for (const auto c: text) {
+      if (c == '"' || c == '\\') {
+        out << '\\';
+      }
+      out << c;
+    }
+  }
+}
+
+u64 leimu::trace::Now() noexcept {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Epoch).count();
+}
+
+void leimu::trace::Record(const char *name, const u64 begin, const u64 end) noexcept {
+  auto &ring = GetRing();
+
+  const auto head = ring.head.load(std::memory_order_relaxed);
+  if (head - ring.tail.load(std::memory_order_acquire) >= Ring::Capacity) {
+    ring.dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  ring.events[head % Ring::Capacity] = {name, begin, end};
+  ring.head.store(head + 1, std::memory_order_release);
+}
+
+void leimu::trace::SetThreadName(std::string name) {
+  auto &ring = GetRing();
+
+  std::lock_guard _(GetRegistry().lock);
+  ring.name = std::move(name);
+}
+
+void leimu::trace::Collect() noexcept {
+  auto &registry = GetRegistry();
+  std::lock_guard _(registry.lock);
+
+  for (const auto &ring: registry.rings) {
+    const auto tail = ring->tail.load(std::memory_order_relaxed);
+    const auto head = ring->head.load(std::memory_order_acquire);
+    for (auto i = tail; i < head; ++i) {
+      registry.collected.push_back({ring->events[i % Ring::Capacity], ring->thread});
+    }
+    ring->tail.store(head, std::memory_order_release);
+    registry.dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+  }
+
+  while (registry.collected.size() > MaxCollected) {
+    registry.collected.pop_front();
+  }
+}
+
+bool leimu::trace::Dump(const std::filesystem::path &path) noexcept {
+  Collect();
+
+  std::ofstream out(path);
+  if (!out) {
+    std::println(errs(), "[trace] Couldn't open '{}'", path.string());
+    return false;
+  }
+
+  auto &registry = GetRegistry();
+  std::lock_guard _(registry.lock);
+
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+  auto first = true;
+  for (const auto &ring: registry.rings) {
+    out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->thread
+        << ",\"args\":{\"name\":\"";
+    WriteEscaped(out, ring->name);
+    out << "\"}}";
+    first = false;
+  }
+
+  for (const auto &[event, thread]: registry.collected) {
+    // Chrome expects microseconds; keep sub-microsecond precision
+    out << (first ? "" : ",") << "\n{\"name\":\"";
+    WriteEscaped(out, event.name);
+    out << std::format(
+        "\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+        thread,
+        static_cast<f64>(event.begin) / 1e3,
+        static_cast<f64>(event.end - event.begin) / 1e3);
+    first = false;
+  }
+
+  out << "\n]}\n";
+
+  std::println(
+      outs(),
+      "[trace] {} zone(s) written to '{}' ({} dropped)",
+      registry.collected.size(),
+      path.string(),
+      registry.dropped);
+  return static_cast<bool>(out);
+}